@@ -0,0 +1,367 @@
+// Throughput, latency and per-byte cost of the stack, measured on a host.
+//
+// Two stacks exchange reliable data over a LoopbackPhysicalLayer pair whose
+// simulated clock this file provides, so it is built with the sources but
+// without port/system_utils*.cpp:
+//
+//   g++ -std=c++11 -O2 -DLOG_MAX_LEVEL=0 -Iinclude bench/robust_stack_bench.cpp src/*.cpp -o robust_stack_bench
+//   ./robust_stack_bench [clean|lossy|cut|ideal|kernels]   (all of them by default)
+//
+// clean   500 kB over a 921600 baud line with 200 us latency, 64-byte writes
+//         and a 128-byte transmitter FIFO
+// lossy   the same with 1000 bit errors per 10^9 bits and 5 loss bursts of
+//         20 bytes per 10^6 bytes
+// cut     100 kB with the line cut for 4 s after 30 kB, with and without
+//         session resumption
+// ideal   5 MB over a wire without delays or limits, so that the host cost
+//         is mostly that of the stacks' hot path
+// kernels cycles per byte of LinkLayer::send(), COBS::encode(),
+//         COBS::decode() and CRC16::calculate()
+//
+// Goodput, frames/s and latency are in simulated time and repeat exactly
+// from run to run; the host cost of a transfer (both stacks and the line
+// model) and the kernels are in TSC cycles on x86 and nanoseconds elsewhere.
+
+#include "robust_stack.hpp"
+#include "loopback_physical_layer.hpp"
+#include "cobs.hpp"
+#include "crc16.hpp"
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLE_UNIT "cycles"
+static uint64_t bench_cycles()
+{
+    return __rdtsc();
+}
+#else
+#include <chrono>
+#define BENCH_CYCLE_UNIT "ns"
+static uint64_t bench_cycles()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+#endif
+
+namespace robust_serial
+{
+
+static uint32_t bench_time_us = 0; // Simulated time of the stacks and the line
+
+uint32_t get_current_time_ms()
+{
+    return bench_time_us / 1000;
+}
+
+} // namespace robust_serial
+
+using namespace robust_serial;
+
+static const uint32_t BENCH_STEP_US = 10;         // Simulated time per loop iteration
+static const uint32_t BENCH_TIME_LIMIT_US = 200000000; // Gives up on a stalled transfer
+static const uint16_t BENCH_SEND_SIZE = 200;      // Bytes per send()
+
+/**
+ * @brief Receiver side of a transfer: checks that the byte pattern arrives in order
+ */
+struct BenchReceiver
+{
+    uint32_t received;
+    uint8_t expected;
+    bool in_order;
+};
+
+static void on_bench_data(void *context, const uint8_t *data, uint16_t length)
+{
+    BenchReceiver *receiver = static_cast<BenchReceiver *>(context);
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (data[i] != receiver->expected)
+        {
+            receiver->in_order = false;
+        }
+        receiver->expected++;
+    }
+    receiver->received += length;
+}
+
+/**
+ * @brief One transfer scenario: the line and, optionally, a cut in the middle
+ */
+struct BenchTransfer
+{
+    const char *name;
+    LoopbackConfig line;
+    uint32_t bytes;
+    uint32_t cut_after;  // Bytes received before the line is cut, 0 for no cut
+    uint32_t cut_ms;     // Length of the cut
+    bool resumption;     // set_session_resumption() on both stacks
+};
+
+static LoopbackConfig bench_line(uint32_t bit_error_ppb, uint32_t burst_ppm)
+{
+    LoopbackConfig line;
+    memset(&line, 0, sizeof(line));
+    line.baud_rate = 921600;
+    line.latency_us = 200;
+    line.bit_error_ppb = bit_error_ppb;
+    line.burst_ppm = burst_ppm;
+    line.burst_length = 20;
+    line.max_write = 64;
+    line.tx_fifo_size = 128;
+    return line;
+}
+
+static void configure_both(LoopbackPhysicalLayer &a, LoopbackPhysicalLayer &b, LoopbackConfig line)
+{
+    line.seed = 7;
+    a.configure(line);
+    line.seed = 9;
+    b.configure(line);
+}
+
+static void run_transfer(const BenchTransfer &transfer)
+{
+    bench_time_us = 0;
+    LoopbackPhysicalLayer phy_a, phy_b;
+    LoopbackPhysicalLayer::connect(phy_a, phy_b);
+    configure_both(phy_a, phy_b, transfer.line);
+
+    StaticRobustStack<> a(phy_a), b(phy_b);
+    a.initialize();
+    b.initialize();
+    a.set_session_resumption(transfer.resumption);
+    b.set_session_resumption(transfer.resumption);
+    BenchReceiver receiver = {0, 0, true};
+    b.set_data_callback(on_bench_data, &receiver);
+    b.listen();
+    a.connect();
+
+    uint8_t buffer[BENCH_SEND_SIZE];
+    uint8_t pattern = 0;
+    uint32_t sent = 0;
+    uint32_t start_us = 0;
+    uint32_t cut_us = 0;
+    bool started = false;
+    bool cut = false;
+    bool failed = false;
+    uint64_t start_cycles = bench_cycles();
+
+    while (receiver.received < transfer.bytes && bench_time_us < BENCH_TIME_LIMIT_US)
+    {
+        if (a.is_connected() && sent < transfer.bytes)
+        {
+            if (!started)
+            {
+                started = true;
+                start_us = bench_time_us;
+            }
+            uint16_t length = BENCH_SEND_SIZE;
+            if (length > transfer.bytes - sent)
+            {
+                length = static_cast<uint16_t>(transfer.bytes - sent);
+            }
+            uint8_t next = pattern;
+            for (uint16_t i = 0; i < length; i++)
+            {
+                buffer[i] = next++;
+            }
+            if (a.send(buffer, length) >= 0)
+            {
+                sent += length;
+                pattern = next;
+            }
+        }
+
+        a.process_outgoing_data();
+        b.process_outgoing_data();
+        phy_a.poll(bench_time_us);
+        phy_b.poll(bench_time_us);
+        a.process_incoming_data();
+        b.process_incoming_data();
+        a.tick();
+        b.tick();
+
+        // A cut loses every byte on the line, in both directions
+        if (transfer.cut_after && !cut && cut_us == 0 && receiver.received >= transfer.cut_after)
+        {
+            LoopbackConfig dead = transfer.line;
+            dead.burst_ppm = 1000000;
+            dead.burst_length = 0xFFFF;
+            configure_both(phy_a, phy_b, dead);
+            cut = true;
+            cut_us = bench_time_us;
+        }
+        if (cut && bench_time_us - cut_us >= transfer.cut_ms * 1000)
+        {
+            configure_both(phy_a, phy_b, transfer.line);
+            cut = false;
+        }
+        if (a.get_state() == ROBUST_STACK_STATE_ERROR || b.get_state() == ROBUST_STACK_STATE_ERROR)
+        {
+            failed = true;
+            break;
+        }
+
+        bench_time_us += BENCH_STEP_US;
+    }
+
+    uint64_t host_cycles = bench_cycles() - start_cycles;
+    RobustStackStats stats;
+    a.get_stats(stats);
+    double seconds = (bench_time_us - start_us) / 1e6;
+    const TransportLayerStats &transport = stats.transport[0];
+
+    printf("%-24s %s: %u/%u bytes, %s", transfer.name,
+           (receiver.received == transfer.bytes && receiver.in_order) ? "ok" : "incomplete",
+           receiver.received, transfer.bytes, receiver.in_order ? "in order" : "OUT OF ORDER");
+    if (failed)
+    {
+        printf(", stack error %.1f s after the cut", (bench_time_us - cut_us) / 1e6);
+    }
+    printf("\n");
+    printf("  goodput %.0f B/s", receiver.received / seconds);
+    if (transfer.line.baud_rate)
+    {
+        printf(" (line %.0f B/s)", transfer.line.baud_rate / 10.0);
+    }
+    printf(", %.0f frames/s, %.3f s\n", stats.link.frames_tx / seconds, seconds);
+    printf("  send-to-ack p50 %u ms p99 %u ms max %u ms, rtt p50 %u ms p99 %u ms\n",
+           transport.ack_latency_ms.percentile_ms(50), transport.ack_latency_ms.percentile_ms(99),
+           transport.ack_latency_ms.max_ms, transport.rtt_ms.percentile_ms(50),
+           transport.rtt_ms.percentile_ms(99));
+    printf("  retransmits %u rto + %u nack, suspended %u resumed %u\n", transport.retransmits,
+           transport.nack_retransmits, transport.sessions_suspended, transport.sessions_resumed);
+    printf("  host %.1f " BENCH_CYCLE_UNIT "/byte for both stacks and the line model\n",
+           receiver.received ? static_cast<double>(host_cycles) / receiver.received : 0.0);
+}
+
+/**
+ * @brief Physical layer that accepts and discards everything, for LinkLayer::send()
+ */
+class BenchSinkPhysicalLayer : public PhysicalLayer
+{
+public:
+    virtual void initialize() {}
+    virtual void deinitialize() {}
+    virtual int send(const uint8_t *data, uint16_t length)
+    {
+        (void)data;
+        return length;
+    }
+    virtual int on_receive(const uint8_t *data, uint16_t length)
+    {
+        (void)data;
+        (void)length;
+        return 0;
+    }
+    virtual uint16_t get_max_payload_size() const
+    {
+        return 0xFFFF;
+    }
+};
+
+static void print_kernel(const char *name, uint16_t length, uint64_t cycles, uint32_t rounds)
+{
+    printf("  %-36s %4u bytes: %6.2f " BENCH_CYCLE_UNIT "/byte\n", name, length,
+           static_cast<double>(cycles) / (static_cast<double>(rounds) * length));
+}
+
+static void run_kernels(uint16_t length)
+{
+    static const uint32_t ROUNDS = 200000;
+    uint8_t payload[LINK_MAX_FRAME_SIZE];
+    uint8_t encoded[LINK_MAX_FRAME_SIZE + LINK_MAX_FRAME_SIZE / COBS_BLOCK_SIZE + 2];
+    uint8_t decoded[LINK_MAX_FRAME_SIZE];
+    uint32_t seed = 0x12345678;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        payload[i] = static_cast<uint8_t>(seed >> 24); // With zeros, as real payloads have
+    }
+    volatile uint32_t sink = 0;
+
+    uint64_t start = bench_cycles();
+    for (uint32_t i = 0; i < ROUNDS; i++)
+    {
+        sink += CRC16::calculate(payload, length);
+    }
+    print_kernel("CRC16::calculate()", length, bench_cycles() - start, ROUNDS);
+
+    int encoded_length = 0;
+    start = bench_cycles();
+    for (uint32_t i = 0; i < ROUNDS; i++)
+    {
+        encoded_length = COBS::encode(payload, length, encoded, sizeof(encoded));
+        sink += encoded[i % length];
+    }
+    print_kernel("COBS::encode()", length, bench_cycles() - start, ROUNDS);
+
+    encoded[encoded_length] = COBS_DELIMITER;
+    start = bench_cycles();
+    for (uint32_t i = 0; i < ROUNDS; i++)
+    {
+        uint16_t consumed = 0;
+        sink += COBS::decode(encoded, static_cast<uint16_t>(encoded_length + 1), decoded, sizeof(decoded),
+                             consumed);
+    }
+    print_kernel("COBS::decode()", length, bench_cycles() - start, ROUNDS);
+
+    // Framing with CRC and COBS into the queue, then the queue drained into a sink
+    if (length <= LINK_MAX_PAYLOAD_SIZE)
+    {
+        static LinkLayerStorage<> storage;
+        LinkLayer link(storage.buffers());
+        BenchSinkPhysicalLayer sink_phy;
+        link.set_down_layer(&sink_phy);
+        link.initialize();
+
+        uint64_t send_cycles = 0;
+        uint64_t drain_cycles = 0;
+        for (uint32_t i = 0; i < ROUNDS; i++)
+        {
+            start = bench_cycles();
+            link.send(payload, length);
+            uint64_t sent = bench_cycles();
+            link.process_outgoing_data();
+            drain_cycles += bench_cycles() - sent;
+            send_cycles += sent - start;
+        }
+        print_kernel("LinkLayer::send()", length, send_cycles, ROUNDS);
+        print_kernel("LinkLayer::process_outgoing_data()", length, drain_cycles, ROUNDS);
+    }
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = (argc > 1) ? argv[1] : NULL;
+    bool all = (only == NULL);
+
+    BenchTransfer transfers[] = {
+        {"clean", bench_line(0, 0), 500000, 0, 0, false},
+        {"lossy", bench_line(1000, 5), 500000, 0, 0, false},
+        {"cut, resumption", bench_line(0, 0), 100000, 30000, 4000, true},
+        {"cut, no resumption", bench_line(0, 0), 100000, 30000, 4000, false},
+        {"ideal", LoopbackConfig(), 5000000, 0, 0, false},
+    };
+    for (uint8_t i = 0; i < sizeof(transfers) / sizeof(transfers[0]); i++)
+    {
+        if (all || strncmp(transfers[i].name, only, strlen(only)) == 0)
+        {
+            run_transfer(transfers[i]);
+        }
+    }
+
+    if (all || strcmp(only, "kernels") == 0)
+    {
+        printf("kernels\n");
+        run_kernels(32);
+        run_kernels(LINK_MAX_PAYLOAD_SIZE);
+    }
+    return 0;
+}
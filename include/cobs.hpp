@@ -4,6 +4,32 @@
 #include <cstdint>
 #include "config.hpp"
 
+/**
+ * @brief COBS kernels, selected at compile time with COBS_KERNEL
+ *
+ * - COBS_KERNEL_BYTE: examine one byte per iteration. Default, smallest
+ *   code, suits 8/16-bit cores.
+ * - COBS_KERNEL_WORD: find zero bytes a machine word (32 or 64 bits) at a
+ *   time and copy zero-free runs with memmove(). Suits 32-bit cores and
+ *   hosts without SIMD.
+ * - COBS_KERNEL_SSE2: find zero bytes 16 at a time with SSE2 compares, for
+ *   x86 hosts; the copies are as with COBS_KERNEL_WORD.
+ *
+ * All kernels produce identical results, for the encoder, COBS::decode() and
+ * COBSDecoder alike.
+ */
+#define COBS_KERNEL_BYTE 1
+#define COBS_KERNEL_WORD 2
+#define COBS_KERNEL_SSE2 3
+
+#ifndef COBS_KERNEL
+#define COBS_KERNEL COBS_KERNEL_BYTE
+#endif
+
+#if COBS_KERNEL == COBS_KERNEL_SSE2 && !defined(__SSE2__)
+#error "COBS_KERNEL_SSE2 needs a target with SSE2"
+#endif
+
 namespace robust_serial
 {
 
@@ -48,6 +74,38 @@ public:
                      uint8_t* output, uint16_t output_size,
                      uint16_t& consumed_length);
 
+    /**
+     * @brief Encode data in place using COBS.
+     *
+     * The raw data is stored at buffer[offset] .. buffer[offset + length - 1]
+     * and the encoded frame is written from buffer[0]. An offset of 1 is
+     * enough for up to one block (254 bytes); each further block needs one
+     * more spare byte, see in_place_offset(). The output is identical to
+     * encode() and needs at most offset + length + 1 bytes of buffer.
+     *
+     * @param buffer Buffer holding the spare bytes followed by the raw data.
+     * @param offset Number of spare bytes ahead of the raw data.
+     * @param length Length of the raw data.
+     * @return The number of encoded bytes starting at buffer[0], or a negative error code.
+     */
+    static int encode_in_place(uint8_t* buffer, uint16_t offset, uint16_t length);
+
+    /**
+     * @brief Worst-case encoded size of length bytes, without the delimiter.
+     */
+    static uint32_t max_encoded_length(uint16_t length)
+    {
+        return static_cast<uint32_t>(length) + length / COBS_BLOCK_SIZE + 1;
+    }
+
+    /**
+     * @brief Smallest offset at which length bytes can be encoded in place.
+     */
+    static uint16_t in_place_offset(uint16_t length)
+    {
+        return (length == 0) ? 1 : 1 + (length - 1) / COBS_BLOCK_SIZE;
+    }
+
     // Error codes for COBS operations
     enum CobsError {
         COBS_SUCCESS = 0,
@@ -63,6 +121,74 @@ public:
 
 private:
     static const uint8_t COBS_MAX_CODE = 0xFF;  // Maximum value for a COBS code byte
+
+    friend class COBSDecoder;
+};
+
+/**
+ * @brief Incremental COBS decoder.
+ *
+ * Unlike COBS::decode(), which needs the complete frame up to its delimiter
+ * in one buffer, this decoder can be fed any number of bytes at a time. It
+ * keeps its position inside the current code block between calls and writes
+ * decoded bytes straight into the output buffer, so every received byte is
+ * examined exactly once.
+ *
+ * A frame that turns out to be malformed or too large for the output buffer
+ * is skipped up to its delimiter, after which decoding starts afresh.
+ */
+class COBSDecoder
+{
+public:
+    /**
+     * @brief Construct a decoder writing into a fixed output buffer.
+     *
+     * @param output Buffer that receives the decoded frame.
+     * @param output_size Size of the output buffer.
+     */
+    COBSDecoder(uint8_t* output, uint16_t output_size);
+
+    /**
+     * @brief Discard any partially decoded frame.
+     */
+    void reset();
+
+    /**
+     * @brief Feed encoded bytes into the decoder.
+     *
+     * Decoding stops right after a delimiter, so a chunk holding several
+     * frames is processed by calling feed() again with the remaining bytes.
+     * The decoded frame stays in the output buffer until the next call.
+     *
+     * @param input Pointer to the encoded input bytes.
+     * @param length Number of input bytes.
+     * @param consumed_length Reference to a variable where the number of bytes consumed will be stored.
+     * @return The decoded frame length once its delimiter was consumed,
+     *         COBS::COBS_ERROR_INCOMPLETE if all input was consumed without
+     *         reaching a delimiter, or another negative error code for a
+     *         frame that was dropped.
+     */
+    int feed(const uint8_t* input, uint16_t length, uint16_t& consumed_length);
+
+    /**
+     * @brief Check whether the decoder is inside a frame.
+     *
+     * @return true if bytes of an unfinished frame have been consumed.
+     */
+    bool in_frame() const { return in_frame_; }
+
+private:
+    uint8_t* output_;       // Decoded frame
+    uint16_t output_size_;  // Capacity of output_
+    uint16_t write_index_;  // Decoded bytes so far
+    uint8_t remaining_;     // Data bytes left in the current code block
+    bool pending_zero_;     // A zero is due before the next code block
+    bool in_frame_;         // At least one byte of the current frame was consumed
+    int error_;             // Error of the current frame, COBS_SUCCESS if none
+
+    // Prevent copy and assignment
+    COBSDecoder(const COBSDecoder&);
+    COBSDecoder& operator=(const COBSDecoder&);
 };
 
 } // namespace robust_serial
@@ -0,0 +1,127 @@
+#ifndef __COMPRESSION_LAYER_HPP__
+#define __COMPRESSION_LAYER_HPP__
+
+#include "layer.hpp"
+#include "link_layer.hpp"      // For LINK_MAX_PAYLOAD_SIZE
+#include "transport_layer.hpp" // For TRANSPORT_PACKET_TYPE_MAX
+#include "lz.hpp"
+
+/**
+ * @brief Shortest payload worth compressing
+ *
+ * Shorter payloads, e.g. acknowledgments and keep-alives, are sent as they
+ * are without trying.
+ */
+#ifndef COMPRESSION_MIN_LENGTH
+#define COMPRESSION_MIN_LENGTH 16
+#endif
+
+/**
+ * @brief First byte of a compressed frame
+ *
+ * Raw frames carry a transport packet whose first byte is a packet type,
+ * optionally with TRANSPORT_PACKET_FLAG_ACK, so this value marks a frame
+ * whose remaining bytes are LZ-compressed.
+ */
+#define COMPRESSION_FRAME_COMPRESSED 0x40
+
+static_assert(TRANSPORT_PACKET_TYPE_MAX <= COMPRESSION_FRAME_COMPRESSED &&
+                  (COMPRESSION_FRAME_COMPRESSED & TRANSPORT_PACKET_FLAG_ACK) == 0,
+              "COMPRESSION_FRAME_COMPRESSED must not be a transport packet type");
+
+namespace robust_serial
+{
+
+/**
+ * @brief Compression layer counters, see CompressionLayer::get_stats()
+ */
+struct CompressionLayerStats
+{
+    uint32_t frames_compressed;   /**< Frames sent compressed */
+    uint32_t frames_raw;          /**< Frames sent as they are while compression was enabled */
+    uint32_t bytes_in;            /**< Payload bytes of frames_compressed before compression */
+    uint32_t bytes_out;           /**< Bytes of frames_compressed after compression, with the marker */
+    uint32_t frames_decompressed; /**< Compressed frames received */
+    uint32_t decompress_errors;   /**< Compressed frames dropped as malformed */
+};
+
+/**
+ * @brief Optional payload compression between the transport and link layers
+ *
+ * Sits between TransportMux and LinkLayer. While enabled, every payload of at
+ * least COMPRESSION_MIN_LENGTH bytes is compressed with LZ, one frame at a
+ * time, and sent as [COMPRESSION_FRAME_COMPRESSED | compressed data] if that
+ * is shorter; any other payload is sent unchanged, so incompressible data
+ * costs no extra byte. Received frames are decompressed whenever they carry
+ * the marker, whether or not sending is enabled.
+ *
+ * Compression must only be enabled once the peer is known to decompress;
+ * RobustStack negotiates that with TRANSPORT_OPTION_COMPRESSION in the
+ * SYN/SYN-ACK handshake. All buffers are members, nothing is allocated.
+ */
+class CompressionLayer final : public Layer
+{
+public:
+    CompressionLayer();
+    virtual ~CompressionLayer();
+
+    virtual void initialize();
+    virtual void deinitialize();
+
+    virtual int send(const uint8_t *data, uint16_t length);
+    virtual int send(const uint8_t *data, uint16_t length, uint8_t priority);
+    virtual uint8_t *reserve(uint16_t length);
+    virtual uint8_t *reserve(uint16_t length, uint8_t priority);
+    virtual int commit(uint16_t length);
+    virtual int on_receive(const uint8_t *data, uint16_t length);
+    virtual uint16_t get_max_payload_size() const
+    {
+        return down_layer ? down_layer->get_max_payload_size() : 0;
+    }
+
+    /**
+     * @brief Compress outgoing payloads or pass them through unchanged
+     *
+     * Reservations are forwarded to the lower layer only while disabled;
+     * while enabled, reserve() returns NULL and payloads go through send().
+     */
+    void set_enabled(bool enabled)
+    {
+        enabled_ = enabled;
+    }
+
+    bool is_enabled() const
+    {
+        return enabled_;
+    }
+
+    /**
+     * @brief Copy the current counters
+     */
+    void get_stats(CompressionLayerStats &stats) const
+    {
+        stats = stats_;
+    }
+
+    /**
+     * @brief Set all counters back to zero
+     */
+    void reset_stats();
+
+private:
+    bool enabled_;
+
+    uint16_t hash_table_[LZ_HASH_SIZE];           // Match finder of the compressor
+    uint8_t tx_buffer_[LINK_MAX_PAYLOAD_SIZE];     // Staging buffer when the link layer cannot reserve
+    uint8_t rx_buffer_[LINK_MAX_PAYLOAD_SIZE];     // Decompressed frame
+
+    CompressionLayerStats stats_;
+
+    // Prevent copy and assignment
+    CompressionLayer(const CompressionLayer &);
+    CompressionLayer &operator=(const CompressionLayer &);
+};
+
+} // namespace robust_serial
+
+#endif // __COMPRESSION_LAYER_HPP__
@@ -26,6 +26,8 @@ static const int32_t LAYER_SUCCESS = 0;
  * 
  * Note: This is the maximum size of the actual data payload. The
  * total frame size will be larger due to headers, CRC, and COBS encoding.
+ * Link frames larger than one block (see LINK_MAX_FRAME_SIZE) are encoded
+ * as several consecutive blocks.
  */
 static const uint16_t COBS_MAX_BLOCK_SIZE = 254;    // Maximum size of raw data before COBS encoding
 
@@ -41,7 +43,8 @@ static const uint16_t COBS_MAX_BLOCK_SIZE = 254;    // Maximum size of raw data
  * 
  * This is the maximum size that any frame can have after COBS encoding,
  * including all overhead bytes. This value is critical for buffer sizing
- * in both the physical and link layers.
+ * in both the physical and link layers. In large-frame mode the link layer
+ * sizes its buffers with LINK_FRAME_SLOT_SIZE() instead.
  */
 static const uint16_t COBS_MAX_ENCODED_SIZE = 257;      // Maximum size after COBS encoding (including delimiter)
 
@@ -3,12 +3,50 @@
 
 #include <cstdint>
 
+/**
+ * @brief CRC16 backends, selected at compile time with CRC16_BACKEND
+ *
+ * - CRC16_BACKEND_TABLE: one 256-entry table lookup per byte (512 bytes of
+ *   tables). Default, suits small cores.
+ * - CRC16_BACKEND_SLICE_BY_4 / CRC16_BACKEND_SLICE_BY_8: process 4 or 8 bytes
+ *   per iteration with 4 or 8 tables (2 KB / 4 KB). Suits cores with a data
+ *   cache and a host PC.
+ * - CRC16_BACKEND_HARDWARE: forward to crc16_hardware_update(), provided by
+ *   the port for a CRC peripheral (see port/crc16_hw_stm32.cpp).
+ *
+ * All backends produce identical results.
+ */
+#define CRC16_BACKEND_TABLE      1
+#define CRC16_BACKEND_SLICE_BY_4 2
+#define CRC16_BACKEND_SLICE_BY_8 3
+#define CRC16_BACKEND_HARDWARE   4
+
+#ifndef CRC16_BACKEND
+#define CRC16_BACKEND CRC16_BACKEND_TABLE
+#endif
+
 namespace robust_serial
 {
 
+#if CRC16_BACKEND == CRC16_BACKEND_HARDWARE
+/**
+ * @brief Continue a CRC-16-CCITT calculation on a hardware CRC unit
+ *
+ * This is a platform-specific function that must be implemented by the port
+ * when CRC16_BACKEND is CRC16_BACKEND_HARDWARE. It must behave exactly like
+ * CRC16::update() (polynomial 0x1021, MSB first, no reflection, no final XOR).
+ *
+ * @param crc CRC value to continue from
+ * @param data Buffer to process
+ * @param length Length of data buffer
+ * @return Updated CRC16 value
+ */
+uint16_t crc16_hardware_update(uint16_t crc, const uint8_t *data, uint16_t length);
+#endif
+
 /**
  * @brief CRC16 calculation class
- * 
+ *
  * This class provides CRC16 calculation functionality using a lookup table
  * for improved performance. The CRC16 implementation uses the standard
  * polynomial 0x1021 (CRC-16-CCITT).
@@ -18,12 +56,30 @@ class CRC16
 public:
     /**
      * @brief Calculate CRC16 for a data buffer
-     * 
+     *
      * @param data Buffer to calculate CRC for
      * @param length Length of data buffer
      * @return Calculated CRC16 value
      */
-    static uint16_t calculate(const uint8_t *data, uint16_t length);
+    static uint16_t calculate(const uint8_t *data, uint16_t length)
+    {
+        return update(CRC_INITIAL_VALUE, data, length);
+    }
+
+    /**
+     * @brief Continue a CRC16 calculation over more data
+     *
+     * Allows the CRC of a frame to be computed piecewise, e.g. over a header
+     * and a payload held in different buffers. Starting from
+     * CRC_INITIAL_VALUE, update() over consecutive pieces equals calculate()
+     * over their concatenation.
+     *
+     * @param crc CRC value returned by the previous call, or CRC_INITIAL_VALUE
+     * @param data Buffer to process
+     * @param length Length of data buffer
+     * @return Updated CRC16 value
+     */
+    static uint16_t update(uint16_t crc, const uint8_t *data, uint16_t length);
 
     // CRC Configuration
     static const uint16_t CRC_POLYNOMIAL = 0x1021;    // CRC-16-CCITT polynomial
@@ -31,6 +87,14 @@ public:
 
 private:
     static const uint16_t CRC16_TABLE[256];  // Lookup table for CRC16 calculation
+
+#if CRC16_BACKEND == CRC16_BACKEND_SLICE_BY_4 || CRC16_BACKEND == CRC16_BACKEND_SLICE_BY_8
+    // Tables on top of CRC16_TABLE, 3 or 7 for slice-by-4 or slice-by-8
+    static const uint8_t CRC16_SLICE_TABLES = (CRC16_BACKEND == CRC16_BACKEND_SLICE_BY_8) ? 7 : 3;
+
+    // CRC16_SLICE_TABLE[k - 1][b]: contribution of byte b followed by k zero bytes
+    static const uint16_t CRC16_SLICE_TABLE[CRC16_SLICE_TABLES][256];
+#endif
 };
 
 } // namespace robust_serial
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <cstddef>  // Required for NULL
+#include <cstring>  // For memcpy()
 #include "config.hpp"
 
 namespace robust_serial
@@ -23,9 +24,74 @@ enum LayerError {
     LAYER_ERROR_INVALID_PARAM = -3,    // Invalid parameter
     LAYER_ERROR_PAYLOAD_TOO_LARGE = -4, // Payload exceeds maximum size
     LAYER_ERROR_NOT_IMPLEMENTED = -5,   // Method not implemented by layer
-    LAYER_ERROR_INVALID_STATE = -6      // Layer is in an invalid state
+    LAYER_ERROR_INVALID_STATE = -6,     // Layer is in an invalid state
+    LAYER_ERROR_BUSY = -7               // Layer cannot take received data yet, deliver it again later
 };
 
+/**
+ * @brief Transmission priority classes, highest first
+ *
+ * Layers that queue outgoing data (the link layer) transmit queued frames of
+ * a higher class before those of a lower class, switching at frame
+ * boundaries.
+ */
+enum LayerPriority {
+    LAYER_PRIORITY_CONTROL = 0,  // Acknowledgments, keep-alives and connection management
+    LAYER_PRIORITY_DATAGRAM = 1, // Low-latency datagrams, e.g. telemetry
+    LAYER_PRIORITY_BULK = 2      // Reliable data
+};
+
+#define LAYER_PRIORITY_COUNT 3
+
+/**
+ * @brief One piece of a payload scattered over several buffers, see send_v()
+ */
+struct LayerSegment
+{
+    const uint8_t *data; /**< Segment bytes, may be NULL if length is 0 */
+    uint16_t length;     /**< Segment length in bytes */
+};
+
+/**
+ * @brief Get the total length of a segment list
+ *
+ * @return Sum of the segment lengths, or LAYER_ERROR_INVALID_PARAM if the
+ *         list or a non-empty segment has no data
+ */
+inline int32_t layer_segments_length(const LayerSegment *segments, uint8_t count)
+{
+    if (!segments && count > 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    int32_t length = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!segments[i].data && segments[i].length > 0)
+        {
+            return LAYER_ERROR_INVALID_PARAM;
+        }
+        length += segments[i].length;
+    }
+    return length;
+}
+
+/**
+ * @brief Copy a segment list into one contiguous buffer
+ */
+inline void layer_gather_segments(uint8_t *destination, const LayerSegment *segments, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (segments[i].length > 0)
+        {
+            memcpy(destination, segments[i].data, segments[i].length);
+            destination += segments[i].length;
+        }
+    }
+}
+
 /**
  * @brief Interface for communication layers
  * 
@@ -62,6 +128,22 @@ public:
      */
     virtual int send(const uint8_t *data, uint16_t length) = 0;
 
+    /**
+     * @brief Send data down through the layer stack with a priority class
+     *
+     * Layers without priority queues ignore the priority.
+     *
+     * @param data Pointer to data buffer
+     * @param length Length of data in bytes
+     * @param priority One of LayerPriority
+     * @return Bytes processed on success, error code on failure
+     */
+    virtual int send(const uint8_t *data, uint16_t length, uint8_t priority)
+    {
+        (void)priority;
+        return send(data, length);
+    }
+
     /**
      * @brief Process received data from lower layer
      * 
@@ -71,6 +153,42 @@ public:
      */
     virtual int on_receive(const uint8_t *data, uint16_t length) = 0;
 
+    /**
+     * @brief Reserve space for an outgoing payload inside this layer's buffers
+     *
+     * Lets the upper layer build its packet in place instead of handing a
+     * separate buffer to send(). The returned area stays valid until commit()
+     * or the next reserve(); only one reservation may be open at a time.
+     *
+     * @param length Maximum number of bytes the caller will write
+     * @return Pointer to the reserved area, or NULL if reservations are not
+     *         supported or there is no room (use send() instead)
+     */
+    virtual uint8_t *reserve(uint16_t length) { (void)length; return NULL; }
+
+    /**
+     * @brief Reserve space for an outgoing payload of a priority class
+     *
+     * Like reserve(length); commit() sends the payload with that priority.
+     *
+     * @param length Maximum number of bytes the caller will write
+     * @param priority One of LayerPriority
+     * @return Pointer to the reserved area, or NULL (use send() instead)
+     */
+    virtual uint8_t *reserve(uint16_t length, uint8_t priority)
+    {
+        (void)priority;
+        return reserve(length);
+    }
+
+    /**
+     * @brief Send the payload written into the area returned by reserve()
+     *
+     * @param length Number of bytes actually written (at most the reserved length)
+     * @return Bytes processed on success, error code on failure
+     */
+    virtual int commit(uint16_t length) { (void)length; return LAYER_ERROR_NOT_IMPLEMENTED; }
+
     /**
      * @brief Get maximum payload size for this layer
      * 
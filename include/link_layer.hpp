@@ -6,22 +6,105 @@
 #include "crc16.hpp"
 #include "cobs.hpp"
 #include "physical_layer.hpp"
+#include "ring_buffer.hpp"
+#include <atomic>
 
 namespace robust_serial
 {
 
 // Link Layer Frame Structure
-#define LINK_HEADER_SIZE      2                                                        // type(1) + length(1)
+//
+// LINK_MAX_FRAME_SIZE may be raised up to 4096 bytes for high-bandwidth links.
+// Frames larger than one COBS block (254 bytes) switch the link header to a
+// 16-bit little-endian length field; both peers must use the same setting.
+#ifndef LINK_MAX_FRAME_SIZE
+#define LINK_MAX_FRAME_SIZE 254 // COBS_MAX_BLOCK_SIZE: one COBS block per frame
+#endif
+
+#if LINK_MAX_FRAME_SIZE < 16 || LINK_MAX_FRAME_SIZE > 4096
+#error "LINK_MAX_FRAME_SIZE must be between 16 and 4096 bytes"
+#endif
+
+#if LINK_MAX_FRAME_SIZE > 254
+#define LINK_LARGE_FRAMES     1
+#define LINK_LENGTH_SIZE      2 // 16-bit length field
+#else
+#define LINK_LARGE_FRAMES     0
+#define LINK_LENGTH_SIZE      1 // 8-bit length field
+#endif
+
+#define LINK_HEADER_SIZE      (1 + LINK_LENGTH_SIZE)                                   // type(1) + length(1 or 2)
 #define LINK_CRC_SIZE         2                                                        // CRC16 size in bytes
-#define LINK_MIN_FRAME_SIZE   (LINK_HEADER_SIZE + LINK_CRC_SIZE)                       // 4 bytes
-#define LINK_MAX_FRAME_SIZE   COBS_MAX_BLOCK_SIZE                                      // 254 bytes
-#define LINK_MAX_PAYLOAD_SIZE (COBS_MAX_BLOCK_SIZE - LINK_HEADER_SIZE - LINK_CRC_SIZE) // 250 bytes
+#define LINK_MIN_FRAME_SIZE   (LINK_HEADER_SIZE + LINK_CRC_SIZE)                       // 4 bytes (5 with large frames)
+#define LINK_MAX_PAYLOAD_SIZE (LINK_MAX_FRAME_SIZE - LINK_HEADER_SIZE - LINK_CRC_SIZE) // 250 bytes by default
+
+// In-place encoding: spare bytes ahead of the frame, one per started COBS block
+#define LINK_COBS_PREFIX_SIZE (1 + (LINK_MAX_FRAME_SIZE - 1) / COBS_MAX_BLOCK_SIZE)
+// Buffer space reserved for one frame: prefix + frame + trailing COBS code + delimiter
+#define LINK_FRAME_SLOT_SIZE(frame_length) (LINK_COBS_PREFIX_SIZE + (frame_length) + 2)
 
-#define LINK_OUTGOING_BUFFER_SIZE (COBS_MAX_ENCODED_SIZE * 2)
-#define LINK_INCOMING_BUFFER_SIZE (COBS_MAX_ENCODED_SIZE * 2)
+/**
+ * @brief Default size of a link queue: minimum, or more if one encoded frame
+ *        of LINK_MAX_FRAME_SIZE needs it
+ */
+constexpr uint16_t link_default_queue_size(uint16_t minimum)
+{
+    return (ring_buffer_capacity_for(LINK_FRAME_SLOT_SIZE(LINK_MAX_FRAME_SIZE)) > minimum)
+               ? static_cast<uint16_t>(ring_buffer_capacity_for(LINK_FRAME_SLOT_SIZE(LINK_MAX_FRAME_SIZE)))
+               : minimum;
+}
+
+// Default queue sizes (ring buffers: power of two, at least one encoded frame),
+// see LinkLayerStorage for per-instance sizes. The bulk, datagram and incoming
+// queues grow with LINK_MAX_FRAME_SIZE, so every frame size builds with the
+// defaults.
+//
+// Outgoing frames are queued by LayerPriority: control frames and datagrams
+// have queues of their own; LINK_OUTGOING_BUFFER_SIZE is the bulk data queue.
+#ifndef LINK_OUTGOING_BUFFER_SIZE
+#define LINK_OUTGOING_BUFFER_SIZE ::robust_serial::link_default_queue_size(1024)
+#endif
+#ifndef LINK_DATAGRAM_BUFFER_SIZE
+#define LINK_DATAGRAM_BUFFER_SIZE ::robust_serial::link_default_queue_size(512)
+#endif
+#ifndef LINK_CONTROL_BUFFER_SIZE
+#define LINK_CONTROL_BUFFER_SIZE 128 // Control packets are small; several fit
+#endif
+#ifndef LINK_INCOMING_BUFFER_SIZE
+#define LINK_INCOMING_BUFFER_SIZE ::robust_serial::link_default_queue_size(1024)
+#endif
 
 // Frame Types
-#define LINK_FRAME_TYPE_DATA 0x01 // Data frame type
+#define LINK_FRAME_TYPE_DATA       0x01 // Data frame type
+#define LINK_FRAME_TYPE_FEC_PARITY 0x80 // 0x80 | GROUP(2) << 4 | COUNT(4), see set_fec()
+#define LINK_FRAME_TYPE_FEC_DATA   0xC0 // 0xC0 | GROUP(2) << 4 | INDEX(4)
+#define LINK_FRAME_TYPE_FEC_MASK   0xC0
+
+// Forward error correction of bulk frames, see LinkLayer::set_fec()
+//
+// Costs two LINK_MAX_PAYLOAD_SIZE buffers, so it is left out unless LINK_FEC
+// is set to 1. Without it, the data frames of a peer that sends FEC are
+// received as plain frames and its parity frames are skipped.
+#ifndef LINK_FEC
+#define LINK_FEC 0
+#endif
+#define LINK_FEC_MAX_GROUP_SIZE 15 // Data frames per parity frame, limited by the 4-bit index
+
+// Received frames over which the CRC error rate is measured for adaptive FEC
+#ifndef LINK_FEC_WINDOW_FRAMES
+#define LINK_FEC_WINDOW_FRAMES 64
+#endif
+
+/**
+ * @brief Report LINK_LAYER_EVENT_FRAME_SENT and LINK_LAYER_EVENT_FRAME_RECEIVED
+ *
+ * Per-frame events cost a call into the stack manager for every frame, and
+ * RobustStack has no use for them, so they are compiled out unless a custom
+ * stack manager asks for them.
+ */
+#ifndef LINK_FRAME_EVENTS
+#define LINK_FRAME_EVENTS 0
+#endif
 
 /**
  * @brief Link Layer States
@@ -65,6 +148,82 @@ enum LinkLayerEvent
     LINK_LAYER_EVENT_INCOMING_DATA_AVAILABLE  // New data available in incoming buffer
 };
 
+/**
+ * @brief Link layer counters, see LinkLayer::get_stats()
+ *
+ * Counters start at zero on construction and wrap around; they are not
+ * cleared by reset() or reconnections, only by reset_stats().
+ */
+struct LinkLayerStats
+{
+    uint32_t frames_tx;            /**< Frames queued for transmission */
+    uint32_t frames_rx;            /**< Valid frames received */
+    uint32_t bytes_tx;             /**< Encoded bytes handed to the physical layer */
+    uint32_t bytes_rx;             /**< Encoded bytes taken from the incoming queue */
+    uint32_t crc_errors;           /**< Frames dropped because the CRC did not match */
+    uint32_t cobs_errors;          /**< Frames dropped because of invalid COBS or excessive length */
+    uint32_t invalid_frames;       /**< Frames dropped because of a bad length field or unknown type */
+    uint32_t resync_dropped_bytes; /**< Encoded bytes discarded along with dropped frames */
+    uint32_t rx_overflows;         /**< Received chunks dropped because the incoming queue was full */
+    uint32_t rx_overflow_bytes;    /**< Bytes in those chunks */
+    uint32_t tx_overflows;         /**< Frames rejected because the outgoing queue was full */
+    uint32_t fec_parity_tx;        /**< Parity frames queued, not included in frames_tx */
+    uint32_t fec_parity_rx;        /**< Valid parity frames received, not included in frames_rx */
+    uint32_t fec_recovered;        /**< Lost frames rebuilt from a parity frame */
+    uint32_t fec_unrecoverable;    /**< Parity frames that came too late to rebuild a group's losses */
+};
+
+/**
+ * @brief Queue storage of one LinkLayer, see LinkLayerStorage
+ *
+ * Each queue is a ring buffer: its size must be a power of two of at most
+ * 32768 that holds at least one encoded frame (LINK_FRAME_SLOT_SIZE of
+ * LINK_MAX_FRAME_SIZE); the control queue needs 32 bytes.
+ */
+struct LinkLayerBuffers
+{
+    uint8_t *outgoing;      /**< Bulk data frames */
+    uint16_t outgoing_size;
+    uint8_t *incoming;      /**< Raw bytes from the physical layer */
+    uint16_t incoming_size;
+    uint8_t *datagram;      /**< Datagram frames */
+    uint16_t datagram_size;
+    uint8_t *control;       /**< Control frames */
+    uint16_t control_size;
+};
+
+/**
+ * @brief Statically sized queues for one LinkLayer, checked at compile time
+ *
+ * Sized per instance, so that a small node can shrink its queues and a
+ * gateway deepen them; the defaults are the LINK_*_BUFFER_SIZE macros.
+ * Must outlive the LinkLayer using it.
+ */
+template <uint16_t OUTGOING = LINK_OUTGOING_BUFFER_SIZE, uint16_t INCOMING = LINK_INCOMING_BUFFER_SIZE,
+          uint16_t DATAGRAM = LINK_DATAGRAM_BUFFER_SIZE, uint16_t CONTROL = LINK_CONTROL_BUFFER_SIZE>
+struct LinkLayerStorage
+{
+    static_assert(RING_BUFFER_VALID_SIZE(OUTGOING) && RING_BUFFER_VALID_SIZE(INCOMING) &&
+                      RING_BUFFER_VALID_SIZE(DATAGRAM) && RING_BUFFER_VALID_SIZE(CONTROL),
+                  "Link layer buffer sizes must be powers of two between 2 and 32768");
+    static_assert(OUTGOING >= LINK_FRAME_SLOT_SIZE(LINK_MAX_FRAME_SIZE) &&
+                      DATAGRAM >= LINK_FRAME_SLOT_SIZE(LINK_MAX_FRAME_SIZE) &&
+                      INCOMING >= LINK_FRAME_SLOT_SIZE(LINK_MAX_FRAME_SIZE),
+                  "Link layer buffers must hold at least one encoded frame");
+    static_assert(CONTROL >= 32, "Link control queue must hold a control frame");
+
+    uint8_t outgoing[OUTGOING];
+    uint8_t incoming[INCOMING];
+    uint8_t datagram[DATAGRAM];
+    uint8_t control[CONTROL];
+
+    LinkLayerBuffers buffers()
+    {
+        LinkLayerBuffers result = {outgoing, OUTGOING, incoming, INCOMING, datagram, DATAGRAM, control, CONTROL};
+        return result;
+    }
+};
+
 /**
  * @brief Link Layer implementation providing frame integrity.
  *
@@ -80,16 +239,41 @@ enum LinkLayerEvent
  *
  * Data Flow:
  * Outgoing:
- * 1. Upper layer calls send() to queue data
+ * 1. Upper layer calls send() to queue data, or reserve()/commit() to build
+ *    the payload directly inside the outgoing queue of its priority class
  * 2. Layer reports LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE
  * 3. Event handler calls process_outgoing_data()
- * 4. Layer sends data and reports LINK_LAYER_EVENT_FRAME_SENT
+ * 4. Layer sends data and, with LINK_FRAME_EVENTS, reports
+ *    LINK_LAYER_EVENT_FRAME_SENT for each complete frame
+ *
+ * TX scheduling:
+ * Each LayerPriority class has its own queue. Whenever a frame has been
+ * handed to the physical layer completely, the next frame comes from the
+ * highest-priority queue that is not empty, so acknowledgments and
+ * keep-alives are never stuck behind bulk data and telemetry datagrams
+ * overtake queued bulk transfers. A frame is never interrupted once started;
+ * the wait for a control frame is bounded by one bulk frame. Frames of one
+ * class keep their order.
+ *
+ * Asynchronous physical layers (see PhysicalLayer):
+ * With PHYSICAL_CAPABILITY_ASYNC_TX, process_outgoing_data() only starts a
+ * transfer if none is running; each transfer complete starts the next span
+ * from the interrupt, by the same priority rules, until the queues are
+ * empty. With PHYSICAL_CAPABILITY_ASYNC_RX the physical layer writes
+ * straight into the incoming queue. In both cases no byte is copied and the
+ * physical layer owns that end of the queue, as described for the
+ * interrupt-safe functions below.
  *
  * Incoming:
  * 1. Physical layer calls on_receive() to queue data
  * 2. Layer reports LINK_LAYER_EVENT_INCOMING_DATA_AVAILABLE
  * 3. Event handler calls process_incoming_data()
- * 4. Layer processes data and reports LINK_LAYER_EVENT_FRAME_RECEIVED
+ * 4. Layer feeds the queued bytes through a streaming COBS decoder and, as
+ *    soon as a delimiter completes a frame, validates it, forwards it and,
+ *    with LINK_FRAME_EVENTS, reports LINK_LAYER_EVENT_FRAME_RECEIVED
+ *
+ * The data-available events of step 2 can be switched off with
+ * set_data_events() when nothing waits for them, e.g. a stack that polls.
  *
  * Frame Structure (before COBS encoding):
  * +------------+-------------+-----------------+------------+
@@ -97,9 +281,14 @@ enum LinkLayerEvent
  * |  0x01      |   0-250     |    data...      |            |
  * +------------+-------------+-----------------+------------+
  *
+ * With LINK_MAX_FRAME_SIZE above 254 (large-frame mode) LENGTH is 2 bytes,
+ * little endian, and the encoded frame spans several COBS blocks.
+ *
  * Frame Types:
  * Current:
  * - DATA (0x01): Contains payload data
+ * - FEC_PARITY (0x80-0xBF): Parity of a group of FEC_DATA frames
+ * - FEC_DATA (0xC0-0xFF): Payload data protected by forward error correction
  *
  * Reserved for Future Use:
  * - CONTROL (0x02): Link control frames (e.g., link configuration, status)
@@ -112,15 +301,34 @@ enum LinkLayerEvent
  * Notes:
  * - All frames are COBS encoded before transmission
  * - FRAME_DELIMITER (0x00) is added after COBS encoding
- * - Maximum payload size is 250 bytes (254 - 4 bytes overhead)
- * - Total frame size before encoding is 254 bytes (1 + 1 + 250 + 2)
+ * - Maximum payload size is LINK_MAX_PAYLOAD_SIZE, 250 bytes by default
+ *   (254 - 4 bytes overhead)
+ * - Total frame size before encoding is at most LINK_MAX_FRAME_SIZE
  * - CRC16 is calculated over all preceding bytes
  * - Uses event-driven architecture for data flow control
+ *
+ * Forward Error Correction:
+ * While FEC is active, bulk frames are sent as FEC_DATA in groups of up to
+ * LINK_FEC_MAX_GROUP_SIZE, numbered by INDEX within a group and by a 2-bit
+ * GROUP counter. Each group is followed by one parity frame:
+ * +------------------+------------------+-----------------+------------+
+ * | TYPE (1B)        | LENGTH (1B)      | PARITY (0-nB)   | CRC16 (2B) |
+ * | 0x80|GROUP|COUNT | XOR of lengths   | XOR of payloads |            |
+ * +------------------+------------------+-----------------+------------+
+ * PARITY is as long as the longest payload of the group, shorter payloads
+ * count as zero-padded; the frame's own length follows from its delimiter.
+ * A receiver that misses exactly one of the COUNT data frames of a group,
+ * lost or dropped for a bad CRC, rebuilds it from the others and the parity
+ * and forwards it late; the transport layer orders it like a retransmission.
+ * Receiving is always enabled, so peers need not agree on the setting.
  */
-class LinkLayer : public Layer
+class LinkLayer final : public Layer
 {
 public:
-    LinkLayer();
+    /**
+     * @param buffers Queue storage, must outlive the layer; see LinkLayerStorage
+     */
+    explicit LinkLayer(const LinkLayerBuffers &buffers);
     virtual ~LinkLayer();
 
     /**
@@ -132,6 +340,19 @@ public:
     virtual void initialize();
     virtual void deinitialize();
 
+    using Layer::set_down_layer;
+
+    /**
+     * @brief Connect to the physical layer below
+     *
+     * Keeps a typed pointer so that queued data can be handed over as spans
+     * with PhysicalLayer::send_spans().
+     *
+     * @param layer Pointer to the physical layer
+     * @return LAYER_SUCCESS on success, error code on failure
+     */
+    int set_down_layer(PhysicalLayer *layer);
+
     /**
      * @brief Sends a frame through the physical layer.
      *
@@ -147,6 +368,47 @@ public:
      */
     virtual int send(const uint8_t *data, uint16_t length);
 
+    /**
+     * @brief Sends a frame through the queue of a priority class
+     *
+     * @param data Pointer to the data to send
+     * @param length Length of the data in bytes
+     * @param priority One of LayerPriority; send(data, length) uses LAYER_PRIORITY_BULK
+     * @return LINK_SUCCESS on success, negative error code on failure
+     */
+    virtual int send(const uint8_t *data, uint16_t length, uint8_t priority);
+
+    /**
+     * @brief Sends one frame whose payload is scattered over several buffers
+     *
+     * The segments are gathered straight into the frame slot in the outgoing
+     * queue, where the frame is CRC'd and COBS-encoded in place; no
+     * contiguous copy is needed beforehand.
+     *
+     * @param segments Payload pieces, in order
+     * @param count Number of segments
+     * @param priority One of LayerPriority
+     * @return LINK_SUCCESS on success, negative error code on failure
+     */
+    int send_v(const LayerSegment *segments, uint8_t count, uint8_t priority);
+    int send_v(const LayerSegment *segments, uint8_t count)
+    {
+        return send_v(segments, count, LAYER_PRIORITY_BULK);
+    }
+
+    /**
+     * @brief Queue several frames under one notification
+     *
+     * Between begin_batch() and the matching end_batch(), committed frames
+     * do not report LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE each; end_batch()
+     * reports it once if any frame was queued. Batches may nest.
+     */
+    void begin_batch()
+    {
+        batch_depth_++;
+    }
+    void end_batch();
+
     /**
      * @brief Processes received data from the physical layer.
      *
@@ -158,6 +420,36 @@ public:
      */
     virtual int on_receive(const uint8_t *data, uint16_t length);
 
+    /**
+     * @brief Reserves a frame slot at the end of the bulk outgoing queue.
+     *
+     * The caller writes the payload straight into the returned area. commit()
+     * then adds the header, computes the CRC and COBS-encodes the frame in
+     * place, so the payload is never copied again before it reaches the
+     * physical layer.
+     *
+     * @param length Maximum payload length (at most LINK_MAX_PAYLOAD_SIZE)
+     * @return Pointer to the payload area, or NULL if the frame does not fit
+     */
+    virtual uint8_t *reserve(uint16_t length);
+
+    /**
+     * @brief Reserves a frame slot in the outgoing queue of a priority class.
+     *
+     * @param length Maximum payload length (at most LINK_MAX_PAYLOAD_SIZE)
+     * @param priority One of LayerPriority
+     * @return Pointer to the payload area, or NULL if the frame does not fit
+     */
+    virtual uint8_t *reserve(uint16_t length, uint8_t priority);
+
+    /**
+     * @brief Completes and queues the frame opened by reserve().
+     *
+     * @param length Payload length actually written
+     * @return LINK_SUCCESS on success, negative error code on failure
+     */
+    virtual int commit(uint16_t length);
+
     virtual uint16_t get_max_payload_size() const
     {
         return LINK_MAX_PAYLOAD_SIZE;
@@ -176,7 +468,7 @@ public:
      * @brief Check if a payload size is valid
      *
      * Validates that the payload size is within the maximum allowed size
-     * (LINK_MAX_PAYLOAD_SIZE) to ensure the total frame size fits within COBS block size.
+     * (LINK_MAX_PAYLOAD_SIZE) to ensure the total frame fits within LINK_MAX_FRAME_SIZE.
      *
      * @param length Length of the payload in bytes
      * @return true if the payload size is valid, false otherwise
@@ -190,21 +482,323 @@ public:
     int process_outgoing_data();
     int process_incoming_data();
 
+    // Interrupt-safe access to the byte queues
+    //
+    // The incoming and outgoing queues are single-producer/single-consumer
+    // rings. The functions below only touch one end of one ring and never log,
+    // report events or call other layers, so a UART/DMA interrupt handler may
+    // call them while a task runs process_incoming_data(), send() and the
+    // transport layer. Each end must have exactly one owner: feed received
+    // bytes through either on_receive() or these functions, and drain
+    // outgoing bytes through either process_outgoing_data() or these
+    // functions, never both.
+
+    /**
+     * @brief Append received bytes from an interrupt handler
+     *
+     * The task must be signalled separately (e.g. vTaskNotifyGiveFromISR())
+     * to run process_incoming_data(). If the bytes do not fit they are dropped
+     * as a whole; the frame they belonged to then fails its CRC check and the
+     * decoder resynchronizes at the next delimiter.
+     *
+     * @param data Received bytes
+     * @param length Number of bytes
+     * @return LINK_SUCCESS, or LINK_ERROR_BUFFER_FULL if the bytes were dropped
+     */
+    int receive_from_isr(const uint8_t *data, uint16_t length)
+    {
+        if (!data)
+        {
+            return LINK_ERROR_INVALID_PARAM;
+        }
+        if (!incoming_buffer_.write(data, length))
+        {
+            count_rx_overflow(length);
+            return LINK_ERROR_BUFFER_FULL;
+        }
+        return LINK_SUCCESS;
+    }
+
+    /**
+     * @brief Get free space in the incoming queue for a UART/DMA to write into
+     *
+     * Received bytes written at the returned pointer become visible to
+     * process_incoming_data() with incoming_commit(), without a copy.
+     *
+     * @param length Receives the number of contiguous bytes available
+     * @return Pointer to the first free byte
+     */
+    uint8_t *incoming_write_span(uint16_t &length)
+    {
+        return incoming_buffer_.write_span(length);
+    }
+
+    /**
+     * @brief Publish bytes written through incoming_write_span()
+     */
+    void incoming_commit(uint16_t length)
+    {
+        incoming_buffer_.commit(length);
+    }
+
+    /**
+     * @brief Get the next chunk of encoded frame bytes to transmit
+     *
+     * Typically called from the TX-complete interrupt to chain the next
+     * transfer. The bytes stay valid until released with outgoing_consume().
+     * A transfer is started from the task when the transmitter is idle and
+     * LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE is reported; the interrupt
+     * keeps it going until this returns an empty span.
+     *
+     * A span never extends past the end of a frame, so that the queue of the
+     * next frame can be chosen by priority; expect one or two spans per frame.
+     *
+     * @param length Receives the number of contiguous bytes ready (0 if none)
+     * @return Pointer to the oldest byte of the frame being sent
+     */
+    const uint8_t *outgoing_read_span(uint16_t &length)
+    {
+        if (tx_queue_ == LINK_TX_QUEUE_NONE)
+        {
+            tx_queue_ = select_tx_queue();
+        }
+        const uint8_t *first;
+        const uint8_t *second;
+        uint16_t second_length;
+        frame_spans(first, length, second, second_length);
+        return first;
+    }
+
+    /**
+     * @brief Release bytes obtained with outgoing_read_span() once they were sent
+     */
+    void outgoing_consume(uint16_t length)
+    {
+        consume_tx(length);
+    }
+
+    /**
+     * @brief Check whether received bytes are waiting for process_incoming_data()
+     */
+    bool has_incoming_data() const
+    {
+        return !incoming_buffer_.empty();
+    }
+
+    /**
+     * @brief Check whether encoded frames are waiting for the physical layer
+     */
+    bool has_outgoing_data() const
+    {
+        return !control_buffer_.empty() || !datagram_buffer_.empty() || !outgoing_buffer_.empty();
+    }
+
+    /**
+     * @brief Check whether frames of one priority class are waiting
+     *
+     * @param priority One of LayerPriority
+     */
+    bool has_outgoing_data(uint8_t priority) const
+    {
+        return !tx_queue_empty(priority);
+    }
+
+    /**
+     * @brief Report the data-available events, or leave them out
+     *
+     * On by default. Without them the owner must poll process_incoming_data()
+     * and process_outgoing_data().
+     */
+    void set_data_events(bool enabled)
+    {
+        data_events_ = enabled;
+    }
+
+    /**
+     * @brief Capacity in bytes of the queue of one priority class
+     *
+     * @param priority One of LayerPriority
+     */
+    uint16_t get_queue_capacity(uint8_t priority) const;
+
+#if LINK_FEC
+    /**
+     * @brief Protect bulk frames with a parity frame every group_size frames
+     *
+     * Costs one parity frame, as long as the longest payload of its group, per
+     * group_size frames, and repairs one lost frame per group without waiting
+     * for a retransmission. A group that is not full when the bulk queue
+     * drains is closed by process_outgoing_data() so that its frames are not
+     * left unprotected; frames drained only through outgoing_read_span() wait
+     * for the group to fill.
+     *
+     * With a threshold, FEC is only active while it is needed: it is switched
+     * on when the share of received frames failing their CRC reaches the
+     * threshold over LINK_FEC_WINDOW_FRAMES frames, and off again when it
+     * falls below half of it. The rate measured is that of the incoming
+     * direction, taken as representative of the line.
+     *
+     * @param group_size Data frames per parity frame, 1 to LINK_FEC_MAX_GROUP_SIZE; 0 disables FEC
+     * @param crc_error_threshold CRC errors per 1000 received frames, 0 for FEC all the time
+     * @return LINK_SUCCESS, or LINK_ERROR_INVALID_PARAM for a bad group size
+     */
+    int set_fec(uint8_t group_size, uint16_t crc_error_threshold);
+
+    /**
+     * @brief Check whether bulk frames are currently sent with parity
+     */
+    bool is_fec_active() const
+    {
+        return fec_active_;
+    }
+#endif
+
+    /**
+     * @brief Copy the current counters
+     *
+     * Must be called from the task running the layer.
+     */
+    void get_stats(LinkLayerStats &stats) const;
+
+    /**
+     * @brief Set all counters back to zero
+     */
+    void reset_stats();
+
 private:
     bool validate_frame(const uint8_t *frame, uint16_t length);
 
-    // Transmit buffers
-    uint8_t frame_buffer_[LINK_MAX_FRAME_SIZE];     // Buffer for frame construction
-    uint8_t encoded_buffer_[COBS_MAX_ENCODED_SIZE]; // Buffer for COBS encoded frame
-    uint16_t encoded_length_;                       // Length of encoded frame
+    // Consumer side of the outgoing queues, see process_outgoing_data()
+    static const uint8_t LINK_TX_QUEUE_NONE = 0xFF;
+
+    /**
+     * @brief Get the highest-priority queue holding a frame, or LINK_TX_QUEUE_NONE
+     */
+    uint8_t select_tx_queue() const;
+
+    /**
+     * @brief Get the unsent bytes of the current frame of queue tx_queue_
+     *
+     * The frame ends at its delimiter, the only zero byte in an encoded queue.
+     */
+    void frame_spans(const uint8_t *&first, uint16_t &first_length, const uint8_t *&second,
+                     uint16_t &second_length) const;
+
+    /**
+     * @brief Release sent bytes of the current frame, ending it at its delimiter
+     */
+    void consume_tx(uint16_t length);
+
+    bool tx_queue_empty(uint8_t queue) const;
+
+    /**
+     * @brief CRC, COBS-encode and publish a frame built after the COBS prefix of encoded
+     */
+    int finish_frame(uint8_t *encoded, uint16_t payload_length, uint8_t queue);
+
+    // Asynchronous transfers, driven by the physical layer's helpers
+    friend class PhysicalLayer;
+
+    /**
+     * @brief Hand the next span of the outgoing queues to start_transmit()
+     *
+     * @return Bytes started, 0 if the queues are empty, or a physical layer error
+     */
+    int start_transfer();
+    int start_async_transmit();
+    void on_transmit_complete();
+
+    /**
+     * @brief Hand free space of the incoming queue to start_receive(), or pause if there is none
+     */
+    void start_reception();
+    void resume_reception();
+    void on_receive_progress(uint16_t received);
+    void on_receive_complete();
+
+#if LINK_FEC
+    static const uint8_t LINK_FEC_NO_GROUP = 0xFF;
+
+    /**
+     * @brief Queue the parity frame of the open group, if any, and start the next one
+     *
+     * @return true if a parity frame was queued
+     */
+    bool close_fec_group();
+
+    void receive_fec_data(uint8_t type, const uint8_t *payload, uint16_t length);
+    void receive_fec_parity(uint8_t type, uint16_t length_xor, const uint8_t *parity, uint16_t length);
+    void start_fec_rx_group(uint8_t group);
+    void update_fec_window(bool crc_error);
+#endif
+
+    PhysicalLayer *physical_layer_; // Typed alias of down_layer for span transfers
+
+    // Frames are built and COBS-encoded in place at the head of their queue:
+    // [COBS prefix | TYPE(1) | LENGTH(1 or 2) | PAYLOAD(n) | CRC16(2)] + delimiter
+    // If the free space at the head is not contiguous, the frame is built in
+    // staging_buffer_ instead and copied into the ring on commit.
+    uint8_t *reserved_frame_;  // Start of the open reservation, NULL if none
+    uint16_t reserved_length_; // Payload length of the open reservation
+    uint8_t reserved_queue_;   // LayerPriority of the open reservation
+    uint8_t tx_queue_;         // Queue of the frame being sent, LINK_TX_QUEUE_NONE between frames
+    uint8_t batch_depth_;      // Nesting level of begin_batch()
+    bool batch_pending_;       // A frame was queued during the batch
+    bool data_events_;         // Report LINK_LAYER_EVENT_*_DATA_AVAILABLE, see set_data_events()
+    uint8_t staging_buffer_[LINK_FRAME_SLOT_SIZE(LINK_MAX_FRAME_SIZE)];
 
     uint8_t decode_buffer_[LINK_MAX_FRAME_SIZE]; // Buffer for COBS decoded frame
+    COBSDecoder decoder_;                        // Streaming decoder writing into decode_buffer_
+    uint16_t rx_frame_bytes_;                    // Encoded bytes of the frame being decoded
+
+#if LINK_FEC
+    uint8_t fec_group_size_;        // Data frames per parity frame, 0 if FEC is disabled
+    uint16_t fec_threshold_;        // CRC errors per 1000 frames that activate FEC, 0 for always
+    bool fec_active_;               // Bulk frames are sent as FEC_DATA
+    uint16_t fec_window_frames_;    // Frames received in the current measurement window
+    uint16_t fec_window_errors_;    // Of those, frames that failed their CRC
+
+    uint8_t fec_tx_group_;          // GROUP of the open transmit group
+    uint8_t fec_tx_count_;          // Data frames sent in it so far
+    uint16_t fec_tx_length_;        // Longest payload in it
+    uint16_t fec_tx_length_xor_;    // XOR of its payload lengths
+    uint8_t fec_tx_parity_[LINK_MAX_PAYLOAD_SIZE]; // XOR of its payloads
+
+    uint8_t fec_rx_group_;          // GROUP being received, LINK_FEC_NO_GROUP if none
+    uint16_t fec_rx_mask_;          // Bit per INDEX received in it
+    uint16_t fec_rx_length_xor_;    // XOR of the payload lengths received
+    uint8_t fec_rx_buffer_[LINK_MAX_PAYLOAD_SIZE]; // XOR of the payloads received, then the rebuilt payload
+#endif
+
+    // Statistics. The overflow counters are written by whichever context owns
+    // the producer end of incoming_buffer_, possibly an interrupt handler.
+    LinkLayerStats stats_;
+    std::atomic<uint32_t> rx_overflows_;
+    std::atomic<uint32_t> rx_overflow_bytes_;
+
+    void count_rx_overflow(uint16_t length)
+    {
+        rx_overflows_.store(rx_overflows_.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+        rx_overflow_bytes_.store(rx_overflow_bytes_.load(std::memory_order_relaxed) + length,
+                                 std::memory_order_relaxed);
+    }
 
-    uint8_t outgoing_buffer_[LINK_OUTGOING_BUFFER_SIZE];
-    uint16_t outgoing_buffer_length_;
+    RingBuffer control_buffer_;  // Encoded control frames awaiting the physical layer
+    RingBuffer datagram_buffer_; // Encoded datagram frames
+    RingBuffer outgoing_buffer_; // Encoded bulk data frames
+    RingBuffer incoming_buffer_; // Raw bytes from the physical layer
+    RingBuffer *tx_queues_[LAYER_PRIORITY_COUNT]; // Outgoing queues indexed by LayerPriority
 
-    uint8_t incoming_buffer_[LINK_INCOMING_BUFFER_SIZE];
-    uint16_t incoming_buffer_length_;
+    // Asynchronous transfers, see PhysicalLayer. While tx_in_flight_ is set
+    // the running transfer owns the consumer end of the outgoing queues, and
+    // while a reception runs it owns the producer end of incoming_buffer_.
+    uint8_t phy_capabilities_;     // PhysicalCapability flags of physical_layer_
+    std::atomic<bool> tx_in_flight_;
+    uint16_t tx_transfer_length_;  // Bytes of the running transfer
+    uint16_t rx_span_length_;      // Size of the running reception's buffer
+    uint16_t rx_span_received_;    // Bytes of it published so far
+    std::atomic<bool> rx_stalled_; // Reception paused on a full incoming queue, or failed to start
 
     // Prevent copy and assignment
     LinkLayer(const LinkLayer &);
@@ -3,10 +3,65 @@
 
 #include <cstdio>
 #include <cstdarg>  // Required for va_list
+#include <cstdint>
+
+/**
+ * @brief Compile-time log level, selected with LOG_MAX_LEVEL
+ *
+ * Messages less severe than LOG_MAX_LEVEL compile to nothing: their
+ * arguments are still type-checked but never evaluated. For example
+ * -DLOG_MAX_LEVEL=LOG_SEVERITY_INFO removes every log_debug() call.
+ */
+#define LOG_SEVERITY_NONE    0
+#define LOG_SEVERITY_ERROR   1
+#define LOG_SEVERITY_WARNING 2
+#define LOG_SEVERITY_INFO    3
+#define LOG_SEVERITY_DEBUG   4
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_SEVERITY_DEBUG
+#endif
+
+/**
+ * @brief Log backends, selected at compile time with LOG_BACKEND
+ *
+ * - LOG_BACKEND_PRINTF: format and print each message immediately (default).
+ * - LOG_BACKEND_DEFERRED: store the format string pointer and the raw
+ *   arguments in a ring of records; log_drain() formats and prints them
+ *   later, e.g. from a low-priority task. Any number of threads, tasks or
+ *   interrupt handlers may log at once; this needs a lock-free 32-bit
+ *   compare-and-swap (Cortex-M3 and up, hosts). Arguments are stored as
+ *   pointer-sized words, so integer conversions of up to 32 bits (%d, %u,
+ *   %x, %c) as well as %p and %s are supported, and %s arguments must point
+ *   to strings that outlive the record, such as literals.
+ */
+#define LOG_BACKEND_PRINTF   1
+#define LOG_BACKEND_DEFERRED 2
+
+#ifndef LOG_BACKEND
+#define LOG_BACKEND LOG_BACKEND_PRINTF
+#endif
+
+#if LOG_BACKEND == LOG_BACKEND_DEFERRED
+#ifndef LOG_DEFERRED_RECORDS
+#define LOG_DEFERRED_RECORDS 64 // Records in the ring (power of two), 40 bytes each on 32-bit cores
+#endif
+#define LOG_DEFERRED_MAX_ARGS 6 // Arguments stored per record
+
+static_assert(LOG_DEFERRED_RECORDS >= 2 && (LOG_DEFERRED_RECORDS & (LOG_DEFERRED_RECORDS - 1)) == 0,
+              "LOG_DEFERRED_RECORDS must be a power of two");
+#endif
 
 namespace robust_serial
 {
 
+#if LOG_BACKEND == LOG_BACKEND_DEFERRED
+/**
+ * @brief One stored argument of a deferred record, wide enough for a pointer
+ */
+typedef uintptr_t LogWord;
+#endif
+
 /**
  * @brief Logging levels for debugging.
  */
@@ -17,6 +72,71 @@ enum LogLevel {
     LOG_LEVEL_DEBUG
 };
 
+/**
+ * @brief Prefix printed in front of a message of the given level.
+ */
+inline const char* log_level_prefix(LogLevel level)
+{
+    static const char* level_str[] = {"[INFO] ", "[WARNING] ", "[ERROR] ", "[DEBUG] "};
+    return level_str[level];
+}
+
+#if LOG_BACKEND == LOG_BACKEND_DEFERRED
+
+/**
+ * @brief Append one record to the deferred log ring.
+ *
+ * Used by log(); safe to call from several contexts at once.
+ *
+ * @return true if the record was stored, false if it was dropped because the ring is full
+ */
+bool log_write_record(LogLevel level, const char* format, const LogWord* args, uint8_t arg_count);
+
+/**
+ * @brief Format and print queued records.
+ *
+ * Must be called from a single consumer context.
+ *
+ * @param max_records Maximum number of records to print
+ * @return Number of records printed
+ */
+uint16_t log_drain(uint16_t max_records);
+
+/**
+ * @brief Number of records dropped because the ring was full.
+ */
+uint32_t log_get_dropped_count();
+
+template <typename T>
+inline LogWord log_arg(T value)
+{
+    return static_cast<LogWord>(value);
+}
+
+template <typename T>
+inline LogWord log_arg(T* value)
+{
+    return reinterpret_cast<LogWord>(value);
+}
+
+/**
+ * @brief Deferred logging: record the format pointer and raw arguments.
+ * @param level Log level (INFO, WARNING, ERROR, DEBUG).
+ * @param format Message format (printf-style string literal).
+ * @param args Integer or pointer arguments.
+ */
+template <typename... Args>
+inline void log(LogLevel level, const char* format, Args... args)
+{
+    static_assert(sizeof...(Args) <= LOG_DEFERRED_MAX_ARGS,
+                  "Too many arguments for a deferred log record");
+
+    const LogWord words[] = {0, log_arg(args)...}; // Leading 0 keeps the array non-empty
+    log_write_record(level, format, words + 1, static_cast<uint8_t>(sizeof...(Args)));
+}
+
+#else
+
 /**
  * @brief Lightweight logging function.
  * @param level Log level (INFO, WARNING, ERROR, DEBUG).
@@ -25,9 +145,7 @@ enum LogLevel {
  */
 inline void log(LogLevel level, const char* format, ...)
 {
-    static const char* level_str[] = {"[INFO] ", "[WARNING] ", "[ERROR] ", "[DEBUG] "};
-
-    printf("%s", level_str[level]);
+    printf("%s", log_level_prefix(level));
 
     va_list args;
     va_start(args, format);
@@ -37,17 +155,45 @@ inline void log(LogLevel level, const char* format, ...)
     printf("\n");
 }
 
+#endif // LOG_BACKEND
+
+/** @brief Discard a message at compile time while still type-checking it. */
+#define LOG_DISCARD(level, format, ...)                                                            \
+    do                                                                                             \
+    {                                                                                              \
+        if (0)                                                                                     \
+        {                                                                                          \
+            log(level, format, ##__VA_ARGS__);                                                     \
+        }                                                                                          \
+    } while (0)
+
 /** @brief Log an informational message. */
+#if LOG_MAX_LEVEL >= LOG_SEVERITY_INFO
 #define log_info(format, ...) log(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define log_info(format, ...) LOG_DISCARD(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#endif
 
 /** @brief Log a warning message. */
+#if LOG_MAX_LEVEL >= LOG_SEVERITY_WARNING
 #define log_warning(format, ...) log(LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#else
+#define log_warning(format, ...) LOG_DISCARD(LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+#endif
 
 /** @brief Log an error message. */
+#if LOG_MAX_LEVEL >= LOG_SEVERITY_ERROR
 #define log_error(format, ...) log(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define log_error(format, ...) LOG_DISCARD(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#endif
 
 /** @brief Log a debug message. */
+#if LOG_MAX_LEVEL >= LOG_SEVERITY_DEBUG
 #define log_debug(format, ...) log(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define log_debug(format, ...) LOG_DISCARD(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#endif
 
 } // namespace robust_serial
 
@@ -0,0 +1,216 @@
+#ifndef __LOOPBACK_PHYSICAL_LAYER_HPP__
+#define __LOOPBACK_PHYSICAL_LAYER_HPP__
+
+#include "physical_layer.hpp"
+
+/**
+ * @brief Bytes one direction of a loopback wire can hold in flight
+ *
+ * Must cover the transmitter FIFO plus everything sent within one latency
+ * period at the simulated baud rate.
+ */
+#ifndef LOOPBACK_BUFFER_SIZE
+#define LOOPBACK_BUFFER_SIZE 4096
+#endif
+
+/**
+ * @brief Writes one direction of a loopback wire can hold in flight
+ */
+#ifndef LOOPBACK_MAX_CHUNKS
+#define LOOPBACK_MAX_CHUNKS 64
+#endif
+
+static_assert(LOOPBACK_BUFFER_SIZE <= 32768 && LOOPBACK_MAX_CHUNKS <= 255,
+              "Loopback buffers are indexed with 16 and 8 bits");
+
+namespace robust_serial
+{
+
+/**
+ * @brief Line model of a LoopbackPhysicalLayer, see LoopbackPhysicalLayer::configure()
+ *
+ * All fields 0 (or zero-initialized) is an ideal wire: infinitely fast, no
+ * latency, no errors, no limit on write sizes.
+ */
+struct LoopbackConfig
+{
+    uint32_t baud_rate;          /**< Bits per second at 10 bits per byte (8N1), 0 for no limit */
+    uint32_t latency_us;         /**< Delay from the end of a byte on the line to its delivery */
+    uint32_t bit_error_ppb;      /**< Flipped bits per 10^9 bits */
+    uint32_t burst_ppm;          /**< Loss bursts per 10^6 bytes */
+    uint16_t burst_length;       /**< Bytes lost per burst */
+    uint16_t max_write;          /**< Largest write send() accepts, 0 for no limit */
+    uint16_t tx_fifo_size;       /**< Bytes the transmitter accepts ahead of the line, 0 for no limit */
+    uint32_t seed;               /**< Seed of the error generator, any value including 0 */
+    uint8_t dma;                 /**< Non-zero: transfer with start_transmit() and start_receive(),
+                                      set before the link layer connects */
+};
+
+/**
+ * @brief Loopback counters, see LoopbackPhysicalLayer::get_stats()
+ */
+struct LoopbackStats
+{
+    uint32_t bytes_tx;       /**< Bytes accepted by send() */
+    uint32_t bytes_rx;       /**< Bytes delivered to the peer's upper layer */
+    uint32_t bit_errors;     /**< Bytes delivered with a flipped bit */
+    uint32_t bytes_lost;     /**< Bytes dropped by loss bursts */
+    uint32_t partial_writes; /**< Writes accepted only in part */
+    uint32_t busy_writes;    /**< Writes not accepted at all */
+    uint32_t bytes_overrun;  /**< Bytes the peer dropped with no reception started (dma only) */
+};
+
+/**
+ * @brief Simulated serial line between two stacks in one process
+ *
+ * Two instances connected with connect() form a full-duplex wire: bytes
+ * accepted by one instance's send() are delivered to the other instance's
+ * upper layer once the simulated line has carried them. The wire models the
+ * baud rate and a transmitter FIFO (send() accepts only what fits, like a
+ * UART driver), a fixed latency, random bit errors, bursts of lost bytes and
+ * a maximum write size, so that the stack's behaviour and throughput can be
+ * measured on a host without hardware.
+ *
+ * Time is simulated: the caller passes the current time to poll(), which
+ * delivers every byte that has arrived by then. The clock can be real or
+ * advanced by hand for reproducible runs; the stacks' clock
+ * (get_current_time_ms()) should follow the same time. Errors come from a
+ * seeded pseudo-random generator, so a run with the same inputs repeats
+ * exactly. Nothing is allocated.
+ *
+ * With LoopbackConfig::dma the instance behaves like a UART driven by DMA:
+ * it reports PHYSICAL_CAPABILITY_ASYNC_TX and PHYSICAL_CAPABILITY_ASYNC_RX,
+ * puts each start_transmit() span on the line as a whole and reports it
+ * from poll() once its last byte has left. Arriving bytes are written into
+ * the span of start_receive() and reported per write, as an idle-line
+ * interrupt would.
+ */
+class LoopbackPhysicalLayer final : public PhysicalLayer
+{
+public:
+    LoopbackPhysicalLayer();
+    virtual ~LoopbackPhysicalLayer();
+
+    virtual void initialize();
+    virtual void deinitialize();
+
+    /**
+     * @brief Join two instances into a wire
+     *
+     * Each instance sends to the other; configure() both for a symmetric line.
+     */
+    static void connect(LoopbackPhysicalLayer &a, LoopbackPhysicalLayer &b);
+
+    /**
+     * @brief Set the line model of the direction this instance sends in
+     *
+     * A new seed restarts the error generator; with the same seed the line
+     * can be reconfigured mid-run and the errors carry on where they were.
+     */
+    void configure(const LoopbackConfig &config);
+
+    /**
+     * @brief Advance the simulated time and deliver the bytes that have arrived
+     *
+     * @param now_us Current time in microseconds; may wrap around
+     */
+    void poll(uint32_t now_us);
+
+    /**
+     * @brief Check whether bytes are still on their way to the peer
+     */
+    bool in_flight() const
+    {
+        return chunk_count_ > 0;
+    }
+
+    /**
+     * @brief Queue bytes for the peer, as far as the transmitter can take them
+     *
+     * @return Bytes accepted, possibly fewer than length or 0 while the
+     *         transmitter FIFO is full; PHYSICAL_ERROR_NOT_INITIALIZED
+     *         without a peer
+     */
+    virtual int send(const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief Forward bytes arriving from the peer to the upper layer
+     */
+    virtual int on_receive(const uint8_t *data, uint16_t length);
+
+    virtual uint8_t get_capabilities() const
+    {
+        return config_.dma ? (PHYSICAL_CAPABILITY_ASYNC_TX | PHYSICAL_CAPABILITY_ASYNC_RX) : 0;
+    }
+
+    /**
+     * @brief Put a span on the line as a whole, see PhysicalLayer::start_transmit()
+     *
+     * @return PHYSICAL_SUCCESS, PHYSICAL_ERROR_BUSY if the wire cannot take
+     *         the whole span now
+     */
+    virtual int start_transmit(const uint8_t *data, uint16_t length);
+
+    virtual int start_receive(uint8_t *buffer, uint16_t length);
+
+    virtual uint16_t get_max_payload_size() const
+    {
+        return config_.max_write ? config_.max_write : LOOPBACK_BUFFER_SIZE;
+    }
+
+    /**
+     * @brief Copy the counters of the direction this instance sends in
+     */
+    void get_stats(LoopbackStats &stats) const
+    {
+        stats = stats_;
+    }
+
+    void reset_stats();
+
+private:
+    // A write on its way: its bytes that survived are next in wire_
+    struct Chunk
+    {
+        uint64_t arrival_ns;
+        uint16_t length;
+    };
+
+    void seed_random(uint32_t seed);
+    uint32_t random();
+    void put_on_wire(const uint8_t *data, uint16_t length);
+
+    LoopbackPhysicalLayer *peer_;
+    LoopbackConfig config_;
+    uint64_t byte_ns_;             // Time one byte occupies the line, 0 for no limit
+    uint32_t bit_error_threshold_; // Per-byte probability of a bit error, scaled to 2^32
+    uint32_t burst_threshold_;     // Per-byte probability of a loss burst, scaled to 2^32
+    uint16_t burst_remaining_;     // Bytes still to lose in the current burst
+    uint32_t random_state_;
+
+    uint32_t last_poll_us_;        // now_us of the previous poll()
+    uint64_t now_ns_;              // Simulated time
+    uint64_t line_free_ns_;        // When the line has sent everything accepted
+
+    uint8_t wire_[LOOPBACK_BUFFER_SIZE]; // Bytes in flight, a ring
+    uint16_t wire_head_;                 // Oldest byte
+    uint16_t wire_length_;               // Bytes in flight
+    Chunk chunks_[LOOPBACK_MAX_CHUNKS];  // Writes in flight, a ring
+    uint8_t chunk_head_;
+    uint8_t chunk_count_;
+
+    bool tx_running_;              // A start_transmit() span is on the line
+    uint8_t *rx_span_;             // Buffer of start_receive(), NULL if none
+    uint16_t rx_span_length_;
+    uint16_t rx_span_received_;
+
+    LoopbackStats stats_;
+
+    // Prevent copy and assignment
+    LoopbackPhysicalLayer(const LoopbackPhysicalLayer &);
+    LoopbackPhysicalLayer &operator=(const LoopbackPhysicalLayer &);
+};
+
+} // namespace robust_serial
+
+#endif // __LOOPBACK_PHYSICAL_LAYER_HPP__
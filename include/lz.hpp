@@ -0,0 +1,95 @@
+#ifndef __LZ_HPP__
+#define __LZ_HPP__
+
+#include <cstdint>
+#include "config.hpp"
+
+/**
+ * @brief Size of the compressor's match finder as a power of two
+ *
+ * The compressor remembers the last position of 2^LZ_HASH_BITS hashed
+ * three-byte sequences, two bytes each (512 bytes by default). More bits find
+ * more matches in long frames.
+ */
+#ifndef LZ_HASH_BITS
+#define LZ_HASH_BITS 8
+#endif
+
+#if (LZ_HASH_BITS < 4) || (LZ_HASH_BITS > 14)
+#error "LZ_HASH_BITS must be between 4 and 14"
+#endif
+
+namespace robust_serial
+{
+
+// LZ Format Configuration
+static const uint16_t LZ_HASH_SIZE = 1u << LZ_HASH_BITS; // Entries of the match finder table
+static const uint8_t LZ_MAX_LITERALS = 128;               // Longest literal run of one token
+static const uint8_t LZ_MIN_MATCH = 3;                    // Shortest match worth a token
+static const uint16_t LZ_MAX_MATCH = 265;                 // Longest match of one token
+static const uint16_t LZ_MAX_OFFSET = 4096;               // Farthest match distance
+
+/**
+ * @brief LZ77 compression of single frames.
+ *
+ * Each frame is compressed on its own, with the frame itself as the only
+ * dictionary, so frames can be lost or reordered without breaking the
+ * decompression of the others. Neither direction allocates memory; the
+ * compressor needs a caller-provided table of LZ_HASH_SIZE entries.
+ *
+ * The compressed data is a sequence of tokens:
+ * - 0x00-0x7F: literal run, followed by (token + 1) literal bytes
+ * - 0x80-0xFF: match of earlier output, followed by the low byte of the
+ *   offset. Bits 6-4 are the length code (3-9 bytes for codes 0-6; code 7
+ *   is followed by one more byte n for 10 + n bytes), bits 3-0 are the high
+ *   bits of (offset - 1). A match may overlap the bytes it produces, which
+ *   encodes runs.
+ */
+class LZ
+{
+public:
+    /**
+     * @brief Compress data.
+     *
+     * @param input Pointer to the input data buffer.
+     * @param length Length of the input data.
+     * @param output Pointer to the output buffer, must not overlap the input.
+     * @param output_size Size of the output buffer.
+     * @param table Match finder table of LZ_HASH_SIZE entries, overwritten.
+     * @return The number of bytes written to the output buffer, or
+     *         LZ_ERROR_OUTPUT_TOO_SMALL if the compressed data would not fit,
+     *         which also happens for incompressible data given an output
+     *         smaller than the input.
+     */
+    static int compress(const uint8_t *input, uint16_t length,
+                        uint8_t *output, uint16_t output_size, uint16_t *table);
+
+    /**
+     * @brief Decompress data.
+     *
+     * @param input Pointer to the compressed data.
+     * @param length Length of the compressed data.
+     * @param output Pointer to the output buffer.
+     * @param output_size Size of the output buffer.
+     * @return The number of bytes written to the output buffer, or a negative
+     *         error code for malformed input or output that would not fit.
+     */
+    static int decompress(const uint8_t *input, uint16_t length,
+                          uint8_t *output, uint16_t output_size);
+
+    // Error codes for LZ operations
+    enum LzError {
+        LZ_SUCCESS = 0,
+        LZ_ERROR_INVALID_PARAMETERS = -1,
+        LZ_ERROR_OUTPUT_TOO_SMALL = -2,
+        LZ_ERROR_MALFORMED = -3
+    };
+
+private:
+    static int put_literals(const uint8_t *literals, uint16_t count,
+                            uint8_t *output, uint16_t &write_index, uint16_t output_size);
+};
+
+} // namespace robust_serial
+
+#endif // __LZ_HPP__
@@ -48,6 +48,16 @@ enum PhysicalLayerEvent {
     PHYSICAL_LAYER_EVENT_BUFFER_OVERFLOW = -6 // Buffer overflow occurred
 };
 
+/**
+ * @brief Optional features of a physical layer, see PhysicalLayer::get_capabilities()
+ */
+enum PhysicalCapability {
+    PHYSICAL_CAPABILITY_ASYNC_TX = 0x01, // Transmits with start_transmit() and transmit_complete()
+    PHYSICAL_CAPABILITY_ASYNC_RX = 0x02  // Receives with start_receive() and receive_progress()
+};
+
+class LinkLayer;
+
 /**
  * @brief Abstract interface for physical layer implementations
  * 
@@ -62,11 +72,31 @@ enum PhysicalLayerEvent {
  * 
  * Note: The physical layer does not handle framing, encoding, or error correction.
  * These are handled by higher layers.
+ *
+ * Asynchronous transfers (DMA):
+ * A physical layer that reports PHYSICAL_CAPABILITY_ASYNC_TX is handed one
+ * span of the link layer's outgoing queue at a time with start_transmit().
+ * The bytes stay in the queue, untouched, until the implementation calls
+ * transmit_complete(), typically from the TX-complete interrupt; the link
+ * layer then releases them and starts the next span from there, so frames
+ * go out back to back without the task.
+ *
+ * With PHYSICAL_CAPABILITY_ASYNC_RX the link layer hands out free space of
+ * its incoming queue with start_receive(). The implementation reports bytes
+ * as they arrive with receive_progress() (DMA half-transfer, idle line) and
+ * a full span with receive_complete(), which starts the next one. If the
+ * queue is full, reception pauses until process_incoming_data() has made
+ * room. Bytes received this way report no event: the interrupt handler wakes
+ * the task itself, as for LinkLayer::receive_from_isr().
+ *
+ * The helpers may be called from interrupt handlers, but not from within
+ * start_transmit() or start_receive(). The capabilities must not change
+ * once the link layer is connected.
  */
 class PhysicalLayer : public Layer
 {
 public:
-    PhysicalLayer() : Layer() {
+    PhysicalLayer() : Layer(), link_layer_(NULL) {
         state_ = PHYSICAL_STATE_INIT;  // Initialize state after base class construction
     }
     virtual ~PhysicalLayer() {}
@@ -85,6 +115,35 @@ public:
      */
     virtual int send(const uint8_t *data, uint16_t length) = 0;
 
+    /**
+     * @brief Send data that is split across two buffers
+     *
+     * @param first First part of the data
+     * @param first_length Length of the first part
+     * @param second Second part of the data (sent after the first)
+     * @param second_length Length of the second part, may be 0
+     * @return Total bytes sent on success, error code on failure
+     *
+     * Note: The link layer keeps its outgoing frames in a ring buffer and
+     * hands out the queued bytes as (at most) two contiguous spans that point
+     * into that buffer. Implementations that can chain transfers (e.g. a DMA
+     * with linked descriptors) should override this to queue both spans at
+     * once. The default sends them one after the other with send() and stops
+     * at the first partial write.
+     */
+    virtual int send_spans(const uint8_t *first, uint16_t first_length, const uint8_t *second,
+                           uint16_t second_length)
+    {
+        int result = send(first, first_length);
+        if (result != first_length || second_length == 0)
+        {
+            return result;
+        }
+
+        int second_result = send(second, second_length);
+        return (second_result < 0) ? result : result + second_result;
+    }
+
     /**
      * @brief Process received data and pass to upper layer
      * 
@@ -106,6 +165,67 @@ public:
      * This should be implemented by concrete physical layer implementations.
      */
     virtual uint16_t get_max_payload_size() const = 0;
+
+    /**
+     * @brief Get the optional features of the implementation
+     *
+     * @return Combination of PhysicalCapability flags; 0 by default
+     */
+    virtual uint8_t get_capabilities() const { return 0; }
+
+    /**
+     * @brief Start transmitting bytes asynchronously
+     *
+     * Called with PHYSICAL_CAPABILITY_ASYNC_TX only, never while a transfer
+     * is running. The bytes must be sent as a whole, then reported with
+     * transmit_complete().
+     *
+     * @return PHYSICAL_SUCCESS if the transfer started, error code otherwise
+     */
+    virtual int start_transmit(const uint8_t *data, uint16_t length)
+    {
+        (void)data;
+        (void)length;
+        return LAYER_ERROR_NOT_IMPLEMENTED;
+    }
+
+    /**
+     * @brief Start receiving bytes asynchronously into a buffer
+     *
+     * Called with PHYSICAL_CAPABILITY_ASYNC_RX only, never while a reception
+     * is running.
+     *
+     * @return PHYSICAL_SUCCESS if the reception started, error code otherwise
+     */
+    virtual int start_receive(uint8_t *buffer, uint16_t length)
+    {
+        (void)buffer;
+        (void)length;
+        return LAYER_ERROR_NOT_IMPLEMENTED;
+    }
+
+protected:
+    /**
+     * @brief Report that the bytes of start_transmit() have been sent
+     */
+    void transmit_complete();
+
+    /**
+     * @brief Report how many bytes of the start_receive() buffer hold data
+     *
+     * @param received Bytes written into the buffer so far, counted from its start
+     */
+    void receive_progress(uint16_t received);
+
+    /**
+     * @brief Report that the start_receive() buffer is full
+     */
+    void receive_complete();
+
+private:
+    friend class LinkLayer;
+
+    LinkLayer *link_layer_; // Layer above, set when it connects
 };
 
 } // namespace robust_serial
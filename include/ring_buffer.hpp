@@ -0,0 +1,231 @@
+#ifndef __RING_BUFFER_HPP__
+#define __RING_BUFFER_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <cstring> // For memcpy()
+
+// Capacities a RingBuffer supports: a power of two between 2 and 32768
+#define RING_BUFFER_VALID_SIZE(size) ((size) >= 2 && (size) <= 32768 && ((size) & ((size) - 1)) == 0)
+
+namespace robust_serial
+{
+
+/**
+ * @brief Smallest valid RingBuffer capacity holding size bytes: the next power of two, at least 2
+ */
+constexpr uint32_t ring_buffer_capacity_for(uint32_t size, uint32_t capacity = 2)
+{
+    return (capacity >= size) ? capacity : ring_buffer_capacity_for(size, capacity * 2);
+}
+
+/**
+ * @brief Fixed-size single-producer/single-consumer byte ring buffer
+ *
+ * The capacity must be a power of two so that positions can be wrapped with a
+ * mask. Head and tail are free-running 16-bit counters: the fill level is
+ * simply (head - tail), and both the full and empty cases are unambiguous.
+ *
+ * Data is exposed as contiguous spans so that callers can encode into, decode
+ * from, or DMA straight out of the storage without compacting it. At most two
+ * spans are ever needed to describe the readable or writable region.
+ *
+ * The producer only writes head_, the consumer only writes tail_. Both are
+ * published with release stores and read with acquire loads, so one side may
+ * run in an interrupt handler (or on another core) while the other runs in a
+ * task, without locks or disabling interrupts: data written before commit()
+ * is visible to the consumer once it sees the new head, and space released
+ * by consume() is only reused after the consumer is done reading it. Only
+ * plain 16-bit loads and stores are used, which are lock-free on every
+ * supported core.
+ *
+ * Producer side: write_span(), commit(), write().
+ * Consumer side: read_span(), read_spans(), peek(), copy_out(), consume().
+ * size(), free_space() and empty() may be called from either side. reset()
+ * must not run concurrently with either side.
+ *
+ * The storage is provided by the owner, so that one class serves queues of
+ * any capacity; StaticRingBuffer bundles a buffer with its storage. The
+ * capacity must satisfy RING_BUFFER_VALID_SIZE().
+ */
+class RingBuffer
+{
+public:
+    /**
+     * @param storage Buffer space, must outlive the ring buffer
+     * @param size Capacity in bytes, a power of two of at most 32768
+     */
+    RingBuffer(uint8_t *storage, uint16_t size) : buffer_(storage), size_(size), head_(0), tail_(0) {}
+
+    /**
+     * @brief Discard all buffered data
+     */
+    void reset()
+    {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    /** @brief Buffer capacity in bytes */
+    uint16_t capacity() const { return size_; }
+
+    /** @brief Number of bytes available for reading */
+    uint16_t size() const
+    {
+        return static_cast<uint16_t>(head_.load(std::memory_order_acquire) -
+                                     tail_.load(std::memory_order_acquire));
+    }
+
+    /** @brief Number of bytes available for writing */
+    uint16_t free_space() const { return size_ - size(); }
+
+    bool empty() const { return size() == 0; }
+
+    // Producer side
+
+    /**
+     * @brief Get the contiguous writable region at the head
+     *
+     * @param length Receives the number of bytes that can be written at the returned pointer
+     * @return Pointer to the first free byte
+     */
+    uint8_t *write_span(uint16_t &length)
+    {
+        uint16_t offset = head_.load(std::memory_order_relaxed) & (size_ - 1);
+        uint16_t free_bytes = free_space();
+        length = (free_bytes < size_ - offset) ? free_bytes : size_ - offset;
+        return &buffer_[offset];
+    }
+
+    /**
+     * @brief Publish bytes written through write_span()
+     *
+     * @param length Number of bytes written (at most the free space)
+     */
+    void commit(uint16_t length)
+    {
+        uint16_t head = head_.load(std::memory_order_relaxed);
+        head_.store(static_cast<uint16_t>(head + length), std::memory_order_release);
+    }
+
+    /**
+     * @brief Copy data in, wrapping around the end of the storage
+     *
+     * @param data Data to append
+     * @param length Number of bytes to append
+     * @return true if the data was appended, false if it does not fit (nothing is written)
+     */
+    bool write(const uint8_t *data, uint16_t length)
+    {
+        if (length > free_space())
+        {
+            return false;
+        }
+
+        uint16_t offset = head_.load(std::memory_order_relaxed) & (size_ - 1);
+        uint16_t first = (length < size_ - offset) ? length : size_ - offset;
+        memcpy(&buffer_[offset], data, first);
+        memcpy(&buffer_[0], data + first, length - first);
+        commit(length);
+        return true;
+    }
+
+    // Consumer side
+
+    /**
+     * @brief Get the contiguous readable region at the tail
+     *
+     * @param length Receives the number of bytes readable at the returned pointer
+     * @return Pointer to the oldest buffered byte
+     */
+    const uint8_t *read_span(uint16_t &length) const
+    {
+        uint16_t offset = tail_.load(std::memory_order_relaxed) & (size_ - 1);
+        uint16_t used = size();
+        length = (used < size_ - offset) ? used : size_ - offset;
+        return &buffer_[offset];
+    }
+
+    /**
+     * @brief Get the whole readable region as at most two spans
+     *
+     * @param first Receives a pointer to the oldest buffered byte
+     * @param first_length Receives the length of the first span
+     * @param second Receives a pointer to the wrapped remainder (start of storage)
+     * @param second_length Receives the length of the second span (0 if the data does not wrap)
+     */
+    void read_spans(const uint8_t *&first, uint16_t &first_length, const uint8_t *&second,
+                    uint16_t &second_length) const
+    {
+        first = read_span(first_length);
+        second = &buffer_[0];
+        second_length = size() - first_length;
+    }
+
+    /**
+     * @brief Read a byte relative to the tail without consuming it
+     *
+     * @param offset Offset from the tail (must be less than size())
+     */
+    uint8_t peek(uint16_t offset) const
+    {
+        return buffer_[(tail_.load(std::memory_order_relaxed) + offset) & (size_ - 1)];
+    }
+
+    /**
+     * @brief Copy bytes out relative to the tail without consuming them
+     *
+     * @param offset Offset from the tail
+     * @param output Destination buffer
+     * @param length Number of bytes to copy (offset + length must not exceed size())
+     */
+    void copy_out(uint16_t offset, uint8_t *output, uint16_t length) const
+    {
+        uint16_t start = (tail_.load(std::memory_order_relaxed) + offset) & (size_ - 1);
+        uint16_t first = (length < size_ - start) ? length : size_ - start;
+        memcpy(output, &buffer_[start], first);
+        memcpy(output + first, &buffer_[0], length - first);
+    }
+
+    /**
+     * @brief Release bytes from the tail
+     *
+     * @param length Number of bytes to release (at most size())
+     */
+    void consume(uint16_t length)
+    {
+        uint16_t tail = tail_.load(std::memory_order_relaxed);
+        tail_.store(static_cast<uint16_t>(tail + length), std::memory_order_release);
+    }
+
+private:
+    uint8_t *buffer_;
+    uint16_t size_;
+    std::atomic<uint16_t> head_; // Next position to write (producer)
+    std::atomic<uint16_t> tail_; // Next position to read (consumer)
+
+    // Prevent copy and assignment
+    RingBuffer(const RingBuffer &);
+    RingBuffer &operator=(const RingBuffer &);
+};
+
+/**
+ * @brief RingBuffer with its own storage
+ *
+ * @tparam SIZE Capacity in bytes (power of two, at most 32768)
+ */
+template <uint16_t SIZE>
+class StaticRingBuffer : public RingBuffer
+{
+public:
+    static_assert(RING_BUFFER_VALID_SIZE(SIZE), "RingBuffer size must be a power of two between 2 and 32768");
+
+    StaticRingBuffer() : RingBuffer(storage_, SIZE) {}
+
+private:
+    uint8_t storage_[SIZE];
+};
+
+} // namespace robust_serial
+
+#endif // __RING_BUFFER_HPP__
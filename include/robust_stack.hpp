@@ -5,6 +5,24 @@
 #include "physical_layer.hpp"
 #include "link_layer.hpp"
 #include "transport_layer.hpp"
+#include "transport_mux.hpp"
+#include "rx_buffer_pool.hpp"
+
+/**
+ * @brief Payload compression between the transports and the link layer
+ *
+ * With a non-zero value the stack puts a CompressionLayer under the
+ * multiplexer and offers TRANSPORT_OPTION_COMPRESSION in every handshake.
+ * Outgoing frames are compressed while every connected peer has agreed to
+ * it. Costs the layer's match finder and two frame buffers.
+ */
+#ifndef ROBUST_STACK_COMPRESSION
+#define ROBUST_STACK_COMPRESSION 0
+#endif
+
+#if ROBUST_STACK_COMPRESSION
+#include "compression_layer.hpp"
+#endif
 
 namespace robust_serial
 {
@@ -12,20 +30,59 @@ namespace robust_serial
 // Forward declarations
 class Layer;
 
+/*
+ * Every callback receives the context pointer given with it to its setter,
+ * so that one function can serve several stacks, or reach the object it
+ * belongs to, without globals.
+ */
+
 /**
  * @brief User-defined callback type for state and event notifications.
  */
-typedef void (*RobustStackEventCallback)(int32_t event);
+typedef void (*RobustStackEventCallback)(void *context, int32_t event);
 
 /**
  * @brief User-defined callback type for regular data reception.
  */
-typedef void (*RobustStackDataCallback)(const uint8_t *data, uint16_t length);
+typedef void (*RobustStackDataCallback)(void *context, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief User-defined callback type for complete messages of any length.
+ */
+typedef void (*RobustStackMessageCallback)(void *context, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief User-defined callback type for events of any channel.
+ */
+typedef void (*RobustStackChannelEventCallback)(void *context, uint8_t channel, int32_t event);
+
+/**
+ * @brief User-defined callback type for reliable data of any channel.
+ */
+typedef void (*RobustStackChannelDataCallback)(void *context, uint8_t channel, const uint8_t *data,
+                                               uint32_t length);
+
+/**
+ * @brief User-defined callback type for reliable data loaned in a pooled buffer.
+ *
+ * The application owns the buffer until it passes it to RxBufferPool::release(),
+ * from any task. While every buffer is out, the peer's data goes
+ * unacknowledged and is retransmitted; see RobustStack::set_loan_callback().
+ */
+typedef void (*RobustStackLoanCallback)(void *context, RxBuffer *buffer);
+
+/**
+ * @brief User-defined callback that wakes the task running the stack.
+ *
+ * Called from task context whenever the stack has queued bytes to process or
+ * transmit, typically to give a semaphore or send a task notification.
+ */
+typedef void (*RobustStackNotifyCallback)(void *context);
 
 /**
  * @brief User-defined callback type for datagram reception.
  */
-typedef void (*RobustStackDatagramCallback)(const uint8_t *data, uint16_t length);
+typedef void (*RobustStackDatagramCallback)(void *context, const uint8_t *data, uint16_t length);
 
 /**
  * @brief States for the RobustStack
@@ -66,7 +123,64 @@ enum RobustStackEvent
     ROBUST_STACK_EVENT_DATA_SENT,        // Data successfully sent
     ROBUST_STACK_EVENT_DATAGRAM_RECEIVED, // Datagram received from peer
     ROBUST_STACK_EVENT_OUTGOING_DATA_AVAILABLE, // Outgoing data is available
-    ROBUST_STACK_EVENT_INCOMING_DATA_AVAILABLE  // Incoming data is available
+    ROBUST_STACK_EVENT_INCOMING_DATA_AVAILABLE, // Incoming data is available
+    ROBUST_STACK_EVENT_SUSPENDED,        // Connection lost, trying to resume the session
+    ROBUST_STACK_EVENT_RESUMED           // Session resumed, queued data continues
+};
+
+/**
+ * @brief Snapshot of the per-layer counters, see RobustStack::get_stats()
+ *
+ * The link counters describe the encoded byte stream exchanged with the
+ * physical layer; the transport counters describe packets, retransmissions
+ * and acknowledgment timing.
+ */
+struct RobustStackStats
+{
+    LinkLayerStats link;
+    TransportLayerStats transport[TRANSPORT_MAX_CONNECTIONS]; // Indexed by channel
+#if ROBUST_STACK_COMPRESSION
+    CompressionLayerStats compression;
+#endif
+    uint32_t loans_missed; /**< Payloads too long for a loaned buffer, passed to the data callbacks */
+};
+
+/**
+ * @brief Buffer storage of one RobustStack, see RobustStackStorage
+ */
+struct RobustStackBuffers
+{
+    LinkLayerBuffers link;       /**< Queues of the link layer */
+    TransportTxSlot *tx_windows; /**< window_size slots per channel, channel after channel */
+    TransportRxSlot *rx_windows; /**< Likewise */
+    uint8_t window_size;         /**< Window depth of every channel, see TransportLayer::set_window() */
+};
+
+/**
+ * @brief Statically sized buffers for one RobustStack, checked at compile time
+ *
+ * Each instance chooses its window depth and link queue sizes, so that a node
+ * with little RAM can shrink them and a gateway deepen them; the defaults
+ * are the TRANSPORT_WINDOW_SIZE and LINK_*_BUFFER_SIZE macros. The frame size
+ * (LINK_MAX_FRAME_SIZE) is part of the wire format and stays a build option.
+ * Must outlive the stack using it; StaticRobustStack bundles both.
+ */
+template <uint8_t WINDOW = TRANSPORT_WINDOW_SIZE, uint16_t OUTGOING = LINK_OUTGOING_BUFFER_SIZE,
+          uint16_t INCOMING = LINK_INCOMING_BUFFER_SIZE, uint16_t DATAGRAM = LINK_DATAGRAM_BUFFER_SIZE,
+          uint16_t CONTROL = LINK_CONTROL_BUFFER_SIZE>
+struct RobustStackStorage
+{
+    static_assert(TRANSPORT_VALID_WINDOW_SIZE(WINDOW), "Transport window size must be a power of two between 1 and 32");
+
+    LinkLayerStorage<OUTGOING, INCOMING, DATAGRAM, CONTROL> link;
+    TransportTxSlot tx_windows[TRANSPORT_MAX_CONNECTIONS * WINDOW];
+    TransportRxSlot rx_windows[TRANSPORT_MAX_CONNECTIONS * WINDOW];
+
+    RobustStackBuffers buffers()
+    {
+        RobustStackBuffers result = {link.buffers(), tx_windows, rx_windows, WINDOW};
+        return result;
+    }
 };
 
 /**
@@ -76,11 +190,63 @@ enum RobustStackEvent
  * - Physical Layer: Hardware communication
  * - Link Layer: Frame integrity
  * - Transport Layer: Reliable delivery
+ *
+ * Instead of polling tick(), process_incoming_data() and
+ * process_outgoing_data() at a fixed rate, a task can sleep until there is
+ * something to do:
+ *
+ *   stack.set_notify_callback(wake_stack_task); // e.g. xTaskNotifyGive()
+ *   for (;;)
+ *   {
+ *       stack.process_incoming_data();
+ *       stack.tick();
+ *       stack.process_outgoing_data();
+ *       uint32_t wait = stack.get_next_deadline();
+ *       ulTaskNotifyTake(pdTRUE, wait == TRANSPORT_NO_DEADLINE ? portMAX_DELAY
+ *                                                              : pdMS_TO_TICKS(wait));
+ *   }
+ *
+ * Interrupt handlers that feed the stack directly (queue_link_data_from_isr())
+ * wake the task themselves, e.g. with vTaskNotifyGiveFromISR().
+ *
+ * With TRANSPORT_MAX_CONNECTIONS above 1 the stack runs one independent
+ * connection per channel over the same link (see TransportMux), e.g. a bus
+ * master talking to several nodes:
+ *
+ *   master.set_connection_id(0, 1);  // node A answers connection ID 1
+ *   master.set_connection_id(1, 2);  // node B answers connection ID 2
+ *   master.set_channel_data_callback(on_node_data);
+ *   master.connect(0);
+ *   master.connect(1);
+ *
+ * while each node configures the matching ID and calls listen(). The
+ * functions without a channel argument operate on channel 0, and
+ * get_state(), is_connected() and the event, data and message callbacks
+ * follow channel 0 only; the channel callbacks cover every channel.
+ *
+ * The stack allocates nothing; its queues and windows live in a
+ * RobustStackStorage of the caller's choice, or in the StaticRobustStack
+ * that owns one:
+ *
+ *   StaticRobustStack<2, 512, 512> sensor(uart); // 2-packet window, 512-byte queues
+ *   StaticRobustStack<> gateway_link(port);      // Default sizes
+ *
+ * Received data is only valid during its callback. A worker task that needs
+ * it for longer borrows it in a pooled buffer instead of copying it out:
+ *
+ *   StaticRxBufferPool<4, TRANSPORT_MAX_PAYLOAD_SIZE> rx_pool;
+ *   stack.set_loan_callback(&rx_pool, post_to_worker, worker_queue);
+ *   ...
+ *   process(buffer->data, buffer->length); // In the worker task
+ *   RxBufferPool::release(buffer);
  */
 class RobustStack
 {
 public:
-    RobustStack(PhysicalLayer &phy);
+    /**
+     * @param buffers Queues and windows, must outlive the stack; see RobustStackStorage
+     */
+    RobustStack(PhysicalLayer &phy, const RobustStackBuffers &buffers);
     ~RobustStack();
 
     // Initialization
@@ -95,38 +261,317 @@ public:
         return state_ == ROBUST_STACK_STATE_CONNECTED;
     }
 
+    // Connection management per channel (0 to TRANSPORT_MAX_CONNECTIONS - 1)
+    int connect(uint8_t channel);
+    int listen(uint8_t channel);
+    int disconnect(uint8_t channel);
+    bool is_connected(uint8_t channel) const
+    {
+        return channel < TRANSPORT_MAX_CONNECTIONS && transport_layers_[channel].is_connected();
+    }
+
+    /**
+     * @brief Use a fixed connection ID on a channel
+     *
+     * See TransportLayer::set_connection_id(). Required for every channel
+     * when several nodes share the bus.
+     */
+    void set_connection_id(uint8_t channel, uint8_t connection_id)
+    {
+        if (channel < TRANSPORT_MAX_CONNECTIONS)
+        {
+            transport_layers_[channel].set_connection_id(connection_id);
+        }
+    }
+
     // Data transmission
     int send(const uint8_t *data, uint16_t length);
+    int send_message(const uint8_t *data, uint32_t length);
     int send_datagram(const uint8_t *data, uint16_t length);
     int on_receive(const uint8_t *data, uint16_t length);
+    int on_message(const uint8_t *data, uint32_t length);
     int on_datagram(const uint8_t *data, uint16_t length);
 
+    // Data transmission per channel
+    int send(uint8_t channel, const uint8_t *data, uint16_t length);
+    int send_message(uint8_t channel, const uint8_t *data, uint32_t length);
+
+    /**
+     * @brief Send one reliable packet whose payload is scattered over several buffers
+     *
+     * The segments, e.g. a header struct and a sample array, are copied
+     * straight into the transport's send window; see TransportLayer::send_v().
+     */
+    int send_v(const LayerSegment *segments, uint8_t count);
+    int send_v(uint8_t channel, const LayerSegment *segments, uint8_t count);
+
+    /**
+     * @brief Send one datagram whose payload is scattered over several buffers
+     */
+    int send_datagram_v(const LayerSegment *segments, uint8_t count);
+
+#if TRANSPORT_DELTA_STREAMS
+    /**
+     * @brief Send a datagram of a stream as a difference to the stream's keyframe
+     *
+     * Suits periodic datagrams that change little; the datagram callback
+     * receives the rebuilt datagram. See TransportLayer::send_datagram_delta().
+     *
+     * @param stream Stream ID, below TRANSPORT_DELTA_STREAMS
+     */
+    int send_datagram_delta(uint8_t stream, const uint8_t *data, uint16_t length);
+#endif
+
+    /**
+     * @brief Send several datagrams under one notification
+     *
+     * Each segment is one datagram. Sending stops at the first datagram that
+     * cannot be queued.
+     *
+     * @return Number of datagrams queued, or a negative error code if none was
+     */
+    int send_many(const LayerSegment *datagrams, uint8_t count);
+
+    /**
+     * @brief Group sends under one outgoing-data notification
+     *
+     * Frames queued between begin_batch() and end_batch() raise
+     * ROBUST_STACK_EVENT_OUTGOING_DATA_AVAILABLE and the notify callback once,
+     * from end_batch(), instead of once per frame.
+     */
+    void begin_batch()
+    {
+        link_layer_.begin_batch();
+    }
+    void end_batch()
+    {
+        link_layer_.end_batch();
+    }
+
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    /**
+     * @brief Coalesce small datagrams into one link frame
+     *
+     * See TransportLayer::set_datagram_aggregation(); 0 bytes disables it.
+     */
+    void set_datagram_aggregation(uint16_t max_bytes, uint32_t max_delay_ms)
+    {
+        transport_layers_[0].set_datagram_aggregation(max_bytes, max_delay_ms);
+    }
+    int flush_datagrams()
+    {
+        return transport_layers_[0].flush_datagrams();
+    }
+#endif
+
+#if LINK_FEC
+    /**
+     * @brief Protect bulk frames with parity, all the time or adaptively
+     *
+     * See LinkLayer::set_fec(); a crc_error_threshold other than 0 lets the
+     * link switch FEC on only while that many received frames per 1000 fail
+     * their CRC. The peer repairs lost frames if it is built with LINK_FEC too.
+     */
+    int set_fec(uint8_t group_size, uint16_t crc_error_threshold)
+    {
+        return link_layer_.set_fec(group_size, crc_error_threshold);
+    }
+#endif
+
+    // Called by the transport layer of each channel
+    int on_receive(uint8_t channel, const uint8_t *data, uint16_t length);
+    int on_message(uint8_t channel, const uint8_t *data, uint32_t length);
+    int on_datagram(uint8_t channel, const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief Set the buffer that segmented messages are reassembled into
+     *
+     * See TransportLayer::set_rx_message_buffer(). The buffer must outlive
+     * the stack or be replaced before it goes away.
+     */
+    void set_rx_message_buffer(uint8_t *buffer, uint32_t size)
+    {
+        transport_layers_[0].set_rx_message_buffer(buffer, size);
+    }
+    void set_rx_message_buffer(uint8_t channel, uint8_t *buffer, uint32_t size)
+    {
+        if (channel < TRANSPORT_MAX_CONNECTIONS)
+        {
+            transport_layers_[channel].set_rx_message_buffer(buffer, size);
+        }
+    }
+
     // Event handling
     void on_layer_event(Layer *source_layer, int32_t event_code, void *parameter);
 
-    void set_event_callback(RobustStackEventCallback callback)
+    /**
+     * @brief Set the callback for events of channel 0
+     *
+     * The data-available events are only raised by the link layer while an
+     * event or notify callback is set.
+     */
+    void set_event_callback(RobustStackEventCallback callback, void *context = NULL)
     {
         event_callback_ = callback;
+        event_context_ = context;
+        update_data_events();
     }
-    void set_data_callback(RobustStackDataCallback callback)
+    void set_data_callback(RobustStackDataCallback callback, void *context = NULL)
     {
         data_callback_ = callback;
+        data_context_ = context;
     }
-    void set_datagram_callback(RobustStackDatagramCallback callback)
+    void set_datagram_callback(RobustStackDatagramCallback callback, void *context = NULL)
     {
         datagram_callback_ = callback;
+        datagram_context_ = context;
+    }
+    void set_notify_callback(RobustStackNotifyCallback callback, void *context = NULL)
+    {
+        notify_callback_ = callback;
+        notify_context_ = context;
+        update_data_events();
+    }
+
+    /**
+     * @brief Set the callback for events of every channel
+     *
+     * Receives the connection and data events of all channels, in addition
+     * to the event callback, which only receives those of channel 0.
+     */
+    void set_channel_event_callback(RobustStackChannelEventCallback callback, void *context = NULL)
+    {
+        channel_event_callback_ = callback;
+        channel_event_context_ = context;
+    }
+
+    /**
+     * @brief Set the callback for reliable data of every channel
+     *
+     * When set, it receives all reliable data and messages instead of the
+     * data and message callbacks.
+     */
+    void set_channel_data_callback(RobustStackChannelDataCallback callback, void *context = NULL)
+    {
+        channel_data_callback_ = callback;
+        channel_data_context_ = context;
+    }
+
+    /**
+     * @brief Set the callback for messages sent with send_message()
+     *
+     * When set, this callback receives every reliable message instead of the
+     * data callback, whether it arrived in one packet or was reassembled.
+     * Without it, reassembled messages up to 65535 bytes go to the data
+     * callback.
+     */
+    void set_message_callback(RobustStackMessageCallback callback, void *context = NULL)
+    {
+        message_callback_ = callback;
+        message_context_ = context;
+    }
+
+    /**
+     * @brief Deliver reliable data of every channel in buffers of a pool
+     *
+     * Each payload and reassembled message is copied once into a buffer of
+     * pool, which the callback receives and keeps until it releases it, e.g.
+     * after a worker task has processed it; the stack's own receive buffers
+     * are reused by the next frame. Takes precedence over the other data
+     * callbacks, which only receive what does not fit the buffers (counted
+     * in loans_missed), after every loaned buffer has been released.
+     *
+     * While all buffers are on loan, received data waits unacknowledged in
+     * the transport window and is retried from tick(). The protocol has no
+     * way to tell the peer to pause, so holding every loan stalls the peer's
+     * window and makes it retransmit the unacknowledged packet on its RTO,
+     * backing off up to TRANSPORT_MAX_RTO_MS: over a 921600 baud loopback a
+     * 100 ms hold costs 3 retransmissions and a 1 s hold 6. After
+     * TRANSPORT_MAX_DATA_RETRIES of them (about 4.5 s with the defaults) the
+     * connection times out like a lost line. Size the pool so that the
+     * application releases a buffer well within one RTO.
+     * NULL for either stops the loans.
+     *
+     * @param pool Buffers to loan; must outlive the stack or be replaced
+     */
+    void set_loan_callback(RxBufferPool *pool, RobustStackLoanCallback callback, void *context = NULL)
+    {
+        loan_pool_ = pool;
+        loan_callback_ = callback;
+        loan_context_ = context;
     }
 
     // Configuration
     void set_timeout(uint32_t keepalive_ms, uint32_t timeout_ms);
+
+    /**
+     * @brief Keep sessions across short outages, see TRANSPORT_OPTION_RESUME
+     *
+     * Takes effect on the next handshake, if the peer enables it too. A
+     * keep-alive or retransmission timeout of channel 0 then reports
+     * ROBUST_STACK_EVENT_SUSPENDED and moves the stack back to
+     * ROBUST_STACK_STATE_CONNECTING instead of ROBUST_STACK_STATE_ERROR;
+     * ROBUST_STACK_EVENT_RESUMED follows once the peer is back, and no
+     * reset() is needed. Data not yet acknowledged is sent again.
+     */
+    void set_session_resumption(bool enable);
+
     int get_state() const
     {
         return state_;
     }
 
+    /**
+     * @brief Take a snapshot of the statistics of all layers
+     *
+     * Copies the counters without locking; call it from the task that runs
+     * the stack.
+     */
+    void get_stats(RobustStackStats &stats) const
+    {
+        link_layer_.get_stats(stats.link);
+        for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+        {
+            transport_layers_[i].get_stats(stats.transport[i]);
+        }
+#if ROBUST_STACK_COMPRESSION
+        compression_layer_.get_stats(stats.compression);
+#endif
+        stats.loans_missed = loans_missed_;
+    }
+
+    /**
+     * @brief Set the statistics of all layers back to zero
+     */
+    void reset_stats()
+    {
+        link_layer_.reset_stats();
+        for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+        {
+            transport_layers_[i].reset_stats();
+        }
+#if ROBUST_STACK_COMPRESSION
+        compression_layer_.reset_stats();
+#endif
+        loans_missed_ = 0;
+    }
+
     // Periodic updates
     void tick();
 
+    /**
+     * @brief Get the time until the stack needs to run again
+     *
+     * Returns 0 while received bytes are queued, otherwise the transport
+     * layer's next timer (see TransportLayer::get_next_deadline()). Encoded
+     * frames the physical layer could not take yet are not a deadline: call
+     * process_outgoing_data() again once the physical layer can accept more.
+     *
+     * @return Milliseconds until tick() or process_incoming_data() is due, or
+     *         TRANSPORT_NO_DEADLINE if the stack is idle
+     */
+    uint32_t get_next_deadline() const;
+
     // Reset functionality
     void reset();
 
@@ -135,9 +580,38 @@ public:
 
     void queue_link_data(const uint8_t *data, uint16_t length);
 
+    // Interrupt-safe queue access, see LinkLayer for the ownership rules
+    int queue_link_data_from_isr(const uint8_t *data, uint16_t length)
+    {
+        return link_layer_.receive_from_isr(data, length);
+    }
+    uint8_t *incoming_write_span(uint16_t &length)
+    {
+        return link_layer_.incoming_write_span(length);
+    }
+    void incoming_commit(uint16_t length)
+    {
+        link_layer_.incoming_commit(length);
+    }
+    const uint8_t *outgoing_read_span(uint16_t &length)
+    {
+        return link_layer_.outgoing_read_span(length);
+    }
+    void outgoing_consume(uint16_t length)
+    {
+        link_layer_.outgoing_consume(length);
+    }
+
 private:
-    // Layer instances
-    TransportLayer transport_layer_;
+    // Timers of all transports, advanced by tick()
+    TimerWheel timer_wheel_;
+
+    // Layer instances, one transport per channel
+    TransportLayer transport_layers_[TRANSPORT_MAX_CONNECTIONS];
+    TransportMux transport_mux_;
+#if ROBUST_STACK_COMPRESSION
+    CompressionLayer compression_layer_;
+#endif
     LinkLayer link_layer_;
     PhysicalLayer &phy_layer_;
 
@@ -146,21 +620,65 @@ private:
     RobustStackEventCallback event_callback_;
     RobustStackDataCallback data_callback_;
     RobustStackDatagramCallback datagram_callback_;
+    RobustStackMessageCallback message_callback_;
+    RobustStackNotifyCallback notify_callback_;
+    RobustStackChannelEventCallback channel_event_callback_;
+    RobustStackChannelDataCallback channel_data_callback_;
+    RobustStackLoanCallback loan_callback_;
+    void *event_context_;
+    void *data_context_;
+    void *datagram_context_;
+    void *message_context_;
+    void *notify_context_;
+    void *channel_event_context_;
+    void *channel_data_context_;
+    void *loan_context_;
+    RxBufferPool *loan_pool_;
+    uint32_t loans_missed_;
 
     // Layer event handlers
     void on_physical_layer_event(int32_t event_code, void *parameter);
     void on_link_layer_event(int32_t event_code, void *parameter);
-    void on_transport_layer_event(int32_t event_code, void *parameter);
+    void on_transport_layer_event(uint8_t channel, int32_t event_code, void *parameter);
 
     // Internal methods
     void report_event(RobustStackEvent event);
+    void report_event(uint8_t channel, RobustStackEvent event);
+    void notify();
     void set_state(RobustStackState new_state);
+    bool deliver(uint8_t channel, const uint8_t *data, uint32_t length);
+
+    // Only subscribers need the link layer's data-available events
+    void update_data_events()
+    {
+        link_layer_.set_data_events(event_callback_ != NULL || notify_callback_ != NULL);
+    }
+#if ROBUST_STACK_COMPRESSION
+    void update_compression();
+#endif
 
     // Prevent copy and assignment
     RobustStack(const RobustStack &);
     RobustStack &operator=(const RobustStack &);
 };
 
+/**
+ * @brief RobustStack with its own buffers, sized by the RobustStackStorage parameters
+ */
+template <uint8_t WINDOW = TRANSPORT_WINDOW_SIZE, uint16_t OUTGOING = LINK_OUTGOING_BUFFER_SIZE,
+          uint16_t INCOMING = LINK_INCOMING_BUFFER_SIZE, uint16_t DATAGRAM = LINK_DATAGRAM_BUFFER_SIZE,
+          uint16_t CONTROL = LINK_CONTROL_BUFFER_SIZE>
+class StaticRobustStack : private RobustStackStorage<WINDOW, OUTGOING, INCOMING, DATAGRAM, CONTROL>,
+                          public RobustStack
+{
+    // The storage is a base listed before RobustStack, so it is constructed
+    // before the stack that uses it
+    typedef RobustStackStorage<WINDOW, OUTGOING, INCOMING, DATAGRAM, CONTROL> Storage;
+
+public:
+    explicit StaticRobustStack(PhysicalLayer &phy) : RobustStack(phy, Storage::buffers()) {}
+};
+
 } // namespace robust_serial
 
 #endif // __ROBUST_STACK_HPP__
@@ -0,0 +1,160 @@
+#ifndef __RX_BUFFER_POOL_HPP__
+#define __RX_BUFFER_POOL_HPP__
+
+#include <atomic>
+#include <cstddef> // For NULL
+#include <cstdint>
+
+namespace robust_serial
+{
+
+/**
+ * @brief One received payload on loan to the application, see RxBufferPool
+ *
+ * data and size are fixed by the pool; length and channel describe the
+ * payload while the buffer is on loan.
+ */
+struct RxBuffer
+{
+    uint8_t *data;   /**< Payload storage */
+    uint32_t size;   /**< Capacity of data in bytes */
+    uint32_t length; /**< Payload length in bytes */
+    uint8_t channel; /**< Channel the payload arrived on */
+
+    std::atomic<bool> in_use; /**< Owned by the pool: the buffer is on loan */
+};
+
+/**
+ * @brief Fixed set of receive buffers that the application can hold on to
+ *
+ * RobustStack::set_loan_callback() delivers reliable data in these buffers
+ * instead of in the stack's own, which the next frame overwrites. The
+ * application keeps a buffer as long as it needs it, e.g. passes it to a
+ * worker task, and hands it back with release().
+ *
+ * Only the task running the stack acquires buffers; release() may be called
+ * from any task or interrupt handler. The flag of each buffer is published
+ * with a release store and read with an acquire load, so a buffer's bytes
+ * are only overwritten after its holder is done with them.
+ *
+ * The storage is provided by the owner, like that of RingBuffer;
+ * StaticRxBufferPool bundles a pool with its RxBufferPoolStorage.
+ */
+class RxBufferPool
+{
+public:
+    /**
+     * @param buffers count descriptors, must outlive the pool
+     * @param storage count * size bytes, must outlive the pool
+     * @param count Number of buffers
+     * @param size Capacity of each buffer in bytes
+     */
+    RxBufferPool(RxBuffer *buffers, uint8_t *storage, uint8_t count, uint32_t size)
+        : buffers_(buffers), count_(count), size_(size), next_(0)
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            buffers[i].data = &storage[i * size];
+            buffers[i].size = size;
+            buffers[i].length = 0;
+            buffers[i].channel = 0;
+            buffers[i].in_use.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /** @brief Capacity of each buffer in bytes */
+    uint32_t buffer_size() const { return size_; }
+
+    /** @brief Number of buffers */
+    uint8_t count() const { return count_; }
+
+    /**
+     * @brief Take a free buffer, from the task running the stack only
+     *
+     * @return The buffer, NULL if all are on loan
+     */
+    RxBuffer *acquire()
+    {
+        for (uint8_t i = 0; i < count_; i++)
+        {
+            RxBuffer &buffer = buffers_[next_];
+            next_ = (next_ + 1 < count_) ? next_ + 1 : 0;
+            if (!buffer.in_use.load(std::memory_order_acquire))
+            {
+                buffer.in_use.store(true, std::memory_order_relaxed);
+                return &buffer;
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief Hand a buffer back, from any context
+     */
+    static void release(RxBuffer *buffer)
+    {
+        if (buffer)
+        {
+            buffer->in_use.store(false, std::memory_order_release);
+        }
+    }
+
+    /** @brief Number of buffers not on loan */
+    uint8_t available() const
+    {
+        uint8_t free = 0;
+        for (uint8_t i = 0; i < count_; i++)
+        {
+            if (!buffers_[i].in_use.load(std::memory_order_acquire))
+            {
+                free++;
+            }
+        }
+        return free;
+    }
+
+private:
+    RxBuffer *buffers_;
+    uint8_t count_;
+    uint32_t size_;
+    uint8_t next_; // Where acquire() starts looking, so buffers are used in turn
+
+    // Prevent copy and assignment
+    RxBufferPool(const RxBufferPool &);
+    RxBufferPool &operator=(const RxBufferPool &);
+};
+
+/**
+ * @brief Statically sized storage for one RxBufferPool
+ *
+ * Must outlive the pool using it; StaticRxBufferPool bundles both.
+ */
+template <uint8_t COUNT, uint32_t SIZE>
+struct RxBufferPoolStorage
+{
+    static_assert(COUNT > 0 && SIZE > 0, "A pool needs at least one non-empty buffer");
+
+    RxBuffer buffers[COUNT];
+    uint8_t storage[COUNT * SIZE];
+};
+
+/**
+ * @brief RxBufferPool with its own storage
+ *
+ * SIZE should cover the longest payload to be loaned: TRANSPORT_MAX_PAYLOAD_SIZE
+ * for single packets, the reassembly buffer size for messages.
+ */
+template <uint8_t COUNT, uint32_t SIZE>
+class StaticRxBufferPool : private RxBufferPoolStorage<COUNT, SIZE>, public RxBufferPool
+{
+    // The storage is a base listed before RxBufferPool, so its buffers exist
+    // before the pool constructor sets them up
+    typedef RxBufferPoolStorage<COUNT, SIZE> Storage;
+
+public:
+    StaticRxBufferPool() : RxBufferPool(Storage::buffers, Storage::storage, COUNT, SIZE) {}
+};
+
+} // namespace robust_serial
+
+#endif // __RX_BUFFER_POOL_HPP__
@@ -0,0 +1,105 @@
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include <cstdint>
+
+/**
+ * @brief Number of buckets in a StatsHistogram
+ *
+ * Bucket 0 counts samples of 0 ms; bucket i (i >= 1) counts samples in
+ * [2^(i-1), 2^i) ms, and the last bucket also takes everything above. The
+ * default of 13 buckets resolves up to 2048 ms, beyond TRANSPORT_MAX_RTO_MS.
+ */
+#ifndef STATS_HISTOGRAM_BUCKETS
+#define STATS_HISTOGRAM_BUCKETS 13
+#endif
+
+namespace robust_serial
+{
+
+/**
+ * @brief Fixed-bucket histogram of millisecond durations
+ *
+ * Buckets grow in powers of two so that a handful of counters covers both
+ * sub-millisecond loopback links and slow radio links. Adding a sample costs
+ * a few instructions and never allocates.
+ */
+struct StatsHistogram
+{
+    uint32_t buckets[STATS_HISTOGRAM_BUCKETS]; /**< Sample count per bucket */
+    uint32_t count;                            /**< Total number of samples */
+    uint32_t sum_ms;                           /**< Sum of all samples (wraps), for the mean */
+    uint32_t min_ms;                           /**< Smallest sample, 0xFFFFFFFF if none */
+    uint32_t max_ms;                           /**< Largest sample */
+
+    void reset()
+    {
+        for (uint8_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+        {
+            buckets[i] = 0;
+        }
+        count = 0;
+        sum_ms = 0;
+        min_ms = 0xFFFFFFFFu;
+        max_ms = 0;
+    }
+
+    void add(uint32_t value_ms)
+    {
+        // Bucket index is the bit width of the sample
+        uint8_t bucket = 0;
+        for (uint32_t v = value_ms; v != 0 && bucket < STATS_HISTOGRAM_BUCKETS - 1; v >>= 1)
+        {
+            bucket++;
+        }
+        buckets[bucket]++;
+        count++;
+        sum_ms += value_ms;
+        if (value_ms < min_ms)
+        {
+            min_ms = value_ms;
+        }
+        if (value_ms > max_ms)
+        {
+            max_ms = value_ms;
+        }
+    }
+
+    /**
+     * @brief Estimate a percentile of the samples
+     *
+     * Returns the upper bound of the bucket holding the percentile, capped by
+     * max_ms, so the estimate is never below the true value, and above it by
+     * at most the bucket's width.
+     *
+     * @param percent Percentile, 1 to 100
+     * @return Duration in ms, 0 if there are no samples
+     */
+    uint32_t percentile_ms(uint8_t percent) const
+    {
+        uint32_t rank = static_cast<uint32_t>((static_cast<uint64_t>(count) * percent + 99) / 100);
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank && seen > 0)
+            {
+                uint32_t upper = (i == STATS_HISTOGRAM_BUCKETS - 1) ? max_ms : bucket_lower_bound_ms(i + 1) - 1;
+                return (upper < max_ms) ? upper : max_ms;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Get the smallest duration that falls in a bucket
+     */
+    static uint32_t bucket_lower_bound_ms(uint8_t bucket)
+    {
+        return (bucket == 0) ? 0 : (1u << (bucket - 1));
+    }
+};
+
+} // namespace robust_serial
+
+#endif // __STATS_HPP__
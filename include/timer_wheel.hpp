@@ -0,0 +1,167 @@
+#ifndef __TIMER_WHEEL_HPP__
+#define __TIMER_WHEEL_HPP__
+
+#include <cstddef> // For NULL
+#include <cstdint>
+
+/**
+ * @brief Slots per level of a TimerWheel, as a power of two
+ */
+#ifndef TIMER_WHEEL_SLOT_BITS
+#define TIMER_WHEEL_SLOT_BITS 4
+#endif
+
+/**
+ * @brief Levels of a TimerWheel
+ *
+ * Level k holds timers due in 2^(k * TIMER_WHEEL_SLOT_BITS) ms or later, in
+ * slots that many ms wide. Timers beyond the last level wait in its farthest
+ * slot and are filed again when it comes up, so any delay works; the default
+ * covers 65 seconds without that detour.
+ */
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 4
+#endif
+
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_NO_DEADLINE 0xFFFFFFFFu /**< get_next_deadline(): no timer is running */
+
+static_assert(TIMER_WHEEL_SLOT_BITS >= 1 && TIMER_WHEEL_SLOT_BITS <= 5,
+              "A level's occupancy is a 32-bit mask");
+static_assert(TIMER_WHEEL_LEVELS >= 1 && TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS <= 31,
+              "The wheel must span less than half the 32-bit millisecond clock");
+
+namespace robust_serial
+{
+
+/**
+ * @brief Called when a timer expires, with the context given to the timer
+ */
+typedef void (*TimerCallback)(void *context);
+
+/**
+ * @brief One timer of a TimerWheel, embedded in its owner
+ *
+ * The wheel links timers into its slots through the timers themselves, so
+ * starting and stopping one never allocates.
+ */
+class Timer
+{
+public:
+    Timer(TimerCallback callback, void *context)
+        : next_(NULL), pprev_(NULL), expiry_(0), callback_(callback), context_(context), level_(0), slot_(0)
+    {
+    }
+
+    /**
+     * @brief Check whether the timer is waiting to expire
+     */
+    bool is_active() const
+    {
+        return pprev_ != NULL;
+    }
+
+    /**
+     * @brief Time the timer was last started for, in ms
+     */
+    uint32_t get_expiry() const
+    {
+        return expiry_;
+    }
+
+private:
+    friend class TimerWheel;
+
+    Timer *next_;
+    Timer **pprev_; // Link that points to this timer, NULL while inactive
+    uint32_t expiry_;
+    TimerCallback callback_;
+    void *context_;
+    uint8_t level_; // Where the timer is linked, see TimerWheel
+    uint8_t slot_;
+
+    // Prevent copy and assignment
+    Timer(const Timer &);
+    Timer &operator=(const Timer &);
+};
+
+/**
+ * @brief Hierarchical timer wheel with millisecond resolution
+ *
+ * Timers are filed by expiry into one of TIMER_WHEEL_LEVELS rings of
+ * TIMER_WHEEL_SLOTS slots: the nearest in 1 ms slots, later ones in
+ * coarser slots that move down a level as their time approaches. Starting,
+ * restarting and stopping a timer is O(1). advance() jumps from one occupied
+ * slot to the next with the levels' occupancy masks, so it costs O(expired)
+ * plus at most one move per level for each timer, no matter how much time
+ * has passed; get_next_deadline() usually looks at one slot per level.
+ *
+ * Callbacks run from advance() and may start or stop any timer, including
+ * their own. A timer started for a time that has already passed expires on
+ * the next advance(), not the current one, so a callback that retries at
+ * once cannot keep advance() busy.
+ *
+ * Not thread safe: the wheel and its timers belong to the task that
+ * advances it.
+ */
+class TimerWheel
+{
+public:
+    TimerWheel();
+
+    /**
+     * @brief Start a timer, or move it if it is running
+     *
+     * @param expiry When the timer expires, in ms of get_current_time_ms()
+     * @param now Current time, to catch up a wheel that had nothing to do
+     */
+    void start(Timer &timer, uint32_t expiry, uint32_t now);
+
+    /**
+     * @brief Stop a timer; nothing happens if it is not running
+     */
+    void stop(Timer &timer);
+
+    /**
+     * @brief Run the callbacks of every timer due by now
+     *
+     * @param now Current time in ms; may wrap around
+     */
+    void advance(uint32_t now);
+
+    /**
+     * @brief Get the time until the next timer expires
+     *
+     * @return Milliseconds from now (0 if due), TIMER_WHEEL_NO_DEADLINE if no
+     *         timer is running
+     */
+    uint32_t get_next_deadline(uint32_t now) const;
+
+    /**
+     * @brief Number of running timers
+     */
+    uint16_t get_count() const
+    {
+        return count_;
+    }
+
+private:
+    void insert(Timer &timer, Timer **due);
+    void unlink(Timer &timer);
+    bool next_event(uint32_t &delay) const;
+    void fire(Timer *&due);
+
+    Timer *slots_[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint32_t occupied_[TIMER_WHEEL_LEVELS]; // Bit per slot that holds a timer
+    Timer *expired_;                        // Started for a past time, expire on the next advance()
+    uint32_t now_;                          // Everything due by now_ has expired
+    uint16_t count_;
+
+    // Prevent copy and assignment
+    TimerWheel(const TimerWheel &);
+    TimerWheel &operator=(const TimerWheel &);
+};
+
+} // namespace robust_serial
+
+#endif // __TIMER_WHEEL_HPP__
@@ -4,6 +4,8 @@
 #include "config.hpp"
 #include "link_layer.hpp"   // For LINK_MAX_PAYLOAD_SIZE
 #include "system_utils.hpp" // For get_current_time_ms
+#include "stats.hpp"
+#include "timer_wheel.hpp"
 
 namespace robust_serial
 {
@@ -25,13 +27,26 @@ namespace robust_serial
 #define TRANSPORT_PACKET_TYPE_KEEPALIVE    0x09 /**< Keep-alive request packet */
 #define TRANSPORT_PACKET_TYPE_KEEPALIVE_ACK 0x0A /**< Keep-alive acknowledgment packet */
 #define TRANSPORT_PACKET_TYPE_DATAGRAM     0x0B /**< Datagram packet (connectionless) */
-#define TRANSPORT_PACKET_TYPE_MAX          0x0C /**< Maximum value for packet types */
+#define TRANSPORT_PACKET_TYPE_DATA_FRAGMENT 0x0C /**< Data packet followed by more segments of the same message */
+#define TRANSPORT_PACKET_TYPE_DATAGRAM_BATCH 0x0D /**< Several small datagrams in one packet (connectionless) */
+#define TRANSPORT_PACKET_TYPE_DATAGRAM_DELTA 0x0E /**< Datagram of a stream, as keyframe or difference to it (connectionless) */
+#define TRANSPORT_PACKET_TYPE_RESUME       0x0F /**< Request to resume a suspended session */
+#define TRANSPORT_PACKET_TYPE_RESUME_ACK   0x10 /**< Answer to RESUME: the session continues */
+#define TRANSPORT_PACKET_TYPE_MAX          0x11 /**< Maximum value for packet types */
+
+#define TRANSPORT_PACKET_FLAG_ACK          0x80 /**< DATA/DATA_FRAGMENT type flag: a piggybacked ACK follows the header */
 
 // Connection ID related definitions
 #define TRANSPORT_CONNECTION_ID_INVALID    0x00 /**< Invalid connection ID */
 #define TRANSPORT_CONNECTION_ID_MAX        0xFF /**< Maximum connection ID value */
 #define TRANSPORT_CONNECTION_ID_START      0x01 /**< Starting connection ID value */
 
+// Handshake options, see set_options()
+#define TRANSPORT_OPTION_COMPRESSION       0x01 /**< Frames from the peer may be compressed (CompressionLayer) */
+#define TRANSPORT_OPTION_RESUME            0x02 /**< A timed-out connection is suspended and resumed, see set_options() */
+#define TRANSPORT_OPTION_WINDOW_MASK       0x70 /**< Window depth as log2(depth) + 1, 0 if not announced */
+#define TRANSPORT_OPTION_WINDOW_SHIFT      4
+
 /**
  * @brief Transport Layer Packet Structure
  *
@@ -43,9 +58,26 @@ namespace robust_serial
  *    +----------------+----------------+----------------+----------------+------------------+
  *    | Packet Type    | Conn ID        | Seq Number     | Payload Length | Payload Data     |
  *    | (1 byte)       | (1 byte)       | (1 byte)       | (1 byte)       | (0-246 bytes)    |
- *    | 0x01-0x0A      | 0x01-0xFF      | 0-255          | 0-246          |                  |
+ *    | 0x01-0x0A,0x0C | 0x01-0xFF      | 0-255          | 0-246          |                  |
  *    +----------------+----------------+----------------+----------------+------------------+
  *
+ *    Piggybacked acknowledgment:
+ *    A DATA or DATA_FRAGMENT packet whose type has TRANSPORT_PACKET_FLAG_ACK
+ *    (0x80) set carries one extra byte between the header and the payload:
+ *    a cumulative acknowledgment for the reverse direction, with the meaning
+ *    of the sequence field of a DATA_ACK without bitmap. The receiver of
+ *    DATA attaches it to the next packet it sends in place of a separate
+ *    DATA_ACK; a packet with a full-size payload has no room for it.
+ *    +----------------+----------------+----------------+----------------+----------------+--------------+
+ *    | Type | 0x80    | Conn ID        | Seq Number     | Payload Length | Cumulative ACK | Payload Data |
+ *    +----------------+----------------+----------------+----------------+----------------+--------------+
+ *
+ *    Segmented messages:
+ *    A message longer than one packet is sent as consecutive DATA_FRAGMENT
+ *    (0x0C) packets followed by one DATA packet carrying the last segment.
+ *    Both types share the sequence space, window and acknowledgments. A
+ *    message that fits in one packet is a single DATA packet.
+ *
  *    Special cases:
  *    ACK Packet:
  *    +----------------+----------------+----------------+----------------+
@@ -54,6 +86,41 @@ namespace robust_serial
  *    | 0x03/0x07      | 0x01-0xFF      | 0-255          | 0x00          |
  *    +----------------+----------------+----------------+----------------+
  *
+ *    SYN / SYN-ACK Packet:
+ *    +----------------+----------------+----------------+----------------+------------------+------------------+
+ *    | Packet Type    | Conn ID        | Seq Number     | Payload Length | Options          | Session Token    |
+ *    | (1 byte)       | (1 byte)       | (1 byte)       | (1 byte)       | (0-1 byte)       | (SYN-ACK, 0/4)   |
+ *    | 0x01/0x02      | 0x00-0xFF      | 0-255          | 0-1, 5         | Option bits      | little endian    |
+ *    +----------------+----------------+----------------+----------------+------------------+------------------+
+ *    The SYN offers the initiator's options, the SYN-ACK answers with those
+ *    the listener also supports; a missing byte means no options. When
+ *    TRANSPORT_OPTION_RESUME is agreed, the SYN-ACK also carries the token
+ *    that identifies the session. Bits 4-6 announce the sender's window
+ *    depth as log2(depth) + 1: the SYN that of the initiator, the SYN-ACK
+ *    the smaller of both, which both sides then use. A peer that announces
+ *    none is taken to have the same depth.
+ *
+ *    RESUME / RESUME_ACK Packet:
+ *    +----------------+----------------+----------------+----------------+------------------+
+ *    | Packet Type    | Conn ID        | Next Seq       | Payload Length | Session Token    |
+ *    | (1 byte)       | (1 byte)       | (1 byte)       | (1 byte)       | (4 bytes)        |
+ *    | 0x0F/0x10      | 0x01-0xFF      | 0-255          | 4              | little endian    |
+ *    +----------------+----------------+----------------+----------------+------------------+
+ *    Next Seq is the next DATA sequence number the sender expects, so it
+ *    acknowledges every packet before it. A peer that knows the token
+ *    answers a RESUME with a RESUME_ACK; both then resend what the other
+ *    has not acknowledged.
+ *
+ *    DATA_ACK Packet (cumulative + selective):
+ *    +----------------+----------------+----------------+----------------+------------------+
+ *    | Packet Type    | Conn ID        | Cumulative Seq | Bitmap Length  | SACK Bitmap      |
+ *    | (1 byte)       | (1 byte)       | (1 byte)       | (1 byte)       | (0-4 bytes)      |
+ *    | 0x07           | 0x01-0xFF      | 0-255          | 0-4            | little endian    |
+ *    +----------------+----------------+----------------+----------------+------------------+
+ *    The sequence field acknowledges every packet up to and including that
+ *    sequence number. Bit i of the optional bitmap acknowledges packet
+ *    (sequence + 1 + i), which the receiver holds out of order.
+ *
  *    Keep-alive Packet:
  *    +----------------+----------------+----------------+----------------+
  *    | Packet Type    | Conn ID        | Zero           | Zero           |
@@ -68,6 +135,36 @@ namespace robust_serial
  *    | 0x0B           | 0-248          |                  |
  *    +----------------+----------------+------------------+
  *
+ * 3. Datagram Batch Packet Format:
+ *    +----------------+----------------+------------------+----------------+------------------+-----+
+ *    | Packet Type    | Item Length    | Item Data        | Item Length    | Item Data        | ... |
+ *    | (1 byte)       | (1 byte)       | (0-255 bytes)    | (1 byte)       | (0-255 bytes)    |     |
+ *    | 0x0D           |                |                  |                |                  |     |
+ *    +----------------+----------------+------------------+----------------+------------------+-----+
+ *    Each item is delivered as a datagram of its own. Batches are built by
+ *    the sender when datagram aggregation is enabled (see
+ *    set_datagram_aggregation()); every receiver accepts them.
+ *
+ * 4. Delta Datagram Packet Format:
+ *    +----------------+----------------+----------------+------------------+
+ *    | Packet Type    | Stream ID      | Key            | Data             |
+ *    | (1 byte)       | (1 byte)       | (1 byte)       | (0-247 bytes)    |
+ *    | 0x0E           | 0-STREAMS-1    | K | Key ID     |                  |
+ *    +----------------+----------------+----------------+------------------+
+ *    With bit 7 (K) of the Key byte set, the packet is a keyframe: Data is
+ *    the complete datagram, and the receiver keeps it as the reference of
+ *    the stream under the Key ID in bits 6-0. Otherwise Data describes a
+ *    datagram of the same length as keyframe Key ID, as runs of
+ *    [Unchanged(1) | Changed(1) | Changed bytes]: skip Unchanged bytes of
+ *    the keyframe, then replace the next Changed bytes. Bytes after the last
+ *    run are those of the keyframe. A delta whose keyframe was lost is
+ *    dropped; the sender repeats keyframes periodically for resync (see
+ *    send_datagram_delta()).
+ *
+ * The Conn ID of a SYN is 0, letting the listener assign the connection ID
+ * in its SYN-ACK, or the fixed connection ID both peers were configured with
+ * (see set_connection_id()).
+ *
  * Examples:
  * 1. SYN packet:      [0x01 | 0x00 | 0x00]
  * 2. SYN-ACK packet:  [0x02 | 0x01 | 0x00]
@@ -80,17 +177,160 @@ namespace robust_serial
  * (LINK_MAX_PAYLOAD_SIZE = 250 bytes). For connection-oriented packets, the maximum
  * payload size is 246 bytes (250 - 4 header bytes). For datagrams, the maximum
  * payload size is 248 bytes (250 - 2 header bytes).
+ *
+ * In the link layer's large-frame mode the payloads grow with
+ * LINK_MAX_PAYLOAD_SIZE. The 8-bit Payload Length field then only carries the
+ * low byte of the length; receivers take the length from the link frame.
+ * Each window slot then holds a full packet, and TRANSPORT_MAX_RTO_MS and the
+ * connection timeout should exceed the time needed to serialize a full window.
  */
-#define TRANSPORT_MAX_PACKET_SIZE LINK_MAX_PAYLOAD_SIZE /**< Maximum total packet size (250 bytes) */
+#define TRANSPORT_MAX_PACKET_SIZE LINK_MAX_PAYLOAD_SIZE /**< Maximum total packet size (250 bytes by default) */
 #define TRANSPORT_HEADER_SIZE     4                     /**< Size of transport layer header (TYPE + CONN_ID + SEQ + LENGTH) */
 #define TRANSPORT_MAX_PAYLOAD_SIZE                                                                                     \
-    (TRANSPORT_MAX_PACKET_SIZE - TRANSPORT_HEADER_SIZE) /**< Maximum payload size (246 bytes) */
+    (TRANSPORT_MAX_PACKET_SIZE - TRANSPORT_HEADER_SIZE) /**< Maximum payload size (246 bytes by default) */
 
 // Transport Layer Timing Parameters
 #define TRANSPORT_LAYER_DEFAULT_KEEPALIVE_MS 1000 // Default keep-alive interval (1 second)
 #define TRANSPORT_LAYER_DEFAULT_TIMEOUT_MS   3000 // Default connection timeout (3 seconds)
-#define TRANSPORT_ACK_TIMEOUT_MS             100  // Timeout for acknowledgment (100ms)
-#define TRANSPORT_MAX_RETRIES                3    // Maximum number of retransmission attempts
+#define TRANSPORT_ACK_TIMEOUT_MS             100  // Initial retransmission timeout before any RTT sample (100ms)
+#define TRANSPORT_MAX_RETRIES                3    // Maximum number of connection attempts
+
+/**
+ * @brief RESUME packets sent for a suspended session before giving it up
+ *
+ * They are one keep-alive interval apart, so by default a session survives
+ * an outage of about eight seconds.
+ */
+#ifndef TRANSPORT_RESUME_ATTEMPTS
+#define TRANSPORT_RESUME_ATTEMPTS 8
+#endif
+
+/**
+ * @brief Retransmission timeout (RTO) limits
+ *
+ * The RTO is derived from the smoothed round-trip time and its variance
+ * (SRTT/RTTVAR, RFC 6298) measured from DATA/DATA_ACK timestamps, doubled on
+ * every timeout and clamped to this range. The minimum should be at least one
+ * tick of get_current_time_ms().
+ */
+#ifndef TRANSPORT_MIN_RTO_MS
+#define TRANSPORT_MIN_RTO_MS 10
+#endif
+#ifndef TRANSPORT_MAX_RTO_MS
+#define TRANSPORT_MAX_RTO_MS 2000
+#endif
+#define TRANSPORT_MAX_DATA_RETRIES 8 // Retransmissions of one DATA packet before the connection times out
+
+/**
+ * @brief Default sliding window depth for reliable data transfer
+ *
+ * Number of DATA packets that may be in flight (sent but not yet
+ * acknowledged) at any time. The receiver buffers up to the same number of
+ * out-of-order packets (selective repeat). Each slot costs one
+ * TRANSPORT_MAX_PACKET_SIZE buffer on the sender and one
+ * TRANSPORT_MAX_PAYLOAD_SIZE buffer on the receiver.
+ *
+ * The window is sized per transport, see TransportWindowStorage; this is the
+ * default. A size must be a power of two between 1 and 32 (the SACK bitmap
+ * is 32 bits wide), and both peers must use the same size.
+ */
+#ifndef TRANSPORT_WINDOW_SIZE
+#define TRANSPORT_WINDOW_SIZE 8
+#endif
+
+#define TRANSPORT_VALID_WINDOW_SIZE(size) ((size) >= 1 && (size) <= 32 && ((size) & ((size) - 1)) == 0)
+
+#if !TRANSPORT_VALID_WINDOW_SIZE(TRANSPORT_WINDOW_SIZE)
+#error "TRANSPORT_WINDOW_SIZE must be a power of two between 1 and 32"
+#endif
+
+#define TRANSPORT_SACK_BITMAP_SIZE 4 /**< Maximum size of the DATA_ACK selective bitmap in bytes */
+
+/**
+ * @brief Delayed acknowledgments
+ *
+ * In-order DATA packets are not acknowledged one by one. The receiver waits
+ * up to TRANSPORT_DELAYED_ACK_MS for reverse-direction DATA to piggyback the
+ * acknowledgment on, and otherwise sends one cumulative DATA_ACK for all
+ * packets received meanwhile, at the latest after
+ * TRANSPORT_DELAYED_ACK_PACKETS of them, or half the window if that is
+ * smaller. Out-of-order and duplicate packets are acknowledged at once. A
+ * delay of 0 acknowledges every packet at once.
+ *
+ * The delay adds to the peer's RTT samples and must stay below
+ * TRANSPORT_MIN_RTO_MS, so that the sender never times out waiting for an
+ * acknowledgment that is merely being held back.
+ */
+#ifndef TRANSPORT_DELAYED_ACK_MS
+#define TRANSPORT_DELAYED_ACK_MS 2
+#endif
+#ifndef TRANSPORT_DELAYED_ACK_PACKETS
+#define TRANSPORT_DELAYED_ACK_PACKETS ((TRANSPORT_WINDOW_SIZE + 1) / 2) // Half a window keeps the sender busy
+#endif
+
+static_assert(TRANSPORT_DELAYED_ACK_MS < TRANSPORT_MIN_RTO_MS,
+              "TRANSPORT_DELAYED_ACK_MS must be below TRANSPORT_MIN_RTO_MS");
+static_assert(TRANSPORT_DELAYED_ACK_PACKETS >= 1 && TRANSPORT_DELAYED_ACK_PACKETS <= 32,
+              "TRANSPORT_DELAYED_ACK_PACKETS must be between 1 and 32");
+
+/**
+ * @brief Delay before retrying a packet the link layer could not take
+ *
+ * Acknowledgments, retransmissions and message segments that find the link
+ * queue full wait this long before the next attempt (a datagram batch waits
+ * its latency budget), so that a task sleeping until get_next_deadline()
+ * does not spin while the queue drains.
+ */
+#ifndef TRANSPORT_LINK_RETRY_MS
+#define TRANSPORT_LINK_RETRY_MS 1
+#endif
+
+static_assert(TRANSPORT_LINK_RETRY_MS >= 1, "TRANSPORT_LINK_RETRY_MS must be at least 1");
+
+/**
+ * @brief Datagram aggregation support
+ *
+ * Set to 1 to let set_datagram_aggregation() coalesce small datagrams into
+ * DATAGRAM_BATCH packets; each transport then keeps a
+ * TRANSPORT_MAX_PACKET_SIZE batch buffer. Receiving batches does not depend
+ * on it.
+ */
+#ifndef TRANSPORT_DATAGRAM_AGGREGATION
+#define TRANSPORT_DATAGRAM_AGGREGATION 0
+#endif
+
+/**
+ * @brief Delta-encoded datagram streams, see send_datagram_delta()
+ *
+ * Each stream costs two TRANSPORT_DELTA_MAX_LENGTH buffers per transport,
+ * one for the keyframe sent and one for the keyframe received. A stream
+ * sends a full keyframe at least every TRANSPORT_DELTA_KEYFRAME_INTERVAL
+ * datagrams, bounding how long a receiver stays out of step after losing
+ * one. Delta datagrams are left out unless TRANSPORT_DELTA_STREAMS is set,
+ * e.g. to 4, on both peers; without them DATAGRAM_DELTA packets are dropped.
+ */
+#ifndef TRANSPORT_DELTA_STREAMS
+#define TRANSPORT_DELTA_STREAMS 0
+#endif
+#ifndef TRANSPORT_DELTA_MAX_LENGTH
+#define TRANSPORT_DELTA_MAX_LENGTH 64
+#endif
+#ifndef TRANSPORT_DELTA_KEYFRAME_INTERVAL
+#define TRANSPORT_DELTA_KEYFRAME_INTERVAL 32
+#endif
+
+#define TRANSPORT_DELTA_HEADER_SIZE 3    /**< TYPE + STREAM + KEY */
+#define TRANSPORT_DELTA_KEYFRAME    0x80 /**< Key byte flag of a keyframe */
+
+#if TRANSPORT_DELTA_STREAMS
+static_assert(TRANSPORT_DELTA_MAX_LENGTH >= 1 &&
+                  TRANSPORT_DELTA_MAX_LENGTH + TRANSPORT_DELTA_HEADER_SIZE <= TRANSPORT_MAX_PACKET_SIZE,
+              "TRANSPORT_DELTA_MAX_LENGTH must fit a keyframe into one packet");
+static_assert(TRANSPORT_DELTA_KEYFRAME_INTERVAL >= 1 && TRANSPORT_DELTA_KEYFRAME_INTERVAL <= 255,
+              "TRANSPORT_DELTA_KEYFRAME_INTERVAL must be between 1 and 255");
+#endif
+
+#define TRANSPORT_NO_DEADLINE 0xFFFFFFFFu /**< get_next_deadline(): no timer is running */
 
 /**
  * @brief Transport Layer Error Codes
@@ -108,7 +348,9 @@ enum TransportLayerError
     TRANSPORT_ERROR_INVALID_PACKET = ERROR_RANGE_TRANSPORT - 5,
     TRANSPORT_ERROR_BUFFER_OVERFLOW = ERROR_RANGE_TRANSPORT - 6,
     TRANSPORT_ERROR_SEND_FAILED = ERROR_RANGE_TRANSPORT - 7,
-    TRANSPORT_ERROR_INVALID_STATE = ERROR_RANGE_TRANSPORT - 8 // Layer is in an invalid state for the operation
+    TRANSPORT_ERROR_INVALID_STATE = ERROR_RANGE_TRANSPORT - 8, // Layer is in an invalid state for the operation
+    TRANSPORT_ERROR_WINDOW_FULL = ERROR_RANGE_TRANSPORT - 9,   // All window slots are awaiting acknowledgment
+    TRANSPORT_ERROR_BUSY = ERROR_RANGE_TRANSPORT - 10          // A segmented message is still being sent
 };
 
 /**
@@ -121,7 +363,8 @@ enum TransportState
     TRANSPORT_STATE_CONNECTING = 2,    // Client mode: connection in progress
     TRANSPORT_STATE_CONNECTED = 3,     // Connection established
     TRANSPORT_STATE_DISCONNECTING = 4, // Graceful disconnect in progress
-    TRANSPORT_STATE_ERROR = 5          // Error state
+    TRANSPORT_STATE_ERROR = 5,         // Error state
+    TRANSPORT_STATE_RESUMING = 6       // Connection lost, trying to resume the session
 };
 
 /**
@@ -139,7 +382,10 @@ enum TransportLayerEvent
     TRANSPORT_LAYER_EVENT_ERROR,                // Error occurred
     TRANSPORT_LAYER_EVENT_TIMEOUT,              // Connection timeout
     TRANSPORT_LAYER_EVENT_READY_FOR_DATA,       // Layer ready to handle data transmission
-    TRANSPORT_LAYER_EVENT_READY_FOR_CONNECTION  // Layer ready to accept new connections
+    TRANSPORT_LAYER_EVENT_READY_FOR_CONNECTION, // Layer ready to accept new connections
+    TRANSPORT_LAYER_EVENT_MESSAGE_SENT,         // Last segment of a message entered the send window
+    TRANSPORT_LAYER_EVENT_SUSPENDED,            // Connection lost, the session is kept for resumption
+    TRANSPORT_LAYER_EVENT_RESUMED               // Suspended session continues where it stopped
 };
 
 /**
@@ -156,7 +402,96 @@ struct TransportPacketHeader
     uint8_t type;         /**< Packet type */
     uint8_t connection_id;/**< Connection identifier */
     uint8_t sequence;     /**< Sequence number */
-    uint8_t length;       /**< Payload length */
+    uint8_t length;       /**< Payload length (low byte in large-frame mode) */
+};
+
+/**
+ * @brief In-flight DATA packet held for retransmission
+ */
+struct TransportTxSlot
+{
+    uint8_t buffer[TRANSPORT_MAX_PACKET_SIZE]; /**< Complete packet (header + payload) */
+    uint16_t length;                           /**< Packet length in bytes */
+    uint32_t first_tx_time;                    /**< Time of the first transmission */
+    uint32_t tx_time;                          /**< Time of the last transmission */
+    uint8_t retries;                           /**< Number of retransmissions */
+    bool acked;                                /**< Selectively acknowledged by the peer */
+};
+
+/**
+ * @brief Out-of-order DATA payload held until the gap before it is filled
+ */
+struct TransportRxSlot
+{
+    uint8_t buffer[TRANSPORT_MAX_PAYLOAD_SIZE]; /**< Payload data */
+    uint16_t length;                            /**< Payload length in bytes */
+    bool fragment;                              /**< More segments of the same message follow */
+    bool valid;                                 /**< Slot holds a received packet */
+};
+
+/**
+ * @brief Statically sized sliding window for one TransportLayer, checked at compile time
+ *
+ * See TransportLayer::set_window(); must outlive the transport using it.
+ *
+ * @tparam SIZE Window depth, a power of two between 1 and 32
+ */
+template <uint8_t SIZE = TRANSPORT_WINDOW_SIZE>
+struct TransportWindowStorage
+{
+    static_assert(TRANSPORT_VALID_WINDOW_SIZE(SIZE), "Transport window size must be a power of two between 1 and 32");
+
+    TransportTxSlot tx[SIZE];
+    TransportRxSlot rx[SIZE];
+};
+
+/**
+ * @brief Keyframe of a delta datagram stream
+ */
+struct TransportDeltaStream
+{
+    uint8_t buffer[TRANSPORT_DELTA_MAX_LENGTH]; /**< Keyframe payload */
+    uint16_t length;                            /**< Keyframe length in bytes */
+    uint8_t key_id;                             /**< Key ID of the keyframe */
+    uint8_t deltas;                             /**< Deltas sent since the keyframe */
+    bool valid;                                 /**< Slot holds a keyframe */
+};
+
+/**
+ * @brief Transport layer counters, see TransportLayer::get_stats()
+ *
+ * Counters start at zero on construction and wrap around; they are not
+ * cleared by reconnections, only by reset_stats().
+ */
+struct TransportLayerStats
+{
+    uint32_t packets_tx;           /**< DATA and DATA_FRAGMENT packets sent for the first time */
+    uint32_t packets_rx;           /**< DATA and DATA_FRAGMENT packets accepted, in order or buffered */
+    uint32_t bytes_tx;             /**< Payload bytes in packets_tx */
+    uint32_t bytes_rx;             /**< Payload bytes in packets_rx */
+    uint32_t datagrams_tx;         /**< Datagrams sent */
+    uint32_t datagrams_rx;         /**< Datagrams received */
+    uint32_t datagram_batches_tx;  /**< DATAGRAM_BATCH packets sent */
+    uint32_t datagram_batches_rx;  /**< DATAGRAM_BATCH packets received */
+    uint32_t delta_keyframes_tx;   /**< Delta stream datagrams sent as keyframes */
+    uint32_t deltas_tx;            /**< Delta stream datagrams sent as differences */
+    uint32_t deltas_dropped;       /**< Differences received without their keyframe */
+    uint32_t retransmits;          /**< Retransmissions after the RTO expired */
+    uint32_t nack_retransmits;     /**< Retransmissions requested by a DATA_NACK */
+    uint32_t nacks_sent;           /**< DATA_NACK packets sent */
+    uint32_t nacks_received;       /**< DATA_NACK packets received */
+    uint32_t data_acks_sent;       /**< DATA_ACK packets sent */
+    uint32_t acks_piggybacked;     /**< Acknowledgments sent on DATA packets instead of a DATA_ACK */
+    uint32_t duplicates_rx;        /**< DATA packets received again after being accepted */
+    uint32_t out_of_order_rx;      /**< DATA packets held back until a gap before them was filled */
+    uint32_t invalid_packets;      /**< Packets dropped for a bad type, length or connection ID */
+    uint32_t keepalive_misses;     /**< Keep-alive probes repeated because the previous one went unanswered */
+    uint32_t keepalive_timeouts;   /**< Connections lost to the keep-alive timeout */
+    uint32_t retry_timeouts;       /**< Connections lost because a DATA packet ran out of retries */
+    uint32_t sessions_suspended;   /**< Timeouts that suspended the session instead of dropping it */
+    uint32_t sessions_resumed;     /**< Suspended sessions that were resumed */
+    StatsHistogram rtt_ms;         /**< Round-trip samples fed to the RTO estimator (Karn's rule) */
+    StatsHistogram ack_latency_ms; /**< Time from the first transmission of a DATA packet to its ACK */
 };
 
 /**
@@ -164,6 +499,8 @@ struct TransportPacketHeader
  *
  * This layer provides reliable end-to-end communication with:
  * - Connection establishment and teardown
+ * - Sliding window (selective repeat) data transfer
+ * - Delayed and piggybacked acknowledgments
  * - Keep-alive mechanism
  * - Connection timeout detection
  * - Packet validation
@@ -171,7 +508,7 @@ struct TransportPacketHeader
  * The transport layer uses the link layer for actual data transmission
  * and adds connection management on top of it.
  */
-class TransportLayer : public Layer
+class TransportLayer final : public Layer
 {
 public:
     // Add callback type for data reception
@@ -195,6 +532,84 @@ public:
     // Data transmission
     virtual int send(const uint8_t *data, uint16_t length);
     virtual int send_datagram(const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief Send one DATA packet whose payload is scattered over several buffers
+     *
+     * Like send(), with the segments gathered straight into the window slot,
+     * e.g. a header struct followed by a sample array.
+     *
+     * @param segments Payload pieces, in order, at most TRANSPORT_MAX_PAYLOAD_SIZE in total
+     * @param count Number of segments
+     * @return TRANSPORT_SUCCESS, or a negative error code
+     */
+    int send_v(const LayerSegment *segments, uint8_t count);
+
+    /**
+     * @brief Send one datagram whose payload is scattered over several buffers
+     *
+     * The segments are gathered straight into the link layer's outgoing queue.
+     *
+     * @param segments Payload pieces, in order, at most TRANSPORT_MAX_PAYLOAD_SIZE in total
+     * @param count Number of segments
+     * @return Non-negative on success, or a negative error code
+     */
+    int send_datagram_v(const LayerSegment *segments, uint8_t count);
+
+#if TRANSPORT_DELTA_STREAMS
+    /**
+     * @brief Send a datagram of a stream as a difference to its keyframe
+     *
+     * For periodic datagrams that change little, such as status records.
+     * The first datagram of a stream is sent in full as its keyframe, later
+     * ones only as the bytes that differ from it. A new keyframe is sent
+     * when the length changes, when the difference would not be shorter, and
+     * after TRANSPORT_DELTA_KEYFRAME_INTERVAL datagrams. The receiver
+     * rebuilds each datagram before passing it on like any other; datagrams
+     * are not acknowledged, so differences arriving after a lost keyframe
+     * are dropped until the next one.
+     *
+     * @param stream Stream ID, below TRANSPORT_DELTA_STREAMS
+     * @param data Datagram payload
+     * @param length Payload length, 1 to TRANSPORT_DELTA_MAX_LENGTH bytes
+     * @return Non-negative on success, or a negative error code
+     */
+    int send_datagram_delta(uint8_t stream, const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief Make the next datagram of every stream a keyframe
+     *
+     * E.g. when a receiver is known to have (re)started.
+     */
+    void reset_delta_streams();
+#endif
+
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    /**
+     * @brief Coalesce small datagrams into one packet
+     *
+     * Datagrams of up to 255 bytes are then collected into a DATAGRAM_BATCH
+     * packet with a one-byte length per item, instead of costing a link
+     * frame (header, CRC, COBS overhead and delimiter) each. The batch is
+     * sent once it holds max_bytes, or max_delay_ms after its first
+     * datagram, from tick(). Larger datagrams are sent at once, after any
+     * pending batch. Datagrams keep their order.
+     *
+     * @param max_bytes Packet size budget of a batch (at most
+     *                  TRANSPORT_MAX_PACKET_SIZE); 0 disables aggregation
+     * @param max_delay_ms Longest time a datagram waits in the batch
+     */
+    void set_datagram_aggregation(uint16_t max_bytes, uint32_t max_delay_ms);
+
+    /**
+     * @brief Send the pending datagram batch now
+     *
+     * @return Non-negative on success or if nothing was pending, or a negative
+     *         error code if the link layer could not take the batch; it is
+     *         then retried from tick()
+     */
+    int flush_datagrams();
+#endif
     virtual int on_receive(const uint8_t *data, uint16_t length);
     virtual uint16_t get_max_payload_size() const
     {
@@ -202,6 +617,231 @@ public:
     }
     virtual void tick();
 
+    /**
+     * @brief Retry what the link layer refused, now that its queue has room
+     *
+     * Acknowledgments, retransmissions and datagram batches that found the
+     * link queue full are then sent on the next tick() instead of after
+     * TRANSPORT_LINK_RETRY_MS. Called from task context, e.g. by RobustStack
+     * once process_outgoing_data() has drained the queue.
+     */
+    void on_link_space();
+
+    /**
+     * @brief Check whether another DATA packet can be sent without waiting for an ACK
+     *
+     * @return true if at least one window slot is free
+     */
+    bool can_send() const
+    {
+        return get_in_flight_count() < window_size_;
+    }
+
+    /**
+     * @brief Provide the sliding window; required before connect() or listen()
+     *
+     * @param tx_window Slots for packets awaiting acknowledgment
+     * @param rx_window Slots for packets received out of order
+     * @param window_size Slots in each, a power of two between 1 and 32. Both
+     *                    peers announce theirs in the handshake and use the
+     *                    smaller one
+     * @return TRANSPORT_SUCCESS, TRANSPORT_ERROR_INVALID_PARAMS, or
+     *         TRANSPORT_ERROR_INVALID_STATE unless disconnected
+     */
+    int set_window(TransportTxSlot *tx_window, TransportRxSlot *rx_window, uint8_t window_size);
+
+    template <uint8_t SIZE>
+    int set_window(TransportWindowStorage<SIZE> &storage)
+    {
+        return set_window(storage.tx, storage.rx, SIZE);
+    }
+
+    /**
+     * @brief Get the window depth in use: that of set_window(), or the peer's if smaller
+     */
+    uint8_t get_window_size() const
+    {
+        return window_size_;
+    }
+
+    /**
+     * @brief Send a message of any length
+     *
+     * The message is split into TRANSPORT_MAX_PAYLOAD_SIZE segments that are
+     * pipelined through the send window as acknowledgments free up slots.
+     * Segments are copied into the window one by one, so the buffer must stay
+     * valid until TRANSPORT_LAYER_EVENT_MESSAGE_SENT is reported. While a
+     * message is in progress, send() and send_message() return
+     * TRANSPORT_ERROR_BUSY.
+     *
+     * @param data Message to send
+     * @param length Message length in bytes
+     * @return TRANSPORT_SUCCESS if the message was accepted, or a negative error code
+     */
+    int send_message(const uint8_t *data, uint32_t length);
+
+    /**
+     * @brief Check whether a segmented message is still being sent
+     */
+    bool is_message_pending() const
+    {
+        return tx_message_ != NULL;
+    }
+
+    /**
+     * @brief Set the buffer that segmented messages are reassembled into
+     *
+     * A reassembled message is passed to the stack manager's on_message()
+     * from this buffer and stays there until the next one starts. Messages
+     * larger than the buffer, or any segmented message while no buffer is set,
+     * are dropped. Single-packet messages do not use the buffer.
+     *
+     * @param buffer Reassembly buffer, or NULL
+     * @param size Size of the buffer in bytes
+     */
+    void set_rx_message_buffer(uint8_t *buffer, uint32_t size);
+
+    /**
+     * @brief Set the timer wheel that runs this transport's timers
+     *
+     * Keep-alive, delayed acknowledgment, retransmission, handshake and
+     * datagram batch timeouts are timers on the wheel; tick() advances it.
+     * Several transports may share one wheel, as those of a RobustStack do,
+     * so that their timers cost no more than the ones that actually expire.
+     * Must be set before connect() or listen(), and only while disconnected.
+     *
+     * @param timers Timer wheel, must outlive the transport
+     */
+    void set_timer_wheel(TimerWheel *timers)
+    {
+        timers_ = timers;
+    }
+
+    /**
+     * @brief Get the time until tick() has work to do
+     *
+     * The next expiry on the timer wheel, or TRANSPORT_LINK_RETRY_MS if a
+     * message segment waits for the link layer. Calling tick() earlier is
+     * harmless; calling it later delays the corresponding action.
+     *
+     * @return Milliseconds until the next timer expires (0 if one is already
+     *         due), or TRANSPORT_NO_DEADLINE if none is running
+     */
+    uint32_t get_next_deadline() const;
+
+    /**
+     * @brief Get the current retransmission timeout
+     *
+     * @return RTO in milliseconds, including any exponential backoff
+     */
+    uint32_t get_retransmission_timeout() const
+    {
+        return retry_timeout_;
+    }
+
+    /**
+     * @brief Copy the current counters and histograms
+     */
+    void get_stats(TransportLayerStats &stats) const
+    {
+        stats = stats_;
+    }
+
+    /**
+     * @brief Set all counters back to zero and empty the histograms
+     */
+    void reset_stats();
+
+    /**
+     * @brief Use a fixed connection ID instead of one assigned by the listener
+     *
+     * On a shared bus every connection needs an ID known in advance so that
+     * each node only answers its own packets. With a fixed ID, connect()
+     * requests that ID in its SYN, and listen() only accepts a SYN asking for
+     * it; both peers must configure the same value. The default,
+     * TRANSPORT_CONNECTION_ID_INVALID, keeps the listener-assigned IDs of a
+     * point-to-point link.
+     *
+     * @param connection_id Fixed connection ID, or TRANSPORT_CONNECTION_ID_INVALID
+     */
+    void set_connection_id(uint8_t connection_id)
+    {
+        fixed_connection_id_ = connection_id;
+    }
+
+    /**
+     * @brief Get the fixed connection ID, TRANSPORT_CONNECTION_ID_INVALID if none
+     */
+    uint8_t get_fixed_connection_id() const
+    {
+        return fixed_connection_id_;
+    }
+
+    /**
+     * @brief Set the handshake options this side supports
+     *
+     * The options are offered in the SYN, or matched against the peer's offer
+     * before answering with the SYN-ACK; get_options() then returns what
+     * both sides support. Peers that know no options take part as if they
+     * had offered none.
+     *
+     * With TRANSPORT_OPTION_RESUME agreed, a keep-alive or retransmission
+     * timeout suspends the connection instead of dropping it: the state
+     * becomes TRANSPORT_STATE_RESUMING, TRANSPORT_LAYER_EVENT_SUSPENDED is
+     * reported, and the sequence numbers, both windows and any message
+     * being segmented are kept. RESUME packets carrying the session token
+     * then try to reach the peer every keep-alive interval. Once it answers,
+     * the connection continues with TRANSPORT_LAYER_EVENT_RESUMED and the
+     * packets it had not acknowledged are sent again. After
+     * TRANSPORT_RESUME_ATTEMPTS unanswered packets the connection is dropped
+     * with TRANSPORT_LAYER_EVENT_TIMEOUT, as without the option.
+     *
+     * @param options Bitwise OR of TRANSPORT_OPTION_* values
+     */
+    void set_options(uint8_t options)
+    {
+        local_options_ = options & ~TRANSPORT_OPTION_WINDOW_MASK; // The window is announced by itself
+    }
+
+    /**
+     * @brief Get the options this side offers, see set_options()
+     */
+    uint8_t get_local_options() const
+    {
+        return local_options_;
+    }
+
+    /**
+     * @brief Get the options negotiated for the current connection
+     *
+     * @return Bitwise OR of TRANSPORT_OPTION_* values, 0 before a handshake
+     */
+    uint8_t get_options() const
+    {
+        return options_;
+    }
+
+    /**
+     * @brief Get the ID of the current connection, TRANSPORT_CONNECTION_ID_INVALID if none
+     */
+    uint8_t get_connection_id() const
+    {
+        return connection_id_;
+    }
+
+    /**
+     * @brief Set the channel number passed to the stack manager with received data
+     */
+    void set_channel(uint8_t channel)
+    {
+        channel_ = channel;
+    }
+
+    uint8_t get_channel() const
+    {
+        return channel_;
+    }
+
     // State management
     void set_timeout(uint32_t keepalive_ms, uint32_t timeout_ms);
 
@@ -219,48 +859,163 @@ private:
     TransportState state_;
     uint8_t connect_retries_;
     uint32_t last_keepalive_ack_time_;
+    uint32_t last_keepalive_tx_time_;
+    bool keepalive_pending_; // A keep-alive probe is awaiting its ACK
     uint8_t sequence_number_;
     uint8_t peer_sequence_number_;
-    bool awaiting_ack_;
     uint32_t last_tx_time_;
-    uint8_t retry_count_;
     bool waiting_response_;
-    uint32_t last_tick_time_;
     uint8_t connection_id_;
+    uint8_t fixed_connection_id_; // Configured connection ID, INVALID if assigned by the listener
+    uint8_t channel_;             // Index of this connection in the stack manager
+    uint8_t local_options_;       // TRANSPORT_OPTION_* offered in the handshake
+    uint8_t options_;             // TRANSPORT_OPTION_* agreed with the peer
+    uint32_t session_token_;      // Identifies the session with TRANSPORT_OPTION_RESUME
+    uint8_t resume_attempts_;     // RESUME packets sent since the session was suspended
 
     // Transport layer packet buffers (will be encapsulated as link layer payload)
-    uint8_t tx_buffer_[TRANSPORT_MAX_PACKET_SIZE];      // Buffer for outgoing transport packets
-    uint8_t last_tx_buffer_[TRANSPORT_MAX_PACKET_SIZE]; // Buffer for last transmitted packet
-    uint16_t last_tx_length_;                           // Length of last transmitted packet
+    uint8_t tx_buffer_[TRANSPORT_MAX_PACKET_SIZE]; // Staging buffer when the link layer cannot reserve
+
+    // Sliding window state. Slots are indexed by sequence number modulo
+    // window_size_; the rest of the storage is unused.
+    TransportTxSlot *tx_window_; // Packets awaiting acknowledgment
+    TransportRxSlot *rx_window_; // Packets received out of order
+    uint8_t window_size_;        // Slots in use, agreed with the peer
+    uint8_t window_capacity_;    // Slots given to set_window(), 0 until then
+    uint8_t delayed_ack_packets_; // In-order packets acknowledged at once
+    uint8_t send_base_;          // Oldest unacknowledged sequence number
+    bool nack_sent_;             // NACK already sent for peer_sequence_number_
+
+    // Delayed acknowledgment of in-order DATA packets
+    bool ack_pending_;         // Received packets are not yet acknowledged
+    uint8_t ack_pending_count_; // Number of those packets
+    uint32_t ack_pending_time_; // Arrival of the first of them
 
     // Timing parameters
     uint32_t keepalive_interval_;
     uint32_t connection_timeout_;
-    uint32_t retry_timeout_;
-    uint32_t max_retries_;
+    uint32_t retry_timeout_; // Current retransmission timeout (RTO) in ms, including backoff
+    uint32_t max_retries_;   // Retransmissions of one DATA packet before giving up
+
+    // Round-trip time estimator (Jacobson/Karels fixed point)
+    uint32_t srtt_;   // Smoothed RTT in ms, scaled by 8
+    uint32_t rttvar_; // RTT variance in ms, scaled by 4
+    bool rtt_valid_;  // At least one RTT sample was taken
+
+    // Segmentation and reassembly
+    const uint8_t *tx_message_;   // Message being segmented, NULL if none
+    uint32_t tx_message_length_;  // Total length of tx_message_
+    uint32_t tx_message_offset_;  // Bytes of tx_message_ already in the window
+    uint8_t *rx_message_buffer_;  // Reassembly buffer set by the application
+    uint32_t rx_message_size_;    // Size of rx_message_buffer_
+    uint32_t rx_message_length_;  // Bytes reassembled so far
+    bool rx_message_dropped_;     // Current message did not fit and is being discarded
+
+    TransportLayerStats stats_;
+
+    // Timers, see set_timer_wheel(). Each handler re-checks its condition,
+    // so a timer that expires early only re-arms itself.
+    TimerWheel *timers_;
+    Timer keepalive_timer_;  // Next keep-alive probe or timeout
+    Timer ack_timer_;        // Delayed acknowledgment
+    Timer retransmit_timer_; // Oldest unacknowledged DATA packet
+    Timer response_timer_;   // Handshake or disconnection answer
+    bool link_blocked_;      // A timer waits for the link queue, see on_link_space()
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    Timer batch_timer_;      // Latency budget of the datagram batch
+#endif
+
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    // Datagram aggregation: [DATAGRAM_BATCH(1) | LENGTH(1) | DATA(n) | ...]
+    uint8_t batch_buffer_[TRANSPORT_MAX_PACKET_SIZE];
+    uint16_t batch_length_;      // Bytes in batch_buffer_, 0 if no batch is open
+    uint8_t batch_count_;        // Datagrams in the batch
+    uint32_t batch_time_;        // Time the first datagram entered the batch
+    uint16_t batch_max_bytes_;   // Size budget, 0 if aggregation is disabled
+    uint32_t batch_max_delay_;   // Latency budget in ms
+#endif
+
+#if TRANSPORT_DELTA_STREAMS
+    // Delta datagram streams, indexed by stream ID
+    TransportDeltaStream delta_tx_[TRANSPORT_DELTA_STREAMS]; // Keyframes sent
+    TransportDeltaStream delta_rx_[TRANSPORT_DELTA_STREAMS]; // Keyframes received
+    uint8_t delta_buffer_[TRANSPORT_DELTA_MAX_LENGTH];       // Datagram rebuilt from a delta
+#endif
 
     // Internal methods for data processing
     int handle_data_packet(const uint8_t *data, uint16_t length);
     int handle_keepalive_packet(uint8_t connection_id);
     int handle_keepalive_ack_packet(uint8_t connection_id);
     int handle_datagram_packet(const uint8_t *data, uint16_t length);
-    void handle_data_ack_packet(uint8_t connection_id, uint8_t sequence_number);
+    int handle_datagram_batch_packet(const uint8_t *data, uint16_t length);
+    int handle_datagram_delta_packet(const uint8_t *data, uint16_t length);
+    int send_datagram_packet(const LayerSegment *segments, uint8_t count, uint16_t length);
+    void handle_data_ack_packet(const uint8_t *data, uint16_t length);
+    void handle_ack_number(uint8_t sequence_number, uint32_t bitmap);
     void handle_data_nack_packet(uint8_t connection_id, uint8_t sequence_number);
+    int send_packet(uint8_t type, uint8_t connection_id, uint8_t sequence, const uint8_t *payload,
+                    uint8_t length);
     void send_syn();
     void send_syn_ack();
     void send_ack(uint8_t connection_id, uint8_t sequence_number);
     void send_fin();
     void send_fin_ack();
-    void send_data_ack(uint8_t connection_id, uint8_t sequence_number);
+    void send_data_ack(uint8_t connection_id);
+    void schedule_data_ack();
     void send_data_nack(uint8_t connection_id, uint8_t sequence_number);
     void send_keepalive();
+    void send_resume(uint8_t type);
+    void suspend_session();
+    void resume_session(uint8_t next_sequence);
+    void connection_lost();
 
-    void handle_syn_packet(uint8_t connection_id, uint8_t sequence_number);
-    void handle_syn_ack_packet(uint8_t connection_id, uint8_t sequence_number);
+    void handle_syn_packet(uint8_t connection_id, uint8_t sequence_number, uint8_t options);
+    void handle_syn_ack_packet(uint8_t connection_id, uint8_t sequence_number, uint8_t options,
+                               uint32_t token);
+    void handle_resume_packet(uint8_t type, uint8_t connection_id, uint8_t next_sequence,
+                              uint32_t token);
     void handle_ack_packet(uint8_t connection_id, uint8_t sequence_number);
     void handle_fin_packet(uint8_t connection_id);
     void handle_fin_ack_packet(uint8_t connection_id);
     void reset();
+    void reset_window();
+    void use_window(uint8_t peer_options);
+
+    // Sliding window helpers
+    uint8_t get_in_flight_count() const
+    {
+        return static_cast<uint8_t>(sequence_number_ - send_base_);
+    }
+    void deliver_in_order_packets();
+    void retry_held_packets();
+    bool has_held_packet() const;
+    bool deliver_payload(bool fragment, const uint8_t *payload, uint16_t length);
+    int send_data_segment(uint8_t type, const uint8_t *data, uint16_t length);
+    int send_data_segment(uint8_t type, const LayerSegment *segments, uint8_t count, uint16_t length);
+    int transmit_slot(const TransportTxSlot &slot);
+    void pump_message();
+    void advance_send_base();
+    void mark_acked(TransportTxSlot &slot, uint32_t current_time);
+
+    // Retransmission engine
+    void update_rtt(uint32_t rtt_ms);
+    void update_rto();
+    void reset_rtt();
+    void check_retransmissions(uint32_t current_time);
+
+    // Timer handlers and arming
+    static void on_keepalive_timer(void *context);
+    static void on_ack_timer(void *context);
+    static void on_retransmit_timer(void *context);
+    static void on_response_timer(void *context);
+    void start_timer(Timer &timer, uint32_t expiry);
+    void stop_timers();
+    void arm_keepalive_timer();
+    void arm_retransmit_timer();
+    void arm_response_timer();
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    static void on_batch_timer(void *context);
+#endif
 };
 
 } // namespace robust_serial
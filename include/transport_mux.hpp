@@ -0,0 +1,147 @@
+#ifndef __TRANSPORT_MUX_HPP__
+#define __TRANSPORT_MUX_HPP__
+
+#include "layer.hpp"
+#include "link_layer.hpp"
+#include "transport_layer.hpp"
+
+/**
+ * @brief Number of transport connections multiplexed over one link
+ *
+ * Each connection costs one TransportLayer (two send/receive windows). With
+ * a single connection the stack behaves like a point-to-point link.
+ */
+#ifndef TRANSPORT_MAX_CONNECTIONS
+#define TRANSPORT_MAX_CONNECTIONS 1
+#endif
+
+#if (TRANSPORT_MAX_CONNECTIONS < 1) || (TRANSPORT_MAX_CONNECTIONS > 254)
+#error "TRANSPORT_MAX_CONNECTIONS must be between 1 and 254"
+#endif
+
+namespace robust_serial
+{
+
+/**
+ * @brief Connection multiplexer between the link layer and several transports
+ *
+ * The multiplexer is the link layer's upper layer and the lower layer of
+ * every registered TransportLayer. Each transport keeps its own connection
+ * state, sequence numbers and windows.
+ *
+ * Incoming packets are routed by the connection ID in their header: to the
+ * transport with that fixed connection ID, otherwise to the first transport
+ * without a fixed ID (which accepts listener-assigned IDs). Packets for a
+ * connection nobody owns, e.g. traffic for other nodes on a multi-drop bus,
+ * are dropped. Datagrams carry no connection ID and go to the first
+ * transport.
+ *
+ * Outgoing packets share the link layer's queues. While more than one
+ * connection has DATA to send, each may only queue its fair share of the
+ * bulk queue per round (a round ends when that queue drains), so a
+ * connection with a deep backlog or a storm of retransmissions to a slow
+ * peer cannot starve the others. Control packets (ACKs, keep-alives,
+ * handshakes) and datagrams are never held back. tick() serves the
+ * transports round-robin.
+ */
+class TransportMux final : public Layer
+{
+public:
+    TransportMux();
+    virtual ~TransportMux();
+
+    virtual void initialize();
+    virtual void deinitialize();
+
+    using Layer::set_down_layer;
+
+    /**
+     * @brief Connect to the link layer below
+     *
+     * @param layer Pointer to the link layer
+     * @return LAYER_SUCCESS on success, error code on failure
+     */
+    int set_down_layer(LinkLayer *layer);
+
+    /**
+     * @brief Connect to a layer stacked on the link layer, e.g. CompressionLayer
+     *
+     * Packets go through the given layer; the fair share still follows the
+     * queues of the link layer underneath.
+     *
+     * @param layer Pointer to the layer below
+     * @param link_layer Pointer to the link layer at the bottom of it
+     * @return LAYER_SUCCESS on success, error code on failure
+     */
+    int set_down_layer(Layer *layer, LinkLayer *link_layer);
+
+    /**
+     * @brief Register a transport as the next channel
+     *
+     * Sets the transport's channel number and makes the multiplexer its
+     * lower layer.
+     *
+     * @param transport Transport to register
+     * @return Channel number, or LAYER_ERROR_INVALID_PARAM if the table is full
+     */
+    int attach(TransportLayer *transport);
+
+    virtual int send(const uint8_t *data, uint16_t length);
+    virtual int send(const uint8_t *data, uint16_t length, uint8_t priority);
+    virtual uint8_t *reserve(uint16_t length);
+    virtual uint8_t *reserve(uint16_t length, uint8_t priority);
+    virtual int commit(uint16_t length);
+    virtual int on_receive(const uint8_t *data, uint16_t length);
+    virtual uint16_t get_max_payload_size() const
+    {
+        return down_layer ? down_layer->get_max_payload_size() : 0;
+    }
+
+    /**
+     * @brief Run tick() of every transport, starting one further each call
+     */
+    void tick();
+
+    /**
+     * @brief Pass TransportLayer::on_link_space() on to every transport
+     */
+    void on_link_space();
+
+    /**
+     * @brief Get the earliest deadline of all transports
+     *
+     * @return Milliseconds until the next timer expires, or TRANSPORT_NO_DEADLINE
+     */
+    uint32_t get_next_deadline() const;
+
+private:
+    /**
+     * @brief Find the channel that owns a connection ID
+     *
+     * @return Channel number, or -1 if no transport owns the ID
+     */
+    int find_channel(uint8_t connection_id) const;
+
+    /**
+     * @brief Apply the fair share rule to a DATA packet of a channel
+     */
+    bool may_queue(uint8_t channel, uint16_t length);
+
+    LinkLayer *link_layer_; // Typed alias of down_layer for queue state
+
+    TransportLayer *transports_[TRANSPORT_MAX_CONNECTIONS];
+    uint8_t channel_count_;
+    uint8_t next_tick_channel_; // Channel served first by the next tick()
+
+    // Fair sharing of the link layer's outgoing queue, reset whenever it drains
+    uint32_t queued_bytes_[TRANSPORT_MAX_CONNECTIONS]; // DATA bytes queued this round
+    bool waiting_[TRANSPORT_MAX_CONNECTIONS];          // DATA was refused this round
+
+    // Prevent copy and assignment
+    TransportMux(const TransportMux &);
+    TransportMux &operator=(const TransportMux &);
+};
+
+} // namespace robust_serial
+
+#endif // __TRANSPORT_MUX_HPP__
@@ -0,0 +1,34 @@
+#include "crc16.hpp"
+
+#if CRC16_BACKEND == CRC16_BACKEND_HARDWARE
+#include "main.h" // STM32Cube device header (CRC register definitions)
+
+namespace robust_serial {
+
+/**
+ * @brief CRC-16-CCITT on the STM32 CRC unit
+ *
+ * For STM32 families with a programmable CRC polynomial (F0, F3, F7, G0, G4,
+ * L0, L4, H7, ...). The CRC peripheral clock must be enabled by the
+ * application. The unit is fully reprogrammed on every call, but a call must
+ * not be interrupted by another user of the peripheral.
+ */
+uint16_t crc16_hardware_update(uint16_t crc, const uint8_t *data, uint16_t length)
+{
+    // 16-bit polynomial, no input/output bit reversal, start from crc
+    CRC->POL = CRC16::CRC_POLYNOMIAL;
+    CRC->INIT = crc;
+    CRC->CR = CRC_CR_POLYSIZE_0 | CRC_CR_RESET;
+
+    // Byte accesses feed the unit 8 bits at a time
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        *reinterpret_cast<__IO uint8_t *>(&CRC->DR) = data[i];
+    }
+
+    return static_cast<uint16_t>(CRC->DR);
+}
+
+} // namespace robust_serial
+
+#endif // CRC16_BACKEND == CRC16_BACKEND_HARDWARE
@@ -0,0 +1,211 @@
+#include "posix_gateway.hpp"
+#include "system_utils.hpp"
+#include "log.hpp"
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace robust_serial
+{
+
+PosixGateway::PosixGateway()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+    , port_count_(0)
+    , round_(0)
+{
+    if (epoll_fd_ < 0)
+    {
+        log_error("PosixGateway: Cannot create epoll instance (errno %d)", errno);
+    }
+}
+
+/**
+ * @brief Destructor for PosixGateway; the ttys stay open.
+ */
+PosixGateway::~PosixGateway()
+{
+    if (epoll_fd_ >= 0)
+    {
+        close(epoll_fd_);
+    }
+}
+
+int PosixGateway::add(RobustStack &stack, PosixTtyPhysicalLayer &tty)
+{
+    if (tty.get_fd() < 0 || port_count_ >= POSIX_GATEWAY_MAX_PORTS)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    Port &port = ports_[port_count_];
+    port.stack = &stack;
+    port.tty = &tty;
+    port.gateway = this;
+    port.deadline_ms = 0;
+    port.round = round_;
+    port.has_deadline = false;
+    port.pending = true;
+    port.watching_output = false;
+    port.failed = false;
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &port;
+    if (epoll_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, tty.get_fd(), &event) != 0)
+    {
+        log_error("PosixGateway: Cannot watch descriptor %d (errno %d)", tty.get_fd(), errno);
+        return PHYSICAL_ERROR_HW_FAIL;
+    }
+
+    stack.set_notify_callback(on_notify, &port);
+    return port_count_++;
+}
+
+int PosixGateway::run_once(int max_wait_ms)
+{
+    epoll_event events[POSIX_GATEWAY_MAX_PORTS];
+    round_++;
+
+    int ready = epoll_wait(epoll_fd_, events, POSIX_GATEWAY_MAX_PORTS,
+                           wait_time(get_current_time_ms(), max_wait_ms));
+    if (ready < 0)
+    {
+        if (errno != EINTR)
+        {
+            log_error("PosixGateway: epoll_wait failed (errno %d)", errno);
+            return PHYSICAL_ERROR_HW_FAIL;
+        }
+        ready = 0;
+    }
+
+    // Ports with I/O first, then those whose timer is due or that have
+    // data queued; each is serviced at most once per round
+    uint32_t now_ms = get_current_time_ms();
+    int serviced = 0;
+    for (int i = 0; i < ready; i++)
+    {
+        Port &port = *static_cast<Port *>(events[i].data.ptr);
+        service(port, now_ms, (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0);
+        serviced++;
+    }
+
+    for (uint8_t i = 0; i < port_count_; i++)
+    {
+        Port &port = ports_[i];
+        if (port.round != round_ &&
+            (port.pending || (port.has_deadline && static_cast<int32_t>(now_ms - port.deadline_ms) >= 0)))
+        {
+            service(port, now_ms, false);
+            serviced++;
+        }
+    }
+
+    return serviced;
+}
+
+/**
+ * @brief Reads what has arrived, runs the stack and records its next deadline
+ */
+void PosixGateway::service(Port &port, uint32_t now_ms, bool readable)
+{
+    RobustStack &stack = *port.stack;
+    port.round = round_;
+
+    // Straight into the incoming queue; a full queue is processed first and
+    // the rest read on the next round, as epoll keeps reporting the port
+    while (readable && !port.failed)
+    {
+        uint16_t length = 0;
+        uint8_t *span = stack.incoming_write_span(length);
+        if (length == 0)
+        {
+            break;
+        }
+
+        int received = port.tty->read(span, length);
+        if (received < 0)
+        {
+            log_warning("PosixGateway: Port %d failed, removing it from the loop",
+                        static_cast<int>(&port - ports_));
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, port.tty->get_fd(), NULL);
+            port.failed = true;
+            break;
+        }
+        if (received > 0)
+        {
+            stack.incoming_commit(static_cast<uint16_t>(received));
+        }
+        if (received < length)
+        {
+            break;
+        }
+    }
+
+    stack.process_incoming_data();
+    stack.tick();
+    stack.process_outgoing_data();
+    port.pending = false;
+
+    if (!port.failed && port.tty->is_write_blocked() != port.watching_output)
+    {
+        watch(port, port.tty->is_write_blocked());
+    }
+
+    uint32_t wait = stack.get_next_deadline();
+    port.has_deadline = (wait != TRANSPORT_NO_DEADLINE);
+    port.deadline_ms = now_ms + wait;
+    if (wait == 0)
+    {
+        port.pending = true;
+    }
+}
+
+void PosixGateway::watch(Port &port, bool output)
+{
+    epoll_event event;
+    event.events = output ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.ptr = &port;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, port.tty->get_fd(), &event) == 0)
+    {
+        port.watching_output = output;
+    }
+}
+
+/**
+ * @brief Milliseconds epoll may wait: until the earliest deadline, or not at all
+ */
+int PosixGateway::wait_time(uint32_t now_ms, int max_wait_ms) const
+{
+    int wait = max_wait_ms;
+    for (uint8_t i = 0; i < port_count_; i++)
+    {
+        const Port &port = ports_[i];
+        if (port.pending)
+        {
+            return 0;
+        }
+        if (port.has_deadline)
+        {
+            int32_t remaining = static_cast<int32_t>(port.deadline_ms - now_ms);
+            if (remaining < 0)
+            {
+                remaining = 0;
+            }
+            if (wait < 0 || remaining < wait)
+            {
+                wait = remaining;
+            }
+        }
+    }
+    return wait;
+}
+
+/**
+ * @brief Notify callback of every stack: data was queued outside the loop's view
+ */
+void PosixGateway::on_notify(void *context)
+{
+    static_cast<Port *>(context)->pending = true;
+}
+
+} // namespace robust_serial
@@ -0,0 +1,123 @@
+#ifndef __POSIX_GATEWAY_HPP__
+#define __POSIX_GATEWAY_HPP__
+
+#include "robust_stack.hpp"
+#include "posix_tty_physical_layer.hpp"
+
+/**
+ * @brief Stacks one PosixGateway can drive
+ */
+#ifndef POSIX_GATEWAY_MAX_PORTS
+#define POSIX_GATEWAY_MAX_PORTS 64
+#endif
+
+static_assert(POSIX_GATEWAY_MAX_PORTS > 0 && POSIX_GATEWAY_MAX_PORTS <= 255,
+              "Gateway ports are indexed with 8 bits");
+
+namespace robust_serial
+{
+
+/**
+ * @brief Event loop that drives many RobustStacks on POSIX ttys from one thread (Linux)
+ *
+ * Instead of one thread per serial link calling tick() and process_*() at a
+ * fixed rate, a gateway waits in epoll for any of its ports to become
+ * readable or writable, or for the earliest transport timer of its stacks,
+ * and then services only the stacks that have something to do:
+ *
+ * - Readable: the bytes that have arrived are read straight into the link
+ *   layer's incoming queue, as many as fit, and processed at once.
+ * - Writable: only watched while a stack has frames the tty did not take,
+ *   so a saturated port wakes the loop when there is room again.
+ * - Timers: each stack's get_next_deadline() is kept as an absolute time;
+ *   stacks without a due timer are not touched.
+ * - Data queued by the application, from within a callback or between calls,
+ *   is flushed in the same run_once(): the gateway sets each stack's notify
+ *   callback for that.
+ *
+ * A stack belongs to exactly one gateway and must only be used from the
+ * thread that runs it. To spread the links over several cores, run one
+ * gateway per thread, each with its own share of the ports; nothing is shared
+ * between them, so no locks are needed.
+ *
+ *   PosixGateway gateway;
+ *   for (int i = 0; i < ports; i++)
+ *   {
+ *       tty[i].open(paths[i], 921600);
+ *       stack[i].initialize();
+ *       stack[i].listen();
+ *       gateway.add(stack[i], tty[i]);
+ *   }
+ *   for (;;)
+ *   {
+ *       gateway.run_once(-1);
+ *   }
+ *
+ * Nothing is allocated after construction.
+ */
+class PosixGateway
+{
+public:
+    PosixGateway();
+    ~PosixGateway();
+
+    /**
+     * @brief Drive a stack whose physical layer is an open tty
+     *
+     * Takes over the stack's notify callback.
+     *
+     * @return Index of the port, LAYER_ERROR_INVALID_PARAM if the tty is not
+     *         open or all POSIX_GATEWAY_MAX_PORTS are in use,
+     *         PHYSICAL_ERROR_HW_FAIL if epoll refuses the descriptor
+     */
+    int add(RobustStack &stack, PosixTtyPhysicalLayer &tty);
+
+    /**
+     * @brief Wait for the next event or timer and service the stacks concerned
+     *
+     * @param max_wait_ms Longest wait in milliseconds, -1 to wait until
+     *        something happens
+     * @return Number of stacks serviced, PHYSICAL_ERROR_HW_FAIL if epoll failed
+     */
+    int run_once(int max_wait_ms);
+
+    /**
+     * @brief Number of stacks added
+     */
+    uint8_t get_port_count() const
+    {
+        return port_count_;
+    }
+
+private:
+    struct Port
+    {
+        RobustStack *stack;
+        PosixTtyPhysicalLayer *tty;
+        PosixGateway *gateway;
+        uint32_t deadline_ms; // When the stack's next timer expires, if has_deadline
+        uint32_t round;       // Last run_once() that serviced the port
+        bool has_deadline;
+        bool pending;         // Service without waiting: queued data or bytes left
+        bool watching_output; // EPOLLOUT is armed
+        bool failed;          // The tty failed and was removed from epoll
+    };
+
+    static void on_notify(void *context);
+    void service(Port &port, uint32_t now_ms, bool readable);
+    void watch(Port &port, bool output);
+    int wait_time(uint32_t now_ms, int max_wait_ms) const;
+
+    int epoll_fd_;
+    Port ports_[POSIX_GATEWAY_MAX_PORTS];
+    uint8_t port_count_;
+    uint32_t round_;
+
+    // Prevent copy and assignment
+    PosixGateway(const PosixGateway &);
+    PosixGateway &operator=(const PosixGateway &);
+};
+
+} // namespace robust_serial
+
+#endif // __POSIX_GATEWAY_HPP__
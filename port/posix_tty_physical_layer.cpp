@@ -0,0 +1,223 @@
+#include "posix_tty_physical_layer.hpp"
+#include "log.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h> // For writev()
+#include <termios.h>
+#include <unistd.h>
+
+namespace robust_serial
+{
+
+// Rates termios can set, standard or Linux extensions
+struct BaudRate
+{
+    uint32_t rate;
+    speed_t speed;
+};
+
+static const BaudRate BAUD_RATES[] = {
+    {1200, B1200},       {2400, B2400},       {4800, B4800},       {9600, B9600},
+    {19200, B19200},     {38400, B38400},     {57600, B57600},     {115200, B115200},
+    {230400, B230400},
+#ifdef B460800
+    {460800, B460800},   {500000, B500000},   {576000, B576000},   {921600, B921600},
+    {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+    {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000},
+#endif
+};
+
+static bool find_speed(uint32_t rate, speed_t &speed)
+{
+    for (unsigned i = 0; i < sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]); i++)
+    {
+        if (BAUD_RATES[i].rate == rate)
+        {
+            speed = BAUD_RATES[i].speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+PosixTtyPhysicalLayer::PosixTtyPhysicalLayer()
+    : PhysicalLayer()
+    , fd_(-1)
+    , write_blocked_(false)
+{
+}
+
+/**
+ * @brief Destructor for PosixTtyPhysicalLayer, closes the device.
+ */
+PosixTtyPhysicalLayer::~PosixTtyPhysicalLayer()
+{
+    close();
+}
+
+int PosixTtyPhysicalLayer::open(const char *path, uint32_t baud_rate)
+{
+    speed_t speed;
+    if (!path || !find_speed(baud_rate, speed))
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+
+    close();
+    fd_ = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0)
+    {
+        log_error("PosixTtyPhysicalLayer: Cannot open the device (errno %d)", errno);
+        return PHYSICAL_ERROR_HW_FAIL;
+    }
+
+    termios tty;
+    if (tcgetattr(fd_, &tty) != 0)
+    {
+        log_error("PosixTtyPhysicalLayer: Descriptor %d is not a tty (errno %d)", fd_, errno);
+        close();
+        return PHYSICAL_ERROR_HW_FAIL;
+    }
+
+    // 8N1, receiver on, no modem control, no flow control, no line discipline
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+    // With O_NONBLOCK reads never wait; VMIN 1 makes an empty read fail with
+    // EAGAIN, so that a read of 0 bytes means the device has hung up
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    if (tcsetattr(fd_, TCSANOW, &tty) != 0)
+    {
+        log_error("PosixTtyPhysicalLayer: Cannot configure descriptor %d (errno %d)", fd_, errno);
+        close();
+        return PHYSICAL_ERROR_HW_FAIL;
+    }
+
+    // Whatever arrived before the port was set up is noise
+    tcflush(fd_, TCIOFLUSH);
+    write_blocked_ = false;
+    return PHYSICAL_SUCCESS;
+}
+
+void PosixTtyPhysicalLayer::close()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    state_ = PHYSICAL_STATE_INIT;
+}
+
+void PosixTtyPhysicalLayer::initialize()
+{
+    write_blocked_ = false;
+    state_ = (fd_ >= 0) ? PHYSICAL_STATE_READY : PHYSICAL_STATE_ERROR;
+    report_event((fd_ >= 0) ? PHYSICAL_LAYER_EVENT_READY : PHYSICAL_LAYER_EVENT_ERROR);
+}
+
+void PosixTtyPhysicalLayer::deinitialize()
+{
+    state_ = PHYSICAL_STATE_INIT;
+}
+
+int PosixTtyPhysicalLayer::send(const uint8_t *data, uint16_t length)
+{
+    if (fd_ < 0)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    if (!data)
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+
+    return write_result(::write(fd_, data, length), length);
+}
+
+int PosixTtyPhysicalLayer::send_spans(const uint8_t *first, uint16_t first_length, const uint8_t *second,
+                                      uint16_t second_length)
+{
+    if (fd_ < 0)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    if (!first || (second_length > 0 && !second))
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+
+    iovec spans[2];
+    spans[0].iov_base = const_cast<uint8_t *>(first);
+    spans[0].iov_len = first_length;
+    spans[1].iov_base = const_cast<uint8_t *>(second);
+    spans[1].iov_len = second_length;
+    return write_result(::writev(fd_, spans, second_length ? 2 : 1),
+                        static_cast<uint32_t>(first_length) + second_length);
+}
+
+/**
+ * @brief Turns the result of write() or writev() into bytes sent and the blocked flag
+ */
+int PosixTtyPhysicalLayer::write_result(long written, uint32_t length)
+{
+    if (written < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            return fail();
+        }
+        written = 0;
+    }
+
+    write_blocked_ = (static_cast<uint32_t>(written) < length);
+    return static_cast<int>(written);
+}
+
+int PosixTtyPhysicalLayer::read(uint8_t *buffer, uint16_t length)
+{
+    if (fd_ < 0)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    if (!buffer)
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+
+    ssize_t received = ::read(fd_, buffer, length);
+    if (received > 0)
+    {
+        return static_cast<int>(received);
+    }
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return 0;
+    }
+
+    // 0 bytes from a readable tty: the device has gone, e.g. unplugged
+    return (length > 0) ? fail() : 0;
+}
+
+int PosixTtyPhysicalLayer::fail()
+{
+    log_error("PosixTtyPhysicalLayer: Device failed (errno %d)", errno);
+    state_ = PHYSICAL_STATE_ERROR;
+    report_event(PHYSICAL_LAYER_EVENT_ERROR);
+    return PHYSICAL_ERROR_HW_FAIL;
+}
+
+int PosixTtyPhysicalLayer::on_receive(const uint8_t *data, uint16_t length)
+{
+    if (!up_layer)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    return up_layer->on_receive(data, length);
+}
+
+} // namespace robust_serial
@@ -0,0 +1,120 @@
+#ifndef __POSIX_TTY_PHYSICAL_LAYER_HPP__
+#define __POSIX_TTY_PHYSICAL_LAYER_HPP__
+
+#include "physical_layer.hpp"
+
+/**
+ * @brief Largest write send() passes to the tty at once
+ */
+#ifndef POSIX_TTY_MAX_WRITE
+#define POSIX_TTY_MAX_WRITE 4096
+#endif
+
+namespace robust_serial
+{
+
+/**
+ * @brief Physical layer on a POSIX serial device, for host-side gateways
+ *
+ * Opens the tty raw (8N1, no flow control, no line discipline) and
+ * non-blocking. send() writes what the driver takes and reports a full
+ * transmit buffer with is_write_blocked(), so that an event loop can wait
+ * for the descriptor to become writable instead of spinning; see
+ * PosixGateway. read() fills a buffer with what has arrived, typically a
+ * span of the link layer's incoming queue (RobustStack::incoming_write_span()),
+ * so received bytes are not copied on the way in.
+ *
+ * Not for interrupt context: every call is a system call.
+ */
+class PosixTtyPhysicalLayer final : public PhysicalLayer
+{
+public:
+    PosixTtyPhysicalLayer();
+    virtual ~PosixTtyPhysicalLayer();
+
+    /**
+     * @brief Open and configure a serial device
+     *
+     * @param path Device, e.g. "/dev/ttyUSB0"
+     * @param baud_rate One of the standard rates from 1200 to 4000000
+     * @return PHYSICAL_SUCCESS, PHYSICAL_ERROR_INVALID_PARAM for an unsupported
+     *         rate, PHYSICAL_ERROR_HW_FAIL if the device cannot be opened or set up
+     */
+    int open(const char *path, uint32_t baud_rate);
+
+    /**
+     * @brief Close the device; the layer can be opened again
+     */
+    void close();
+
+    /**
+     * @brief Descriptor of the open device, -1 if none
+     */
+    int get_fd() const
+    {
+        return fd_;
+    }
+
+    virtual void initialize();
+    virtual void deinitialize();
+
+    /**
+     * @brief Write as much as the tty driver takes now
+     *
+     * @return Bytes written, possibly 0 while its buffer is full;
+     *         PHYSICAL_ERROR_NOT_INITIALIZED if not open, PHYSICAL_ERROR_HW_FAIL
+     *         if the device failed
+     */
+    virtual int send(const uint8_t *data, uint16_t length);
+
+    /**
+     * @brief Write both spans with one writev()
+     */
+    virtual int send_spans(const uint8_t *first, uint16_t first_length, const uint8_t *second,
+                           uint16_t second_length);
+
+    /**
+     * @brief Read the bytes that have arrived, without waiting
+     *
+     * @return Bytes read, 0 if none; PHYSICAL_ERROR_HW_FAIL once the device
+     *         has failed or hung up, which is also reported as
+     *         PHYSICAL_LAYER_EVENT_ERROR
+     */
+    int read(uint8_t *buffer, uint16_t length);
+
+    /**
+     * @brief Forward bytes to the upper layer
+     */
+    virtual int on_receive(const uint8_t *data, uint16_t length);
+
+    virtual uint16_t get_max_payload_size() const
+    {
+        return POSIX_TTY_MAX_WRITE;
+    }
+
+    /**
+     * @brief Check whether the last write left bytes behind
+     *
+     * Set when the driver took fewer bytes than offered; cleared by the next
+     * write that is taken entirely.
+     */
+    bool is_write_blocked() const
+    {
+        return write_blocked_;
+    }
+
+private:
+    int write_result(long written, uint32_t length);
+    int fail();
+
+    int fd_;
+    bool write_blocked_;
+
+    // Prevent copy and assignment
+    PosixTtyPhysicalLayer(const PosixTtyPhysicalLayer &);
+    PosixTtyPhysicalLayer &operator=(const PosixTtyPhysicalLayer &);
+};
+
+} // namespace robust_serial
+
+#endif // __POSIX_TTY_PHYSICAL_LAYER_HPP__
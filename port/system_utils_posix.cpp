@@ -0,0 +1,19 @@
+#include "system_utils.hpp"
+#include <time.h>
+
+namespace robust_serial {
+
+/**
+ * @brief Milliseconds of the monotonic clock, for host builds (Linux, macOS, BSD)
+ *
+ * Build instead of system_utils.cpp. Wraps around like the tick counter of
+ * an RTOS.
+ */
+uint32_t get_current_time_ms()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint32_t>(static_cast<uint64_t>(now.tv_sec) * 1000u + now.tv_nsec / 1000000);
+}
+
+} // namespace robust_serial
@@ -1,12 +1,80 @@
 #include "cobs.hpp"
+#include <cstring> // For memchr(), memcpy(), memmove()
+#if COBS_KERNEL == COBS_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace robust_serial
 {
+
+/**
+ * @brief Counts the bytes ahead of the first zero, at most length
+ */
+static inline uint16_t cobs_zero_free_run(const uint8_t *data, uint16_t length)
+{
+    uint16_t i = 0;
+#if COBS_KERNEL == COBS_KERNEL_WORD
+    // A word has a zero byte if subtracting 1 from every byte borrows into a
+    // byte whose top bit was clear; the byte itself is then found one by one
+    const uintptr_t ones = ~static_cast<uintptr_t>(0) / 0xFF;
+    const uintptr_t highs = ones << 7;
+    while (i + sizeof(uintptr_t) <= length)
+    {
+        uintptr_t word;
+        memcpy(&word, &data[i], sizeof(word)); // Unaligned load
+        if (((word - ones) & ~word & highs) != 0)
+        {
+            break;
+        }
+        i += sizeof(uintptr_t);
+    }
+#elif COBS_KERNEL == COBS_KERNEL_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= length)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&data[i]));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+        if (mask != 0)
+        {
+            return i + static_cast<uint16_t>(__builtin_ctz(mask));
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && data[i] != 0)
+    {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief Counts the bytes ahead of the next delimiter, at most length
+ *
+ * Unlike a run of an encoder block, the distance to a delimiter is not
+ * bounded by a block, so the byte kernel leaves it to memchr(), which the C
+ * library vectorizes.
+ */
+static inline uint16_t cobs_find_delimiter(const uint8_t *data, uint16_t length)
+{
+#if COBS_KERNEL == COBS_KERNEL_BYTE
+    const uint8_t *delimiter = static_cast<const uint8_t *>(memchr(data, COBS_DELIMITER, length));
+    return delimiter ? static_cast<uint16_t>(delimiter - data) : length;
+#else
+    return cobs_zero_free_run(data, length);
+#endif
+}
+
 /**
  * @brief Encodes data using Consistent Overhead Byte Stuffing (COBS).
  * 
  * COBS encoding ensures that no zero bytes appear in the encoded data, making it
- * suitable for protocols that use zero bytes as delimiters.
+ * suitable for protocols that use zero bytes as delimiters. Input longer than
+ * one block is split into runs of at most 254 non-zero bytes.
+ *
+ * The output may alias the input as long as it starts at least
+ * in_place_offset(input_length) bytes before it: every output byte is written
+ * at or before the input byte being read.
  * 
  * @param input Pointer to input data buffer
  * @param input_length Length of input data in bytes
@@ -30,16 +98,8 @@ int COBS::encode(const uint8_t *input, uint16_t input_length,
         return 0;
     }
 
-    // Check if input length exceeds COBS block size
-    if (input_length > COBS_BLOCK_SIZE)
-    {
-        return COBS_ERROR_INVALID_INPUT;
-    }
-
     // Check if output buffer is large enough
-    // Maximum COBS overhead is 1 byte per 254 bytes of data, plus 1 byte
-    uint16_t max_encoded_length = input_length + (input_length / 254) + 1;
-    if (output_size < max_encoded_length)
+    if (output_size < max_encoded_length(input_length))
     {
         return COBS_ERROR_OUTPUT_TOO_SMALL;
     }
@@ -49,6 +109,34 @@ int COBS::encode(const uint8_t *input, uint16_t input_length,
     uint16_t code_index = 0;   // Where to write the code (run length)
     uint8_t code = 1;          // Run length counter
 
+#if COBS_KERNEL != COBS_KERNEL_BYTE
+    // Copy each zero-free run in one go, up to the end of its block. The
+    // output may trail the input by a few bytes, hence memmove().
+    while (read_index < input_length)
+    {
+        uint16_t limit = input_length - read_index;
+        if (limit > COBS_MAX_CODE - code)
+        {
+            limit = COBS_MAX_CODE - code;
+        }
+        uint16_t run = cobs_zero_free_run(&input[read_index], limit);
+        memmove(&output[write_index], &input[read_index], run);
+        read_index += run;
+        write_index += run;
+        code += run;
+
+        if (code == COBS_MAX_CODE || read_index < input_length)
+        {
+            output[code_index] = code;
+            code = 1;
+            code_index = write_index++;
+            if (run < limit)
+            {
+                read_index++; // Skip the zero that ended the run
+            }
+        }
+    }
+#else
     while (read_index < input_length)
     {
         if (input[read_index] == 0)
@@ -70,12 +158,36 @@ int COBS::encode(const uint8_t *input, uint16_t input_length,
         }
         read_index++;
     }
+#endif
 
     output[code_index] = code;
 
     return write_index;
 }
 
+/**
+ * @brief Encodes data in place using COBS.
+ *
+ * The write position only moves ahead of the read position by one byte per
+ * code byte emitted so far, so starting the raw data in_place_offset(length)
+ * bytes into the buffer keeps every write at or behind the byte being read.
+ *
+ * @param buffer Buffer with the raw data starting at buffer[offset]
+ * @param offset Position of the raw data (at least in_place_offset(length))
+ * @param length Length of the raw data in bytes
+ * @return int Number of encoded bytes, or negative error code:
+ *         COBS_ERROR_INVALID_INPUT: Invalid parameters or offset too small
+ */
+int COBS::encode_in_place(uint8_t *buffer, uint16_t offset, uint16_t length)
+{
+    if (!buffer || offset < in_place_offset(length))
+    {
+        return COBS_ERROR_INVALID_INPUT;
+    }
+
+    return encode(buffer + offset, length, buffer, offset + length + 1);
+}
+
 /**
  * @brief Decodes COBS-encoded data with improved error handling.
  * 
@@ -109,14 +221,7 @@ int COBS::decode(const uint8_t *input, uint16_t input_length,
     }
 
     // Look for frame delimiter
-    uint16_t frame_end;
-    for (frame_end = 0; frame_end < input_length; frame_end++)
-    {
-        if (input[frame_end] == COBS_DELIMITER)
-        {
-            break;
-        }
-    }
+    uint16_t frame_end = cobs_find_delimiter(input, input_length);
 
     if (frame_end == input_length)
     {
@@ -131,13 +236,6 @@ int COBS::decode(const uint8_t *input, uint16_t input_length,
         return 0;
     }
 
-    // Check if output buffer is large enough
-    // Decoded data is always smaller than encoded
-    if (output_size < frame_end)
-    {
-        return COBS_ERROR_OUTPUT_TOO_SMALL;
-    }
-
     uint16_t read_index = 0;
     uint16_t write_index = 0;
     
@@ -157,15 +255,33 @@ int COBS::decode(const uint8_t *input, uint16_t input_length,
             return COBS_ERROR_INVALID_INPUT;
         }
 
+        // Check if output buffer is large enough for this block
+        // (a frame of several blocks decodes to less than its encoded size
+        // minus one, so the whole frame cannot be checked up front)
+        if (write_index + code - 1 > output_size)
+        {
+            return COBS_ERROR_OUTPUT_TOO_SMALL;
+        }
+
         // Copy non-zero bytes
+#if COBS_KERNEL != COBS_KERNEL_BYTE
+        memmove(&output[write_index], &input[read_index], code - 1);
+        write_index += code - 1;
+        read_index += code - 1;
+#else
         for (uint8_t i = 1; i < code; i++)
         {
             output[write_index++] = input[read_index++];
         }
+#endif
 
         // Add zero unless it's the last code
         if (code < COBS_MAX_CODE && read_index < frame_end)
         {
+            if (write_index >= output_size)
+            {
+                return COBS_ERROR_OUTPUT_TOO_SMALL;
+            }
             output[write_index++] = 0;
         }
     }
@@ -174,4 +290,117 @@ int COBS::decode(const uint8_t *input, uint16_t input_length,
     return write_index;
 }
 
+COBSDecoder::COBSDecoder(uint8_t *output, uint16_t output_size)
+    : output_(output)
+    , output_size_(output_size)
+{
+    reset();
+}
+
+void COBSDecoder::reset()
+{
+    write_index_ = 0;
+    remaining_ = 0;
+    pending_zero_ = false;
+    in_frame_ = false;
+    error_ = COBS::COBS_SUCCESS;
+}
+
+/**
+ * @brief Feeds a chunk of encoded data into the decoder.
+ *
+ * The zero that ends a code block is only written once the next code byte
+ * arrives, because the last block of a frame is not followed by one. This
+ * yields exactly the output of COBS::decode() for the same frame.
+ *
+ * @param input Pointer to encoded input bytes
+ * @param input_length Number of input bytes
+ * @param consumed_length Reference to store number of input bytes consumed
+ * @return int Decoded frame length when a delimiter was consumed, or negative error code:
+ *         COBS_ERROR_INCOMPLETE: More data needed
+ *         COBS_ERROR_INVALID_INPUT: Frame ended inside a code block
+ *         COBS_ERROR_OUTPUT_TOO_SMALL: Frame did not fit in the output buffer
+ */
+int COBSDecoder::feed(const uint8_t *input, uint16_t input_length, uint16_t &consumed_length)
+{
+    consumed_length = 0;
+    if (!input || !output_)
+    {
+        return COBS::COBS_ERROR_INVALID_INPUT;
+    }
+
+    uint16_t read_index = 0;
+    while (read_index < input_length)
+    {
+        if (error_ != COBS::COBS_SUCCESS)
+        {
+            // Only the delimiter of a dropped frame matters: skip straight to it
+            read_index += cobs_find_delimiter(&input[read_index], input_length - read_index);
+            if (read_index == input_length)
+            {
+                break;
+            }
+        }
+
+        uint8_t byte = input[read_index++];
+
+        if (byte == COBS_DELIMITER)
+        {
+            int result = write_index_;
+            if (error_ != COBS::COBS_SUCCESS)
+            {
+                result = error_;
+            }
+            else if (remaining_ != 0)
+            {
+                result = COBS::COBS_ERROR_INVALID_INPUT; // Frame truncated inside a block
+            }
+
+            consumed_length = read_index;
+            reset();
+            return result;
+        }
+
+        in_frame_ = true;
+
+        if (remaining_ > 0)
+        {
+            // The code byte made sure the whole block fits
+            output_[write_index_++] = byte;
+            remaining_--;
+#if COBS_KERNEL != COBS_KERNEL_BYTE
+            // Take the rest of the block that is at hand, up to a delimiter
+            uint16_t limit = input_length - read_index;
+            if (limit > remaining_)
+            {
+                limit = remaining_;
+            }
+            uint16_t run = cobs_zero_free_run(&input[read_index], limit);
+            memcpy(&output_[write_index_], &input[read_index], run);
+            write_index_ += run;
+            read_index += run;
+            remaining_ -= run;
+#endif
+            continue;
+        }
+
+        // Code byte: close the previous block, then open a new one. A block
+        // that cannot fit dooms the frame already, e.g. a garbage code byte.
+        if (write_index_ + (pending_zero_ ? 1 : 0) + (byte - 1) > output_size_)
+        {
+            error_ = COBS::COBS_ERROR_OUTPUT_TOO_SMALL;
+            continue;
+        }
+        if (pending_zero_)
+        {
+            output_[write_index_++] = 0;
+        }
+        remaining_ = byte - 1;
+        pending_zero_ = (byte < COBS::COBS_MAX_CODE);
+    }
+
+    consumed_length = read_index;
+    return COBS::COBS_ERROR_INCOMPLETE;
+}
+
 } // namespace robust_serial
@@ -0,0 +1,137 @@
+#include "compression_layer.hpp"
+#include "log.hpp"
+
+namespace robust_serial
+{
+
+CompressionLayer::CompressionLayer()
+    : Layer()
+    , enabled_(false)
+{
+    reset_stats();
+}
+
+/**
+ * @brief Destructor for CompressionLayer.
+ */
+CompressionLayer::~CompressionLayer()
+{
+}
+
+void CompressionLayer::initialize()
+{
+    enabled_ = false;
+}
+
+void CompressionLayer::deinitialize()
+{
+    enabled_ = false;
+}
+
+void CompressionLayer::reset_stats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+int CompressionLayer::send(const uint8_t *data, uint16_t length)
+{
+    return send(data, length, LAYER_PRIORITY_BULK);
+}
+
+/**
+ * @brief Compresses a payload straight into the lower layer's queue
+ *
+ * The compressed frame must save at least one byte including the marker,
+ * otherwise the payload is sent unchanged.
+ */
+int CompressionLayer::send(const uint8_t *data, uint16_t length, uint8_t priority)
+{
+    if (!data || !down_layer)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (!enabled_ || length < COMPRESSION_MIN_LENGTH || length > LINK_MAX_PAYLOAD_SIZE)
+    {
+        return down_layer->send(data, length, priority);
+    }
+
+    // [COMPRESSION_FRAME_COMPRESSED(1) | LZ DATA(n)]
+    uint8_t *frame = down_layer->reserve(length, priority);
+    bool reserved = (frame != NULL);
+    if (!reserved)
+    {
+        frame = tx_buffer_;
+    }
+
+    int compressed = LZ::compress(data, length, &frame[1], length - 2, hash_table_);
+    if (compressed < 0)
+    {
+        stats_.frames_raw++;
+        if (!reserved)
+        {
+            return down_layer->send(data, length, priority);
+        }
+        memcpy(frame, data, length);
+        return down_layer->commit(length);
+    }
+
+    uint16_t frame_length = static_cast<uint16_t>(compressed) + 1;
+    frame[0] = COMPRESSION_FRAME_COMPRESSED;
+
+    int result = reserved ? down_layer->commit(frame_length)
+                          : down_layer->send(frame, frame_length, priority);
+    if (result >= 0)
+    {
+        stats_.frames_compressed++;
+        stats_.bytes_in += length;
+        stats_.bytes_out += frame_length;
+    }
+    return result;
+}
+
+uint8_t *CompressionLayer::reserve(uint16_t length)
+{
+    return reserve(length, LAYER_PRIORITY_BULK);
+}
+
+uint8_t *CompressionLayer::reserve(uint16_t length, uint8_t priority)
+{
+    // The payload must be seen before it can be compressed
+    if (enabled_ || !down_layer)
+    {
+        return NULL;
+    }
+    return down_layer->reserve(length, priority);
+}
+
+int CompressionLayer::commit(uint16_t length)
+{
+    return down_layer ? down_layer->commit(length) : LAYER_ERROR_INVALID_LAYER;
+}
+
+int CompressionLayer::on_receive(const uint8_t *data, uint16_t length)
+{
+    if (!data || length == 0 || !up_layer)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (data[0] != COMPRESSION_FRAME_COMPRESSED)
+    {
+        return up_layer->on_receive(data, length);
+    }
+
+    int decompressed = LZ::decompress(&data[1], length - 1, rx_buffer_, sizeof(rx_buffer_));
+    if (decompressed < 0)
+    {
+        stats_.decompress_errors++;
+        log_debug("CompressionLayer: Dropping malformed compressed frame (%d)", decompressed);
+        return LAYER_ERROR;
+    }
+
+    stats_.frames_decompressed++;
+    return up_layer->on_receive(rx_buffer_, static_cast<uint16_t>(decompressed));
+}
+
+} // namespace robust_serial
@@ -1,19 +1,118 @@
 #include "link_layer.hpp"
-#include <cstring> // For memmove()
+#include <cstring> // For memcpy(), memset(), memchr()
 #include "log.hpp"
 #include "robust_stack.hpp"
 
 namespace robust_serial
 {
 
-LinkLayer::LinkLayer()
+/**
+ * @brief Opens a frame slot in one outgoing queue, see LinkLayer::reserve()
+ */
+static uint8_t *reserve_slot(RingBuffer &queue, uint16_t needed, uint8_t *staging)
+{
+    if (queue.free_space() < needed)
+    {
+        return NULL;
+    }
+
+    // Build in place if the free space at the head is contiguous
+    uint16_t contiguous = 0;
+    uint8_t *head = queue.write_span(contiguous);
+    return (contiguous >= needed) ? head : staging;
+}
+
+/**
+ * @brief Publishes an encoded frame built by reserve_slot()
+ */
+static void publish_slot(RingBuffer &queue, const uint8_t *encoded, uint16_t length, const uint8_t *staging)
+{
+    if (encoded == staging)
+    {
+        queue.write(staging, length);
+    }
+    else
+    {
+        queue.commit(length);
+    }
+}
+
+/**
+ * @brief Gets the oldest frame of a queue as at most two spans
+ */
+static void oldest_frame_spans(const RingBuffer &queue, const uint8_t *&first, uint16_t &first_length,
+                               const uint8_t *&second, uint16_t &second_length)
+{
+    queue.read_spans(first, first_length, second, second_length);
+
+    const uint8_t *end = static_cast<const uint8_t *>(memchr(first, COBS_DELIMITER, first_length));
+    if (end)
+    {
+        first_length = static_cast<uint16_t>(end - first + 1);
+        second_length = 0;
+        return;
+    }
+
+    end = static_cast<const uint8_t *>(memchr(second, COBS_DELIMITER, second_length));
+    if (end)
+    {
+        second_length = static_cast<uint16_t>(end - second + 1);
+    }
+}
+
+/**
+ * @brief Releases sent bytes of a queue
+ *
+ * @return true if the last released byte was a frame delimiter
+ */
+static bool release_sent(RingBuffer &queue, uint16_t length)
+{
+    bool frame_end = (length > 0) && queue.peek(length - 1) == COBS_DELIMITER;
+    queue.consume(length);
+    return frame_end;
+}
+
+LinkLayer::LinkLayer(const LinkLayerBuffers &buffers)
     : Layer()
+    , decoder_(decode_buffer_, LINK_MAX_FRAME_SIZE)
+    , rx_frame_bytes_(0)
+    , control_buffer_(buffers.control, buffers.control_size)
+    , datagram_buffer_(buffers.datagram, buffers.datagram_size)
+    , outgoing_buffer_(buffers.outgoing, buffers.outgoing_size)
+    , incoming_buffer_(buffers.incoming, buffers.incoming_size)
 {
+    tx_queues_[LAYER_PRIORITY_CONTROL] = &control_buffer_;
+    tx_queues_[LAYER_PRIORITY_DATAGRAM] = &datagram_buffer_;
+    tx_queues_[LAYER_PRIORITY_BULK] = &outgoing_buffer_;
+    phy_capabilities_ = 0;
+    tx_in_flight_.store(false, std::memory_order_relaxed);
+    tx_transfer_length_ = 0;
+    rx_span_length_ = 0;
+    rx_span_received_ = 0;
+    rx_stalled_.store(false, std::memory_order_relaxed);
     state_ = LINK_STATE_READY;
-    encoded_length_ = 0;
-
-    outgoing_buffer_length_ = 0;
-    incoming_buffer_length_ = 0;
+    physical_layer_ = NULL;
+    reserved_frame_ = NULL;
+    reserved_length_ = 0;
+    reserved_queue_ = LAYER_PRIORITY_BULK;
+    tx_queue_ = LINK_TX_QUEUE_NONE;
+    batch_depth_ = 0;
+    batch_pending_ = false;
+    data_events_ = true;
+#if LINK_FEC
+    fec_group_size_ = 0;
+    fec_threshold_ = 0;
+    fec_active_ = false;
+    fec_window_frames_ = 0;
+    fec_window_errors_ = 0;
+    fec_tx_group_ = 0;
+    fec_tx_count_ = 0;
+    fec_tx_length_ = 0;
+    fec_tx_length_xor_ = 0;
+    memset(fec_tx_parity_, 0, sizeof(fec_tx_parity_));
+    start_fec_rx_group(LINK_FEC_NO_GROUP);
+#endif
+    reset_stats();
 }
 
 /**
@@ -31,6 +130,13 @@ void LinkLayer::initialize()
     // Reset state and buffers
     reset();
 
+    // The physical layer's initialize() ended any reception it was running
+    if (phy_capabilities_ & PHYSICAL_CAPABILITY_ASYNC_RX)
+    {
+        rx_stalled_.store(true, std::memory_order_release);
+        resume_reception();
+    }
+
     // Report ready state to upper layer
     report_event(LINK_LAYER_EVENT_READY);
 }
@@ -38,142 +144,719 @@ void LinkLayer::initialize()
 void LinkLayer::deinitialize()
 {
     reset();
+    rx_stalled_.store(false, std::memory_order_release); // Re-armed by initialize()
+    rx_span_length_ = 0;
+}
+
+int LinkLayer::set_down_layer(PhysicalLayer *layer)
+{
+    int result = Layer::set_down_layer(layer);
+    if (result == LAYER_SUCCESS && physical_layer_ != layer)
+    {
+        physical_layer_ = layer;
+        layer->link_layer_ = this;
+        phy_capabilities_ = layer->get_capabilities();
+        if (phy_capabilities_ & PHYSICAL_CAPABILITY_ASYNC_RX)
+        {
+            rx_stalled_.store(true, std::memory_order_release);
+            resume_reception();
+        }
+    }
+    return result;
 }
 
 void LinkLayer::reset()
 {
     state_ = LINK_STATE_READY;
-    encoded_length_ = 0;
+    reserved_frame_ = NULL;
+    reserved_length_ = 0;
     report_event(LINK_LAYER_EVENT_READY, NULL);
 }
 
 int LinkLayer::send(const uint8_t *data, uint16_t length)
 {
-    if (!data || !down_layer)
+    return send(data, length, LAYER_PRIORITY_BULK);
+}
+
+int LinkLayer::send(const uint8_t *data, uint16_t length, uint8_t priority)
+{
+    if (!data)
     {
         report_event(LINK_LAYER_EVENT_ERROR);
         return LINK_ERROR_INVALID_PARAM;
     }
 
-    if (length > get_max_payload_size())
+    LayerSegment segment = {data, length};
+    return send_v(&segment, 1, priority);
+}
+
+int LinkLayer::send_v(const LayerSegment *segments, uint8_t count, uint8_t priority)
+{
+    int32_t length = layer_segments_length(segments, count);
+    if (length < 0 || !down_layer)
     {
         report_event(LINK_LAYER_EVENT_ERROR);
         return LINK_ERROR_INVALID_PARAM;
     }
 
+    if (length > get_max_payload_size() || priority >= LAYER_PRIORITY_COUNT)
+    {
+        report_event(LINK_LAYER_EVENT_ERROR);
+        return LINK_ERROR_INVALID_PARAM;
+    }
+
+    uint8_t *payload = reserve(static_cast<uint16_t>(length), priority);
+    if (!payload)
+    {
+        stats_.tx_overflows++;
+        report_event(LINK_LAYER_EVENT_ERROR);
+        return LINK_ERROR_BUFFER_FULL;
+    }
+
+    // The only copy of the payload on the way to the physical layer
+    layer_gather_segments(payload, segments, count);
+
+    return commit(static_cast<uint16_t>(length));
+}
+
+void LinkLayer::end_batch()
+{
+    if (batch_depth_ == 0 || --batch_depth_ > 0)
+    {
+        return;
+    }
+
+    if (batch_pending_)
+    {
+        batch_pending_ = false;
+        if (data_events_)
+        {
+            report_event(LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE);
+        }
+    }
+}
+
+uint8_t *LinkLayer::reserve(uint16_t length)
+{
+    return reserve(length, LAYER_PRIORITY_BULK);
+}
+
+uint8_t *LinkLayer::reserve(uint16_t length, uint8_t priority)
+{
+    if (length > get_max_payload_size() || priority >= LAYER_PRIORITY_COUNT)
+    {
+        return NULL;
+    }
+
     if (state_ == LINK_STATE_ERROR)
     {
         reset(); // Auto-reset from error state on new transmission
     }
 
-    // Construct frame: [TYPE(1) | LENGTH(1) | PAYLOAD(n) | CRC16(2)]
-    frame_buffer_[0] = LINK_FRAME_TYPE_DATA;
-    frame_buffer_[1] = length;
-    memcpy(&frame_buffer_[LINK_HEADER_SIZE], data, length);
+    // Worst case encoded size: COBS prefix + frame + trailing code + delimiter
+    uint16_t needed = LINK_FRAME_SLOT_SIZE(length + LINK_MIN_FRAME_SIZE);
+    reserved_frame_ = reserve_slot(*tx_queues_[priority], needed, staging_buffer_);
+
+    if (!reserved_frame_)
+    {
+        return NULL;
+    }
+    reserved_length_ = length;
+    reserved_queue_ = priority;
+    return reserved_frame_ + LINK_COBS_PREFIX_SIZE + LINK_HEADER_SIZE;
+}
+
+int LinkLayer::commit(uint16_t length)
+{
+    uint8_t *encoded = reserved_frame_;
+    reserved_frame_ = NULL;
+    if (!encoded || length > reserved_length_ || !down_layer)
+    {
+        report_event(LINK_LAYER_EVENT_ERROR);
+        return LINK_ERROR_INVALID_PARAM;
+    }
+
+    // Construct frame after the spare COBS prefix:
+    // [TYPE(1) | LENGTH(1 or 2) | PAYLOAD(n) | CRC16(2)]
+    uint8_t *frame = encoded + LINK_COBS_PREFIX_SIZE;
+    frame[0] = LINK_FRAME_TYPE_DATA;
+    frame[1] = length & 0xFF;
+#if LINK_LARGE_FRAMES
+    frame[2] = (length >> 8) & 0xFF;
+#endif
+
+#if LINK_FEC
+    // Add the payload to the group's parity before encoding overwrites it
+    bool protect = fec_active_ && reserved_queue_ == LAYER_PRIORITY_BULK;
+    if (protect)
+    {
+        frame[0] = LINK_FRAME_TYPE_FEC_DATA | (fec_tx_group_ << 4) | fec_tx_count_;
+        const uint8_t *payload = &frame[LINK_HEADER_SIZE];
+        for (uint16_t i = 0; i < length; i++)
+        {
+            fec_tx_parity_[i] ^= payload[i];
+        }
+        fec_tx_length_xor_ ^= length;
+        if (length > fec_tx_length_)
+        {
+            fec_tx_length_ = length;
+        }
+    }
+#endif
 
-    uint16_t crc = CRC16::calculate(frame_buffer_, length + LINK_HEADER_SIZE);
-    frame_buffer_[length + LINK_HEADER_SIZE] = crc & 0xFF;
-    frame_buffer_[length + LINK_HEADER_SIZE + 1] = (crc >> 8) & 0xFF;
+    int result = finish_frame(encoded, length, reserved_queue_);
+    if (result != LINK_SUCCESS)
+    {
+        return result;
+    }
+    stats_.frames_tx++;
 
-    uint16_t frame_length = length + LINK_MIN_FRAME_SIZE;
+#if LINK_FEC
+    if (protect && ++fec_tx_count_ >= fec_group_size_)
+    {
+        close_fec_group();
+    }
+#endif
 
-    // COBS encode the frame
-    encoded_length_ =
-        COBS::encode(frame_buffer_, frame_length, encoded_buffer_, LINK_MAX_FRAME_SIZE);
-    if (encoded_length_ < 0)
+    // Report that new data is available for sending, once per batch
+    if (batch_depth_ > 0)
+    {
+        batch_pending_ = true;
+    }
+    else if (data_events_)
+    {
+        report_event(LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE);
+    }
+
+    return LINK_SUCCESS;
+}
+
+int LinkLayer::finish_frame(uint8_t *encoded, uint16_t payload_length, uint8_t queue)
+{
+    uint8_t *frame = encoded + LINK_COBS_PREFIX_SIZE;
+    uint16_t crc = CRC16::calculate(frame, payload_length + LINK_HEADER_SIZE);
+    frame[payload_length + LINK_HEADER_SIZE] = crc & 0xFF;
+    frame[payload_length + LINK_HEADER_SIZE + 1] = (crc >> 8) & 0xFF;
+
+    uint16_t frame_length = payload_length + LINK_MIN_FRAME_SIZE;
+
+    // COBS encode the frame where it stands
+    int encoded_length = COBS::encode_in_place(encoded, LINK_COBS_PREFIX_SIZE, frame_length);
+    if (encoded_length < 0)
     {
         state_ = LINK_STATE_ERROR;
         report_event(LINK_LAYER_EVENT_ERROR);
         return LINK_ERROR_GENERAL;
     }
 
-    encoded_buffer_[encoded_length_] = COBS_DELIMITER;
-    encoded_length_++;
+    encoded[encoded_length++] = COBS_DELIMITER;
+    publish_slot(*tx_queues_[queue], encoded, encoded_length, staging_buffer_);
+    return LINK_SUCCESS;
+}
 
-    // Check if there's enough space in the outgoing buffer
-    if (outgoing_buffer_length_ + encoded_length_ > LINK_OUTGOING_BUFFER_SIZE)
+#if LINK_FEC
+int LinkLayer::set_fec(uint8_t group_size, uint16_t crc_error_threshold)
+{
+    if (group_size > LINK_FEC_MAX_GROUP_SIZE)
     {
-        report_event(LINK_LAYER_EVENT_ERROR);
-        return LINK_ERROR_BUFFER_FULL;
+        return LINK_ERROR_INVALID_PARAM;
     }
 
-    // Queue the encoded frame in the outgoing buffer
-    memcpy(outgoing_buffer_ + outgoing_buffer_length_, encoded_buffer_, encoded_length_);
-    outgoing_buffer_length_ += encoded_length_;
+    fec_group_size_ = group_size;
+    fec_threshold_ = crc_error_threshold;
+    fec_active_ = (group_size > 0 && crc_error_threshold == 0);
+    fec_window_frames_ = 0;
+    fec_window_errors_ = 0;
+    if (!fec_active_)
+    {
+        close_fec_group();
+    }
+    return LINK_SUCCESS;
+}
 
-    // log_debug("LinkLayer::send, outgoing_buffer_length_:%d",
-    // outgoing_buffer_length_);
+/**
+ * @brief Ends the transmit group with its parity frame
+ *
+ * The parity frame joins the bulk queue right behind the group's last frame.
+ * If there is no room for it, the group simply goes unprotected. Nothing is
+ * queued while a reservation is open, since it may occupy the head of the
+ * queue; the group is then closed by a later call.
+ */
+bool LinkLayer::close_fec_group()
+{
+    if (fec_tx_count_ == 0 || reserved_frame_)
+    {
+        return false;
+    }
 
-    // Report that new data is available for sending
-    report_event(LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE);
+    // [TYPE(1) | LENGTH XOR(1 or 2) | PARITY(n) | CRC16(2)]
+    uint16_t needed = LINK_FRAME_SLOT_SIZE(fec_tx_length_ + LINK_MIN_FRAME_SIZE);
+    uint8_t *encoded = reserve_slot(outgoing_buffer_, needed, staging_buffer_);
+    bool queued = false;
+    if (encoded)
+    {
+        uint8_t *frame = encoded + LINK_COBS_PREFIX_SIZE;
+        frame[0] = LINK_FRAME_TYPE_FEC_PARITY | (fec_tx_group_ << 4) | fec_tx_count_;
+        frame[1] = fec_tx_length_xor_ & 0xFF;
+#if LINK_LARGE_FRAMES
+        frame[2] = (fec_tx_length_xor_ >> 8) & 0xFF;
+#endif
+        memcpy(&frame[LINK_HEADER_SIZE], fec_tx_parity_, fec_tx_length_);
+        queued = (finish_frame(encoded, fec_tx_length_, LAYER_PRIORITY_BULK) == LINK_SUCCESS);
+        if (queued)
+        {
+            stats_.fec_parity_tx++;
+        }
+    }
 
-    return LINK_SUCCESS;
+    memset(fec_tx_parity_, 0, fec_tx_length_);
+    fec_tx_group_ = (fec_tx_group_ + 1) & 0x03;
+    fec_tx_count_ = 0;
+    fec_tx_length_ = 0;
+    fec_tx_length_xor_ = 0;
+    return queued;
+}
+
+void LinkLayer::start_fec_rx_group(uint8_t group)
+{
+    fec_rx_group_ = group;
+    fec_rx_mask_ = 0;
+    fec_rx_length_xor_ = 0;
+    memset(fec_rx_buffer_, 0, sizeof(fec_rx_buffer_));
+}
+
+void LinkLayer::receive_fec_data(uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    // Frames of a group arrive in order, so an index not above all indices
+    // seen so far belongs to a new group even if the GROUP counter wrapped
+    uint8_t group = (type >> 4) & 0x03;
+    uint8_t index = type & 0x0F;
+    if (group != fec_rx_group_ || (fec_rx_mask_ >> index) != 0)
+    {
+        start_fec_rx_group(group);
+    }
+
+    fec_rx_mask_ |= static_cast<uint16_t>(1u << index);
+    fec_rx_length_xor_ ^= length;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        fec_rx_buffer_[i] ^= payload[i];
+    }
+}
+
+/**
+ * @brief Rebuilds the one missing data frame of a group, if exactly one is missing
+ */
+void LinkLayer::receive_fec_parity(uint8_t type, uint16_t length_xor, const uint8_t *parity,
+                                   uint16_t length)
+{
+    stats_.fec_parity_rx++;
+
+    uint8_t group = (type >> 4) & 0x03;
+    uint8_t count = type & 0x0F;
+    if (group != fec_rx_group_)
+    {
+        start_fec_rx_group(group); // None of the group's data frames arrived
+    }
+
+    uint16_t expected = static_cast<uint16_t>((1u << count) - 1);
+    uint16_t missing = expected & ~fec_rx_mask_;
+    uint16_t recovered_length = length_xor ^ fec_rx_length_xor_;
+    if (missing != 0)
+    {
+        if ((missing & (missing - 1)) != 0 || (fec_rx_mask_ & ~expected) != 0 ||
+            recovered_length > length)
+        {
+            stats_.fec_unrecoverable++;
+        }
+        else
+        {
+            for (uint16_t i = 0; i < recovered_length; i++)
+            {
+                fec_rx_buffer_[i] ^= parity[i];
+            }
+            stats_.fec_recovered++;
+            if (up_layer)
+            {
+                up_layer->on_receive(fec_rx_buffer_, recovered_length);
+            }
+        }
+    }
+
+    // The group is complete; its GROUP value may come again after a wrap
+    start_fec_rx_group(LINK_FEC_NO_GROUP);
+}
+
+/**
+ * @brief Switches adaptive FEC on or off at the end of each measurement window
+ */
+void LinkLayer::update_fec_window(bool crc_error)
+{
+    if (fec_threshold_ == 0 || fec_group_size_ == 0)
+    {
+        return;
+    }
+
+    fec_window_frames_++;
+    if (crc_error)
+    {
+        fec_window_errors_++;
+    }
+    if (fec_window_frames_ < LINK_FEC_WINDOW_FRAMES)
+    {
+        return;
+    }
+
+    uint32_t rate = static_cast<uint32_t>(fec_window_errors_) * 1000 / fec_window_frames_;
+    fec_window_frames_ = 0;
+    fec_window_errors_ = 0;
+
+    if (!fec_active_ && rate >= fec_threshold_)
+    {
+        log_debug("LinkLayer: %u CRC errors per 1000 frames, FEC on", static_cast<unsigned>(rate));
+        fec_active_ = true;
+    }
+    else if (fec_active_ && rate < fec_threshold_ / 2)
+    {
+        log_debug("LinkLayer: %u CRC errors per 1000 frames, FEC off", static_cast<unsigned>(rate));
+        fec_active_ = false;
+        close_fec_group();
+    }
 }
+#endif
 
+/**
+ * @brief Hands queued frames to the physical layer, highest priority first
+ *
+ * One frame is offered per transfer (as one or two spans) so that the queue
+ * can be chosen again at every frame boundary. A frame the physical layer
+ * took only partly stays selected until it is complete. Transfers continue
+ * until the queues are empty or the physical layer accepts less than offered.
+ */
 int LinkLayer::process_outgoing_data()
 {
-    if (outgoing_buffer_length_ > 0 && state_ == LINK_STATE_READY)
+#if LINK_FEC
+    // Protect the end of a burst without waiting for the group to fill
+    if (fec_tx_count_ > 0 && outgoing_buffer_.empty() && state_ == LINK_STATE_READY)
     {
-        state_ = LINK_STATE_SENDING;
+        close_fec_group();
+    }
+#endif
 
-        // Send the data
-        int result = down_layer->send(outgoing_buffer_, outgoing_buffer_length_);
+    if (!has_outgoing_data() || state_ != LINK_STATE_READY)
+    {
+        return 0;
+    }
 
-        // Remove sent data from the outgoing buffer
-        if (result > 0)
+    if (phy_capabilities_ & PHYSICAL_CAPABILITY_ASYNC_TX)
+    {
+        return start_async_transmit();
+    }
+
+    state_ = LINK_STATE_SENDING;
+
+    int result = 0;
+    int total = 0;
+    for (;;)
+    {
+        if (tx_queue_ == LINK_TX_QUEUE_NONE)
         {
-            memmove(outgoing_buffer_, outgoing_buffer_ + result, outgoing_buffer_length_ - result);
-            outgoing_buffer_length_ -= result;
+            tx_queue_ = select_tx_queue();
+#if LINK_FEC
+            if (tx_queue_ == LINK_TX_QUEUE_NONE && close_fec_group())
+            {
+                tx_queue_ = LAYER_PRIORITY_BULK;
+            }
+#endif
+            if (tx_queue_ == LINK_TX_QUEUE_NONE)
+            {
+                break;
+            }
         }
 
-        // Restore state even if no data was sent
-        state_ = LINK_STATE_READY;
+        // Hand the frame to the physical layer where it is
+        const uint8_t *first;
+        const uint8_t *second;
+        uint16_t first_length;
+        uint16_t second_length;
+        frame_spans(first, first_length, second, second_length);
 
-        return result;
+        int offered;
+        if (physical_layer_)
+        {
+            offered = first_length + second_length;
+            result = physical_layer_->send_spans(first, first_length, second, second_length);
+        }
+        else
+        {
+            offered = first_length;
+            result = down_layer->send(first, first_length);
+        }
+
+        if (result <= 0)
+        {
+            break;
+        }
+
+        // Remove sent data from the outgoing queue
+        consume_tx(static_cast<uint16_t>(result));
+        stats_.bytes_tx += result;
+        total += result;
+
+        if (result < offered)
+        {
+            break; // Physical layer is busy
+        }
     }
-    else
+
+    // Restore state even if no data was sent
+    state_ = LINK_STATE_READY;
+
+    return (total > 0) ? total : result;
+}
+
+uint8_t LinkLayer::select_tx_queue() const
+{
+    for (uint8_t queue = 0; queue < LAYER_PRIORITY_COUNT; queue++)
+    {
+        if (!tx_queue_empty(queue))
+        {
+            return queue;
+        }
+    }
+    return LINK_TX_QUEUE_NONE;
+}
+
+bool LinkLayer::tx_queue_empty(uint8_t queue) const
+{
+    return (queue >= LAYER_PRIORITY_COUNT) || tx_queues_[queue]->empty();
+}
+
+uint16_t LinkLayer::get_queue_capacity(uint8_t priority) const
+{
+    return (priority < LAYER_PRIORITY_COUNT) ? tx_queues_[priority]->capacity() : 0;
+}
+
+void LinkLayer::frame_spans(const uint8_t *&first, uint16_t &first_length, const uint8_t *&second,
+                            uint16_t &second_length) const
+{
+    if (tx_queue_ >= LAYER_PRIORITY_COUNT)
+    {
+        first = NULL;
+        second = NULL;
+        first_length = 0;
+        second_length = 0;
+        return;
+    }
+    oldest_frame_spans(*tx_queues_[tx_queue_], first, first_length, second, second_length);
+}
+
+void LinkLayer::consume_tx(uint16_t length)
+{
+    if (tx_queue_ >= LAYER_PRIORITY_COUNT)
+    {
+        return;
+    }
+
+    if (release_sent(*tx_queues_[tx_queue_], length))
+    {
+        tx_queue_ = LINK_TX_QUEUE_NONE;
+#if LINK_FRAME_EVENTS
+        report_event(LINK_LAYER_EVENT_FRAME_SENT);
+#endif
+    }
+}
+
+/**
+ * @brief Starts a transfer unless one is running, which then chains the queued frames
+ */
+int LinkLayer::start_async_transmit()
+{
+    if (tx_in_flight_.exchange(true, std::memory_order_acq_rel))
     {
         return 0;
     }
+
+    int result = start_transfer();
+    if (result <= 0)
+    {
+        tx_in_flight_.store(false, std::memory_order_release);
+    }
+    return result;
 }
 
-// Always return LINK_SUCCESS
-int LinkLayer::process_incoming_data()
+int LinkLayer::start_transfer()
+{
+    if (tx_queue_ == LINK_TX_QUEUE_NONE)
+    {
+        tx_queue_ = select_tx_queue();
+    }
+
+    // One contiguous span per transfer; a frame wrapping around the end of
+    // its ring takes two
+    const uint8_t *first;
+    const uint8_t *second;
+    uint16_t second_length;
+    frame_spans(first, tx_transfer_length_, second, second_length);
+    if (tx_transfer_length_ == 0)
+    {
+        return 0;
+    }
+
+    int result = physical_layer_->start_transmit(first, tx_transfer_length_);
+    return (result == PHYSICAL_SUCCESS) ? tx_transfer_length_ : result;
+}
+
+/**
+ * @brief Releases the sent span and starts the next one, see PhysicalLayer::transmit_complete()
+ */
+void LinkLayer::on_transmit_complete()
 {
-    if (incoming_buffer_length_ == 0)
+    consume_tx(tx_transfer_length_);
+    stats_.bytes_tx += tx_transfer_length_;
+
+    for (;;)
     {
-        return LINK_SUCCESS;
+        int result = start_transfer();
+        if (result > 0)
+        {
+            return;
+        }
+
+        // A frame queued meanwhile may have found the transfer still running
+        tx_in_flight_.store(false, std::memory_order_release);
+        if (result < 0 || !has_outgoing_data() || tx_in_flight_.exchange(true, std::memory_order_acq_rel))
+        {
+            return;
+        }
     }
+}
 
-    while (incoming_buffer_length_ > 0)
+void LinkLayer::start_reception()
+{
+    for (;;)
+    {
+        uint16_t length = 0;
+        uint8_t *span = incoming_buffer_.write_span(length);
+        if (length > 0)
+        {
+            rx_span_length_ = length;
+            rx_span_received_ = 0;
+            if (physical_layer_->start_receive(span, length) != PHYSICAL_SUCCESS)
+            {
+                // Retried like a reception paused on a full queue
+                rx_span_length_ = 0;
+                rx_stalled_.store(true, std::memory_order_release);
+            }
+            return;
+        }
+
+        // Room made meanwhile may have found the reception still running
+        rx_stalled_.store(true, std::memory_order_release);
+        if (incoming_buffer_.free_space() == 0 || !rx_stalled_.exchange(false, std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Restarts a reception that is paused or failed to start, unless another context does
+ */
+void LinkLayer::resume_reception()
+{
+    if (rx_stalled_.load(std::memory_order_acquire) && rx_stalled_.exchange(false, std::memory_order_acq_rel))
+    {
+        start_reception();
+    }
+}
+
+/**
+ * @brief Publishes received bytes, see PhysicalLayer::receive_progress()
+ */
+void LinkLayer::on_receive_progress(uint16_t received)
+{
+    if (received > rx_span_length_)
+    {
+        received = rx_span_length_;
+    }
+    if (received > rx_span_received_)
     {
+        incoming_buffer_.commit(received - rx_span_received_);
+        rx_span_received_ = received;
+    }
+}
+
+void LinkLayer::on_receive_complete()
+{
+    on_receive_progress(rx_span_length_);
+    start_reception();
+}
+
+// Always return LINK_SUCCESS
+int LinkLayer::process_incoming_data()
+{
+    // Also retries a reception that failed to start while the queue was empty
+    resume_reception();
+
+    while (!incoming_buffer_.empty())
+    {
+        // Decode the bytes where they sit in the ring; the decoder keeps its
+        // state when a frame spans several chunks or the end of the ring
+        uint16_t contiguous = 0;
+        const uint8_t *encoded = incoming_buffer_.read_span(contiguous);
+
         uint16_t consumed_length = 0;
-        int decoded_length = COBS::decode(incoming_buffer_, incoming_buffer_length_, decode_buffer_,
-                                          LINK_MAX_FRAME_SIZE, consumed_length);
+        int decoded_length = decoder_.feed(encoded, contiguous, consumed_length);
+        incoming_buffer_.consume(consumed_length);
+        stats_.bytes_rx += consumed_length;
+
+        // A reception paused on the full queue resumes as soon as there is room
+        resume_reception();
+        rx_frame_bytes_ += consumed_length;
 
         if (decoded_length == COBS::COBS_ERROR_INCOMPLETE)
         {
-            return LINK_SUCCESS; // Wait for more data
+            continue; // Frame continues in the next chunk
         }
 
-        if (decoded_length < LINK_MIN_FRAME_SIZE || decoded_length < 0)
+        // Encoded size of the frame just completed, lost if the frame is dropped
+        uint16_t frame_bytes = rx_frame_bytes_;
+        rx_frame_bytes_ = 0;
+
+        if (decoded_length == 0)
         {
-            // Invalid frame, drop one byte
-            memmove(incoming_buffer_, incoming_buffer_ + 1, --incoming_buffer_length_);
+            continue; // Lone delimiter
+        }
 
-            // Parse rest of data
+        if (decoded_length < 0)
+        {
+            // Malformed frame, already skipped up to its delimiter
+            stats_.cobs_errors++;
+            stats_.resync_dropped_bytes += frame_bytes;
             continue;
         }
 
-        // Decode return success; Validate payload length
-        uint8_t payload_length = decode_buffer_[1];
-        if (payload_length > LINK_MAX_PAYLOAD_SIZE ||
-            decoded_length != (payload_length + LINK_MIN_FRAME_SIZE))
+        if (decoded_length < LINK_MIN_FRAME_SIZE)
         {
-            memmove(incoming_buffer_, incoming_buffer_ + consumed_length,
-                    incoming_buffer_length_ - consumed_length);
-            incoming_buffer_length_ -= consumed_length;
+            stats_.invalid_frames++;
+            stats_.resync_dropped_bytes += frame_bytes;
+            continue;
+        }
 
+        // Decode return success; Validate payload length. The LENGTH field
+        // of a parity frame holds the XOR of the lengths it covers instead.
+        uint8_t frame_type = decode_buffer_[0];
+        uint16_t length_field = decode_buffer_[1];
+#if LINK_LARGE_FRAMES
+        length_field |= (uint16_t)decode_buffer_[2] << 8;
+#endif
+        uint16_t payload_length = decoded_length - LINK_MIN_FRAME_SIZE;
+        bool parity = (frame_type & LINK_FRAME_TYPE_FEC_MASK) == LINK_FRAME_TYPE_FEC_PARITY;
+        if (payload_length > LINK_MAX_PAYLOAD_SIZE || (!parity && length_field != payload_length))
+        {
+            stats_.invalid_frames++;
+            stats_.resync_dropped_bytes += frame_bytes;
             continue;
         }
 
@@ -185,35 +868,71 @@ int LinkLayer::process_incoming_data()
 
         if (computed_crc == received_crc)
         {
-            uint8_t frame_type = decode_buffer_[0];
+            const uint8_t *payload = &decode_buffer_[LINK_HEADER_SIZE];
+#if LINK_FEC
+            update_fec_window(false);
+
+            // INDEX is below LINK_FEC_MAX_GROUP_SIZE, COUNT is 1 or more
+            if ((frame_type & LINK_FRAME_TYPE_FEC_MASK) == LINK_FRAME_TYPE_FEC_DATA &&
+                (frame_type & 0x0F) < LINK_FEC_MAX_GROUP_SIZE)
+            {
+                receive_fec_data(frame_type, payload, payload_length);
+                frame_type = LINK_FRAME_TYPE_DATA;
+            }
+            else if (parity && (frame_type & 0x0F) != 0)
+            {
+                receive_fec_parity(frame_type, length_field, payload, payload_length);
+                state_ = LINK_STATE_READY;
+                continue;
+            }
+#else
+            // Without FEC support the data frames of a group are taken as
+            // they come, lost ones are left to the transport, and the parity
+            // frames are of no use
+            if ((frame_type & LINK_FRAME_TYPE_FEC_MASK) == LINK_FRAME_TYPE_FEC_DATA)
+            {
+                frame_type = LINK_FRAME_TYPE_DATA;
+            }
+            else if (parity)
+            {
+                state_ = LINK_STATE_READY;
+                continue;
+            }
+#endif
 
             if (frame_type == LINK_FRAME_TYPE_DATA)
             {
+                stats_.frames_rx++;
+
                 // Forward payload to upper layer
                 if (up_layer)
                 {
-                    up_layer->on_receive(&decode_buffer_[LINK_HEADER_SIZE], payload_length);
+                    up_layer->on_receive(payload, payload_length);
                 }
                 state_ = LINK_STATE_READY;
+#if LINK_FRAME_EVENTS
                 report_event(LINK_LAYER_EVENT_FRAME_RECEIVED);
+#endif
             }
             else
             {
                 // Unknown frame type
+                stats_.invalid_frames++;
                 state_ = LINK_STATE_ERROR;
                 //report_event(LINK_LAYER_EVENT_ERROR);
             }
         }
         else
         {
+            stats_.crc_errors++;
+            stats_.resync_dropped_bytes += frame_bytes;
             state_ = LINK_STATE_ERROR;
+#if LINK_FEC
+            update_fec_window(true);
+#endif
             report_event(LINK_LAYER_EVENT_CRC_ERROR);
         }
 
-        // Remove processed frame
-        memmove(incoming_buffer_, incoming_buffer_ + consumed_length,
-                incoming_buffer_length_ - consumed_length);
-        incoming_buffer_length_ -= consumed_length;
     }
 
     return LINK_SUCCESS;
@@ -227,23 +946,38 @@ int LinkLayer::on_receive(const uint8_t *data, uint16_t length)
         return LINK_ERROR_INVALID_PARAM;
     }
 
-    // Check for buffer overflow
-    if (incoming_buffer_length_ + length > LINK_INCOMING_BUFFER_SIZE)
+    // Append new data to incoming buffer
+    if (!incoming_buffer_.write(data, length))
     {
-        // Buffer overflow - reset buffer
-        incoming_buffer_length_ = 0;
+        // Buffer overflow - drop the new bytes. The consumer side is left
+        // alone (it may be running concurrently); the frame that lost bytes
+        // fails its CRC check and decoding resumes at the next delimiter.
+        count_rx_overflow(length);
         // report_event(LINK_LAYER_EVENT_ERROR);
         return LINK_ERROR_BUFFER_FULL;
     }
 
-    // Append new data to incoming buffer
-    memcpy(incoming_buffer_ + incoming_buffer_length_, data, length);
-    incoming_buffer_length_ += length;
-
     // Report that more data is available for processing
-    report_event(LINK_LAYER_EVENT_INCOMING_DATA_AVAILABLE);
+    if (data_events_)
+    {
+        report_event(LINK_LAYER_EVENT_INCOMING_DATA_AVAILABLE);
+    }
 
     return LINK_SUCCESS;
 }
 
+void LinkLayer::get_stats(LinkLayerStats &stats) const
+{
+    stats = stats_;
+    stats.rx_overflows = rx_overflows_.load(std::memory_order_relaxed);
+    stats.rx_overflow_bytes = rx_overflow_bytes_.load(std::memory_order_relaxed);
+}
+
+void LinkLayer::reset_stats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+    rx_overflows_.store(0, std::memory_order_relaxed);
+    rx_overflow_bytes_.store(0, std::memory_order_relaxed);
+}
+
 } // namespace robust_serial
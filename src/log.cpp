@@ -0,0 +1,128 @@
+#include "log.hpp"
+
+#if LOG_BACKEND == LOG_BACKEND_DEFERRED
+#include <atomic>
+#include "system_utils.hpp" // For get_current_time_ms
+
+namespace robust_serial
+{
+
+/**
+ * @brief One deferred log record
+ *
+ * The slot at index i holds the record of position p when p & (RECORDS - 1)
+ * equals i. Its sequence, offset by i so that the zero-initialized table
+ * starts out valid, tells who may use it next: p if the slot is free for the
+ * producer of position p, p + 1 once that record is complete.
+ */
+struct LogRecord
+{
+    std::atomic<uint32_t> sequence;
+    const char *format; // Format string, also identifies the message
+    uint32_t timestamp; // get_current_time_ms() when the message was logged
+    uint8_t level;      // LogLevel
+    uint8_t arg_count;  // Number of valid words in args
+    LogWord args[LOG_DEFERRED_MAX_ARGS];
+};
+
+#define LOG_DEFERRED_MASK (LOG_DEFERRED_RECORDS - 1)
+
+static LogRecord log_records[LOG_DEFERRED_RECORDS]; // Records awaiting log_drain()
+static std::atomic<uint32_t> log_write_position(0); // Next position claimed by a producer
+static uint32_t log_read_position = 0;              // Next position printed, consumer only
+static std::atomic<uint32_t> log_dropped_count(0);
+
+/**
+ * @brief Stores one record; a record is published whole or not at all.
+ *
+ * Producers claim positions with a compare-and-swap and never wait for each
+ * other: a producer that is preempted between claiming and publishing only
+ * holds back log_drain() at its record.
+ */
+bool log_write_record(LogLevel level, const char *format, const LogWord *args, uint8_t arg_count)
+{
+    uint32_t position = log_write_position.load(std::memory_order_relaxed);
+    LogRecord *record;
+    for (;;)
+    {
+        uint32_t index = position & LOG_DEFERRED_MASK;
+        record = &log_records[index];
+        int32_t lag = static_cast<int32_t>(record->sequence.load(std::memory_order_acquire) + index -
+                                           position);
+        if (lag == 0)
+        {
+            // Free: claim it, or retry with the position another producer left
+            if (log_write_position.compare_exchange_weak(position, position + 1,
+                                                         std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (lag < 0)
+        {
+            // Still holds the record of the previous lap
+            log_dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            position = log_write_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->format = format;
+    record->timestamp = get_current_time_ms();
+    record->level = static_cast<uint8_t>(level);
+    record->arg_count = arg_count;
+    for (uint8_t i = 0; i < arg_count; i++)
+    {
+        record->args[i] = args[i];
+    }
+    record->sequence.store(position + 1 - (position & LOG_DEFERRED_MASK), std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Formats queued records with printf, oldest first.
+ */
+uint16_t log_drain(uint16_t max_records)
+{
+    uint16_t drained = 0;
+    while (drained < max_records)
+    {
+        uint32_t index = log_read_position & LOG_DEFERRED_MASK;
+        LogRecord &record = log_records[index];
+        if (record.sequence.load(std::memory_order_acquire) + index != log_read_position + 1)
+        {
+            break; // Empty, or the next record is still being written
+        }
+
+        LogWord args[LOG_DEFERRED_MAX_ARGS] = {0};
+        for (uint8_t i = 0; i < record.arg_count; i++)
+        {
+            args[i] = record.args[i];
+        }
+
+        // Unused trailing arguments are ignored by printf
+        printf("%s[%u] ", log_level_prefix(static_cast<LogLevel>(record.level)),
+               static_cast<unsigned>(record.timestamp));
+        printf(record.format, args[0], args[1], args[2], args[3], args[4], args[5]);
+        printf("\n");
+
+        // Hand the slot to the producer of the next lap
+        record.sequence.store(log_read_position + LOG_DEFERRED_RECORDS - index,
+                              std::memory_order_release);
+        log_read_position++;
+        drained++;
+    }
+    return drained;
+}
+
+uint32_t log_get_dropped_count()
+{
+    return log_dropped_count.load(std::memory_order_relaxed);
+}
+
+} // namespace robust_serial
+
+#endif // LOG_BACKEND == LOG_BACKEND_DEFERRED
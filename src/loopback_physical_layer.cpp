@@ -0,0 +1,336 @@
+#include "loopback_physical_layer.hpp"
+#include <cstring> // For memset(), memcpy()
+
+namespace robust_serial
+{
+
+LoopbackPhysicalLayer::LoopbackPhysicalLayer()
+    : PhysicalLayer()
+    , peer_(NULL)
+    , config_()
+    , last_poll_us_(0)
+    , now_ns_(0)
+    , line_free_ns_(0)
+    , wire_head_(0)
+    , wire_length_(0)
+    , chunk_head_(0)
+    , chunk_count_(0)
+    , tx_running_(false)
+    , rx_span_(NULL)
+    , rx_span_length_(0)
+    , rx_span_received_(0)
+{
+    LoopbackConfig ideal;
+    memset(&ideal, 0, sizeof(ideal));
+    seed_random(ideal.seed);
+    configure(ideal);
+    reset_stats();
+}
+
+/**
+ * @brief Destructor for LoopbackPhysicalLayer.
+ */
+LoopbackPhysicalLayer::~LoopbackPhysicalLayer()
+{
+}
+
+void LoopbackPhysicalLayer::initialize()
+{
+    // Bytes in flight are lost, as on a line that was unplugged
+    wire_head_ = 0;
+    wire_length_ = 0;
+    chunk_head_ = 0;
+    chunk_count_ = 0;
+    line_free_ns_ = now_ns_;
+    burst_remaining_ = 0;
+    state_ = PHYSICAL_STATE_READY;
+    report_event(PHYSICAL_LAYER_EVENT_READY);
+}
+
+void LoopbackPhysicalLayer::deinitialize()
+{
+    state_ = PHYSICAL_STATE_INIT;
+}
+
+void LoopbackPhysicalLayer::connect(LoopbackPhysicalLayer &a, LoopbackPhysicalLayer &b)
+{
+    a.peer_ = &b;
+    b.peer_ = &a;
+}
+
+void LoopbackPhysicalLayer::configure(const LoopbackConfig &config)
+{
+    if (config.seed != config_.seed)
+    {
+        seed_random(config.seed);
+    }
+    config_ = config;
+    byte_ns_ = config.baud_rate ? 10000000000ull / config.baud_rate : 0;
+
+    // Probabilities per byte as fractions of 2^32
+    uint64_t bit_error = static_cast<uint64_t>(config.bit_error_ppb) * 34359738u / 1000000u; // * 8 * 2^32 / 10^9
+    bit_error_threshold_ = (bit_error > 0xFFFFFFFFu) ? 0xFFFFFFFFu : static_cast<uint32_t>(bit_error);
+    uint64_t burst = (static_cast<uint64_t>(config.burst_ppm) << 32) / 1000000u;
+    burst_threshold_ = (burst > 0xFFFFFFFFu) ? 0xFFFFFFFFu : static_cast<uint32_t>(burst);
+    burst_remaining_ = 0;
+}
+
+void LoopbackPhysicalLayer::reset_stats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/**
+ * @brief Starts the generator from a scrambled seed
+ *
+ * xorshift32 returns about seed * 270000 first, so small seeds used as they
+ * are would start every run with the same run of low values, i.e. errors.
+ * The seed goes through the murmur3 finalizer first.
+ */
+void LoopbackPhysicalLayer::seed_random(uint32_t seed)
+{
+    uint32_t x = seed + 0x9E3779B9u;
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    random_state_ = x ? x : 0x2545F491u; // xorshift32 stays at 0
+}
+
+/**
+ * @brief xorshift32, good enough for error injection and reproducible
+ */
+uint32_t LoopbackPhysicalLayer::random()
+{
+    uint32_t x = random_state_;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state_ = x;
+    return x;
+}
+
+/**
+ * @brief Accepts as many bytes as the transmitter FIFO and the wire can take
+ *
+ * The bytes occupy the line back to back after whatever is still being sent
+ * and arrive latency_us after their last bit. Errors are applied on the way
+ * in: a byte may get one bit flipped or, inside a loss burst, never arrive.
+ */
+int LoopbackPhysicalLayer::send(const uint8_t *data, uint16_t length)
+{
+    if (!peer_)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    if (!data)
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+
+    uint16_t accepted = length;
+    if (config_.max_write && accepted > config_.max_write)
+    {
+        accepted = config_.max_write;
+    }
+
+    // Bytes accepted earlier that are not on the line yet fill the FIFO
+    if (config_.tx_fifo_size && byte_ns_)
+    {
+        uint64_t queued = (line_free_ns_ > now_ns_) ? (line_free_ns_ - now_ns_ + byte_ns_ - 1) / byte_ns_ : 0;
+        uint16_t room = (queued >= config_.tx_fifo_size) ? 0 : static_cast<uint16_t>(config_.tx_fifo_size - queued);
+        if (accepted > room)
+        {
+            accepted = room;
+        }
+    }
+
+    if (accepted > LOOPBACK_BUFFER_SIZE - wire_length_)
+    {
+        accepted = LOOPBACK_BUFFER_SIZE - wire_length_;
+    }
+    if (chunk_count_ == LOOPBACK_MAX_CHUNKS)
+    {
+        accepted = 0;
+    }
+
+    if (accepted == 0)
+    {
+        stats_.busy_writes++;
+        return 0;
+    }
+    if (accepted < length)
+    {
+        stats_.partial_writes++;
+    }
+
+    put_on_wire(data, accepted);
+    return accepted;
+}
+
+/**
+ * @brief Queues accepted bytes on the wire, applying the line errors
+ */
+void LoopbackPhysicalLayer::put_on_wire(const uint8_t *data, uint16_t length)
+{
+    uint16_t stored = 0;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (burst_remaining_ == 0 && burst_threshold_ && random() < burst_threshold_)
+        {
+            burst_remaining_ = config_.burst_length;
+        }
+        if (burst_remaining_ > 0)
+        {
+            burst_remaining_--;
+            stats_.bytes_lost++;
+            continue;
+        }
+
+        uint8_t byte = data[i];
+        if (bit_error_threshold_ && random() < bit_error_threshold_)
+        {
+            byte ^= static_cast<uint8_t>(1u << (random() & 0x07));
+            stats_.bit_errors++;
+        }
+        wire_[(wire_head_ + wire_length_ + stored) % LOOPBACK_BUFFER_SIZE] = byte;
+        stored++;
+    }
+
+    uint64_t start = (line_free_ns_ > now_ns_) ? line_free_ns_ : now_ns_;
+    line_free_ns_ = start + length * byte_ns_;
+    stats_.bytes_tx += length;
+
+    if (stored > 0)
+    {
+        Chunk &chunk = chunks_[(chunk_head_ + chunk_count_) % LOOPBACK_MAX_CHUNKS];
+        chunk.arrival_ns = line_free_ns_ + static_cast<uint64_t>(config_.latency_us) * 1000;
+        chunk.length = stored;
+        chunk_count_++;
+        wire_length_ += stored;
+    }
+}
+
+int LoopbackPhysicalLayer::start_transmit(const uint8_t *data, uint16_t length)
+{
+    if (!peer_)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    if (!data || length == 0 || tx_running_)
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+    if (length > LOOPBACK_BUFFER_SIZE - wire_length_ || chunk_count_ == LOOPBACK_MAX_CHUNKS)
+    {
+        stats_.busy_writes++;
+        return PHYSICAL_ERROR_BUSY;
+    }
+
+    put_on_wire(data, length);
+    tx_running_ = true;
+    return PHYSICAL_SUCCESS;
+}
+
+int LoopbackPhysicalLayer::start_receive(uint8_t *buffer, uint16_t length)
+{
+    if (!buffer || length == 0)
+    {
+        return PHYSICAL_ERROR_INVALID_PARAM;
+    }
+
+    rx_span_ = buffer;
+    rx_span_length_ = length;
+    rx_span_received_ = 0;
+    return PHYSICAL_SUCCESS;
+}
+
+/**
+ * @brief Delivers every write that has arrived by now_us, in order
+ *
+ * A write is delivered as a whole when its last byte has arrived, as a UART
+ * driver with an idle-line interrupt would hand it over.
+ */
+void LoopbackPhysicalLayer::poll(uint32_t now_us)
+{
+    now_ns_ += static_cast<uint64_t>(now_us - last_poll_us_) * 1000;
+    last_poll_us_ = now_us;
+
+    while (chunk_count_ > 0 && chunks_[chunk_head_].arrival_ns <= now_ns_)
+    {
+        uint16_t length = chunks_[chunk_head_].length;
+        chunk_head_ = (chunk_head_ + 1) % LOOPBACK_MAX_CHUNKS;
+        chunk_count_--;
+
+        // At most two spans when the bytes wrap around the end of the ring
+        uint16_t first = LOOPBACK_BUFFER_SIZE - wire_head_;
+        if (first > length)
+        {
+            first = length;
+        }
+        peer_->on_receive(&wire_[wire_head_], first);
+        if (length > first)
+        {
+            peer_->on_receive(&wire_[0], length - first);
+        }
+
+        wire_head_ = (wire_head_ + length) % LOOPBACK_BUFFER_SIZE;
+        wire_length_ -= length;
+        stats_.bytes_rx += length;
+    }
+
+    // The TX-complete interrupt of a DMA transfer
+    if (tx_running_ && line_free_ns_ <= now_ns_)
+    {
+        tx_running_ = false;
+        transmit_complete();
+    }
+}
+
+int LoopbackPhysicalLayer::on_receive(const uint8_t *data, uint16_t length)
+{
+    if (config_.dma)
+    {
+        while (length > 0)
+        {
+            if (!rx_span_)
+            {
+                peer_->stats_.bytes_overrun += length;
+                return PHYSICAL_ERROR_OVERFLOW;
+            }
+
+            uint16_t chunk = rx_span_length_ - rx_span_received_;
+            if (chunk > length)
+            {
+                chunk = length;
+            }
+            memcpy(&rx_span_[rx_span_received_], data, chunk);
+            rx_span_received_ += chunk;
+            data += chunk;
+            length -= chunk;
+
+            if (rx_span_received_ == rx_span_length_)
+            {
+                // The DMA transfer-complete interrupt; it may start the next span
+                rx_span_ = NULL;
+                receive_complete();
+            }
+        }
+
+        // The idle-line interrupt at the end of the write
+        if (rx_span_ && rx_span_received_ > 0)
+        {
+            receive_progress(rx_span_received_);
+        }
+        return PHYSICAL_SUCCESS;
+    }
+
+    if (!up_layer)
+    {
+        return PHYSICAL_ERROR_NOT_INITIALIZED;
+    }
+    return up_layer->on_receive(data, length);
+}
+
+} // namespace robust_serial
@@ -0,0 +1,212 @@
+#include "lz.hpp"
+#include <cstring> // For memcpy(), memset()
+
+namespace robust_serial
+{
+
+/**
+ * @brief Hashes the three bytes at data into a match finder index.
+ */
+static inline uint16_t lz_hash(const uint8_t *data)
+{
+    uint32_t sequence = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+    return static_cast<uint16_t>((sequence * 2654435761u) >> (32 - LZ_HASH_BITS));
+}
+
+/**
+ * @brief Compresses data with greedy LZ77 matching.
+ *
+ * The table maps hashed three-byte sequences to their last position (plus
+ * one, 0 meaning none) in the input. At each position the remembered
+ * candidate is extended as far as it matches; anything not covered by a match
+ * is emitted as literal runs.
+ *
+ * @param input Pointer to input data buffer
+ * @param length Length of input data in bytes
+ * @param output Pointer to output buffer for compressed data
+ * @param output_size Length of output buffer in bytes
+ * @param table Match finder table of LZ_HASH_SIZE entries
+ * @return int Number of bytes written to output buffer, or negative error code:
+ *         LZ_ERROR_INVALID_PARAMETERS: Invalid parameters
+ *         LZ_ERROR_OUTPUT_TOO_SMALL: Output buffer too small
+ */
+int LZ::compress(const uint8_t *input, uint16_t length,
+                 uint8_t *output, uint16_t output_size, uint16_t *table)
+{
+    if (!input || !output || !table)
+    {
+        return LZ_ERROR_INVALID_PARAMETERS;
+    }
+
+    memset(table, 0, LZ_HASH_SIZE * sizeof(table[0]));
+
+    uint16_t read_index = 0;
+    uint16_t literal_start = 0;
+    uint16_t write_index = 0;
+
+    while (read_index + LZ_MIN_MATCH <= length)
+    {
+        uint16_t hash = lz_hash(&input[read_index]);
+        uint16_t candidate = table[hash];
+        table[hash] = read_index + 1;
+
+        if (candidate == 0 || read_index - (candidate - 1) > LZ_MAX_OFFSET ||
+            memcmp(&input[candidate - 1], &input[read_index], LZ_MIN_MATCH) != 0)
+        {
+            read_index++;
+            continue;
+        }
+
+        uint16_t match_start = candidate - 1;
+        uint16_t match_length = LZ_MIN_MATCH;
+        while (read_index + match_length < length && match_length < LZ_MAX_MATCH &&
+               input[match_start + match_length] == input[read_index + match_length])
+        {
+            match_length++;
+        }
+
+        if (put_literals(&input[literal_start], read_index - literal_start, output, write_index,
+                         output_size) < 0)
+        {
+            return LZ_ERROR_OUTPUT_TOO_SMALL;
+        }
+
+        // [1LLLOOOO | OFFSET_LOW (| EXTRA_LENGTH)]
+        uint16_t offset = read_index - match_start - 1;
+        uint8_t length_code = (match_length - LZ_MIN_MATCH < 7) ? match_length - LZ_MIN_MATCH : 7;
+        uint16_t token_size = (length_code == 7) ? 3 : 2;
+        if (write_index + token_size > output_size)
+        {
+            return LZ_ERROR_OUTPUT_TOO_SMALL;
+        }
+        output[write_index++] = 0x80 | (length_code << 4) | (offset >> 8);
+        output[write_index++] = offset & 0xFF;
+        if (length_code == 7)
+        {
+            output[write_index++] = match_length - (LZ_MIN_MATCH + 7);
+        }
+
+        // Remember the positions inside the match for later ones
+        uint16_t match_end = read_index + match_length;
+        for (read_index++; read_index < match_end; read_index++)
+        {
+            if (read_index + LZ_MIN_MATCH <= length)
+            {
+                table[lz_hash(&input[read_index])] = read_index + 1;
+            }
+        }
+        literal_start = read_index;
+    }
+
+    if (put_literals(&input[literal_start], length - literal_start, output, write_index,
+                     output_size) < 0)
+    {
+        return LZ_ERROR_OUTPUT_TOO_SMALL;
+    }
+
+    return write_index;
+}
+
+/**
+ * @brief Emits literal runs of at most LZ_MAX_LITERALS bytes each.
+ */
+int LZ::put_literals(const uint8_t *literals, uint16_t count,
+                     uint8_t *output, uint16_t &write_index, uint16_t output_size)
+{
+    while (count > 0)
+    {
+        uint16_t run = (count > LZ_MAX_LITERALS) ? LZ_MAX_LITERALS : count;
+        if (write_index + 1 + run > output_size)
+        {
+            return LZ_ERROR_OUTPUT_TOO_SMALL;
+        }
+        output[write_index++] = static_cast<uint8_t>(run - 1);
+        memcpy(&output[write_index], literals, run);
+        write_index += run;
+        literals += run;
+        count -= run;
+    }
+    return LZ_SUCCESS;
+}
+
+/**
+ * @brief Decompresses data produced by compress().
+ *
+ * Every token is checked against both buffers, so corrupted input yields an
+ * error rather than reads or writes out of bounds.
+ *
+ * @param input Pointer to compressed data
+ * @param length Length of compressed data in bytes
+ * @param output Pointer to output buffer for decompressed data
+ * @param output_size Length of output buffer in bytes
+ * @return int Number of bytes written to output buffer, or negative error code:
+ *         LZ_ERROR_INVALID_PARAMETERS: Invalid parameters
+ *         LZ_ERROR_MALFORMED: Truncated token or offset before the start
+ *         LZ_ERROR_OUTPUT_TOO_SMALL: Output buffer too small
+ */
+int LZ::decompress(const uint8_t *input, uint16_t length,
+                   uint8_t *output, uint16_t output_size)
+{
+    if (!input || !output)
+    {
+        return LZ_ERROR_INVALID_PARAMETERS;
+    }
+
+    uint16_t read_index = 0;
+    uint16_t write_index = 0;
+
+    while (read_index < length)
+    {
+        uint8_t token = input[read_index++];
+
+        if (token < 0x80)
+        {
+            uint16_t run = token + 1;
+            if (read_index + run > length)
+            {
+                return LZ_ERROR_MALFORMED;
+            }
+            if (write_index + run > output_size)
+            {
+                return LZ_ERROR_OUTPUT_TOO_SMALL;
+            }
+            memcpy(&output[write_index], &input[read_index], run);
+            read_index += run;
+            write_index += run;
+            continue;
+        }
+
+        uint8_t length_code = (token >> 4) & 0x07;
+        if (read_index + ((length_code == 7) ? 2 : 1) > length)
+        {
+            return LZ_ERROR_MALFORMED;
+        }
+        uint16_t offset = ((static_cast<uint16_t>(token & 0x0F) << 8) | input[read_index++]) + 1;
+        uint16_t match_length = LZ_MIN_MATCH + length_code;
+        if (length_code == 7)
+        {
+            match_length += input[read_index++];
+        }
+
+        if (offset > write_index)
+        {
+            return LZ_ERROR_MALFORMED;
+        }
+        if (write_index + match_length > output_size)
+        {
+            return LZ_ERROR_OUTPUT_TOO_SMALL;
+        }
+
+        // Byte by byte: the match may overlap the bytes it produces
+        const uint8_t *source = &output[write_index - offset];
+        for (uint16_t i = 0; i < match_length; i++)
+        {
+            output[write_index + i] = source[i];
+        }
+        write_index += match_length;
+    }
+
+    return write_index;
+}
+
+} // namespace robust_serial
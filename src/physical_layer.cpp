@@ -0,0 +1,31 @@
+#include "physical_layer.hpp"
+#include "link_layer.hpp"
+
+namespace robust_serial
+{
+
+void PhysicalLayer::transmit_complete()
+{
+    if (link_layer_)
+    {
+        link_layer_->on_transmit_complete();
+    }
+}
+
+void PhysicalLayer::receive_progress(uint16_t received)
+{
+    if (link_layer_)
+    {
+        link_layer_->on_receive_progress(received);
+    }
+}
+
+void PhysicalLayer::receive_complete()
+{
+    if (link_layer_)
+    {
+        link_layer_->on_receive_complete();
+    }
+}
+
+} // namespace robust_serial
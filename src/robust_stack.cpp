@@ -4,13 +4,38 @@
 namespace robust_serial
 {
 
-RobustStack::RobustStack(PhysicalLayer &phy)
-    : phy_layer_(phy)
+RobustStack::RobustStack(PhysicalLayer &phy, const RobustStackBuffers &buffers)
+    : link_layer_(buffers.link)
+    , phy_layer_(phy)
+    , state_(ROBUST_STACK_STATE_INIT)
     , event_callback_(NULL)
     , data_callback_(NULL)
     , datagram_callback_(NULL)
-    , state_(ROBUST_STACK_STATE_INIT)
+    , message_callback_(NULL)
+    , notify_callback_(NULL)
+    , channel_event_callback_(NULL)
+    , channel_data_callback_(NULL)
+    , loan_callback_(NULL)
+    , event_context_(NULL)
+    , data_context_(NULL)
+    , datagram_context_(NULL)
+    , message_context_(NULL)
+    , notify_context_(NULL)
+    , channel_event_context_(NULL)
+    , channel_data_context_(NULL)
+    , loan_context_(NULL)
+    , loan_pool_(NULL)
+    , loans_missed_(0)
 {
+    // Channel numbers follow the order of attachment
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].set_window(&buffers.tx_windows[i * buffers.window_size],
+                                        &buffers.rx_windows[i * buffers.window_size], buffers.window_size);
+        transport_layers_[i].set_timer_wheel(&timer_wheel_);
+        transport_mux_.attach(&transport_layers_[i]);
+    }
+    update_data_events();
 }
 
 /**
@@ -28,16 +53,37 @@ void RobustStack::initialize()
     // Initialize all layers
     phy_layer_.initialize();
     link_layer_.initialize();
-    transport_layer_.initialize();
+#if ROBUST_STACK_COMPRESSION
+    compression_layer_.initialize();
+#endif
+    transport_mux_.initialize();
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].initialize();
+    }
 
-    // Connect layers together
+    // Connect layers together; the transports were attached to the
+    // multiplexer on construction
     link_layer_.set_down_layer(&phy_layer_);
-    transport_layer_.set_down_layer(&link_layer_);
+#if ROBUST_STACK_COMPRESSION
+    compression_layer_.set_down_layer(&link_layer_);
+    transport_mux_.set_down_layer(&compression_layer_, &link_layer_);
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].set_options(transport_layers_[i].get_local_options() | TRANSPORT_OPTION_COMPRESSION);
+    }
+#else
+    transport_mux_.set_down_layer(&link_layer_);
+#endif
 
     // Set stack manager for all layers
     phy_layer_.set_stack_manager(this);
     link_layer_.set_stack_manager(this);
-    transport_layer_.set_stack_manager(this);
+    transport_mux_.set_stack_manager(this);
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].set_stack_manager(this);
+    }
 
     // Set initial state
     set_state(ROBUST_STACK_STATE_READY);
@@ -53,12 +99,26 @@ void RobustStack::reset()
     // Reset all layers
     phy_layer_.deinitialize();
     link_layer_.deinitialize();
-    transport_layer_.deinitialize();
+#if ROBUST_STACK_COMPRESSION
+    compression_layer_.deinitialize();
+#endif
+    transport_mux_.deinitialize();
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].deinitialize();
+    }
 
     // Initialize all layers
     phy_layer_.initialize();
     link_layer_.initialize();
-    transport_layer_.initialize();
+#if ROBUST_STACK_COMPRESSION
+    compression_layer_.initialize();
+#endif
+    transport_mux_.initialize();
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].initialize();
+    }
 
     // Reset state
     set_state(ROBUST_STACK_STATE_READY);
@@ -95,7 +155,7 @@ int RobustStack::connect()
     set_state(ROBUST_STACK_STATE_CONNECTING);
     
     // Delegate connection to transport layer
-    int result = transport_layer_.connect();
+    int result = transport_layers_[0].connect();
     if (result < 0)
     {
         set_state(ROBUST_STACK_STATE_ERROR);
@@ -105,6 +165,23 @@ int RobustStack::connect()
     return result;
 }
 
+/**
+ * @brief Initiates a connection on a channel.
+ * @return 0 on success, error code on failure
+ */
+int RobustStack::connect(uint8_t channel)
+{
+    if (channel == 0)
+    {
+        return connect();
+    }
+    if (channel >= TRANSPORT_MAX_CONNECTIONS)
+    {
+        return ROBUST_ERROR_INVALID_PARAM;
+    }
+    return transport_layers_[channel].connect();
+}
+
 /**
  * @brief Handles disconnection.
  * @return 0 on success, error code on failure
@@ -121,7 +198,7 @@ int RobustStack::disconnect()
     }
 
     // Delegate disconnection to transport layer
-    int result = transport_layer_.disconnect();
+    int result = transport_layers_[0].disconnect();
     if (result >= 0)
     {
         set_state(ROBUST_STACK_STATE_READY);
@@ -136,6 +213,23 @@ int RobustStack::disconnect()
     return result;
 }
 
+/**
+ * @brief Disconnects a channel.
+ * @return 0 on success, error code on failure
+ */
+int RobustStack::disconnect(uint8_t channel)
+{
+    if (channel == 0)
+    {
+        return disconnect();
+    }
+    if (channel >= TRANSPORT_MAX_CONNECTIONS)
+    {
+        return ROBUST_ERROR_INVALID_PARAM;
+    }
+    return transport_layers_[channel].disconnect();
+}
+
 /**
  * @brief Sends data through the stack.
  */
@@ -151,7 +245,53 @@ int RobustStack::send(const uint8_t *data, uint16_t length)
         return LAYER_ERROR_INVALID_STATE;
     }
 
-    int result = transport_layer_.send(data, length);
+    int result = transport_layers_[0].send(data, length);
+    if (result >= 0)
+    {
+        report_event(ROBUST_STACK_EVENT_DATA_SENT);
+    }
+    return result;
+}
+
+/**
+ * @brief Sends data on a channel.
+ */
+int RobustStack::send(uint8_t channel, const uint8_t *data, uint16_t length)
+{
+    if (channel == 0)
+    {
+        return send(data, length);
+    }
+
+    if (channel >= TRANSPORT_MAX_CONNECTIONS || !data || length == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    int result = transport_layers_[channel].send(data, length);
+    if (result >= 0)
+    {
+        report_event(channel, ROBUST_STACK_EVENT_DATA_SENT);
+    }
+    return result;
+}
+
+/**
+ * @brief Sends a payload scattered over several buffers.
+ */
+int RobustStack::send_v(const LayerSegment *segments, uint8_t count)
+{
+    if (!segments || count == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (state_ != ROBUST_STACK_STATE_CONNECTED)
+    {
+        return LAYER_ERROR_INVALID_STATE;
+    }
+
+    int result = transport_layers_[0].send_v(segments, count);
     if (result >= 0)
     {
         report_event(ROBUST_STACK_EVENT_DATA_SENT);
@@ -159,6 +299,68 @@ int RobustStack::send(const uint8_t *data, uint16_t length)
     return result;
 }
 
+/**
+ * @brief Sends a payload scattered over several buffers on a channel.
+ */
+int RobustStack::send_v(uint8_t channel, const LayerSegment *segments, uint8_t count)
+{
+    if (channel == 0)
+    {
+        return send_v(segments, count);
+    }
+
+    if (channel >= TRANSPORT_MAX_CONNECTIONS || !segments || count == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    int result = transport_layers_[channel].send_v(segments, count);
+    if (result >= 0)
+    {
+        report_event(channel, ROBUST_STACK_EVENT_DATA_SENT);
+    }
+    return result;
+}
+
+/**
+ * @brief Sends a message of any length, segmented by the transport layer.
+ *
+ * ROBUST_STACK_EVENT_DATA_SENT is reported once the last segment has entered
+ * the send window; until then the data buffer must not be modified.
+ */
+int RobustStack::send_message(const uint8_t *data, uint32_t length)
+{
+    if (!data || length == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (state_ != ROBUST_STACK_STATE_CONNECTED)
+    {
+        return LAYER_ERROR_INVALID_STATE;
+    }
+
+    return transport_layers_[0].send_message(data, length);
+}
+
+/**
+ * @brief Sends a message of any length on a channel.
+ */
+int RobustStack::send_message(uint8_t channel, const uint8_t *data, uint32_t length)
+{
+    if (channel == 0)
+    {
+        return send_message(data, length);
+    }
+
+    if (channel >= TRANSPORT_MAX_CONNECTIONS || !data || length == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    return transport_layers_[channel].send_message(data, length);
+}
+
 /**
  * @brief Sends data directly to the transport layer.
  */
@@ -174,18 +376,101 @@ int RobustStack::send_datagram(const uint8_t *data, uint16_t length)
         return LAYER_ERROR_INVALID_STATE;
     }
 
-    int result = transport_layer_.send_datagram(data, length);
+    int result = transport_layers_[0].send_datagram(data, length);
+    if (result >= 0)
+    {
+        report_event(ROBUST_STACK_EVENT_DATA_SENT);
+    }
+    return result;
+}
+
+/**
+ * @brief Sends a datagram scattered over several buffers.
+ */
+int RobustStack::send_datagram_v(const LayerSegment *segments, uint8_t count)
+{
+    if (!segments || count == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (state_ != ROBUST_STACK_STATE_READY && state_ != ROBUST_STACK_STATE_CONNECTED)
+    {
+        return LAYER_ERROR_INVALID_STATE;
+    }
+
+    int result = transport_layers_[0].send_datagram_v(segments, count);
+    if (result >= 0)
+    {
+        report_event(ROBUST_STACK_EVENT_DATA_SENT);
+    }
+    return result;
+}
+
+#if TRANSPORT_DELTA_STREAMS
+/**
+ * @brief Sends a datagram of a delta-encoded stream.
+ */
+int RobustStack::send_datagram_delta(uint8_t stream, const uint8_t *data, uint16_t length)
+{
+    if (!data || length == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (state_ != ROBUST_STACK_STATE_READY && state_ != ROBUST_STACK_STATE_CONNECTED)
+    {
+        return LAYER_ERROR_INVALID_STATE;
+    }
+
+    int result = transport_layers_[0].send_datagram_delta(stream, data, length);
     if (result >= 0)
     {
         report_event(ROBUST_STACK_EVENT_DATA_SENT);
     }
     return result;
 }
+#endif
 
 /**
- * @brief Processes received data from the transport layer.
+ * @brief Sends several datagrams, notifying the task once.
+ */
+int RobustStack::send_many(const LayerSegment *datagrams, uint8_t count)
+{
+    if (!datagrams || count == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    int sent = 0;
+    int result = LAYER_SUCCESS;
+    begin_batch();
+    while (sent < count)
+    {
+        result = send_datagram(datagrams[sent].data, datagrams[sent].length);
+        if (result < 0)
+        {
+            break;
+        }
+        sent++;
+    }
+    end_batch();
+
+    return (sent > 0) ? sent : result;
+}
+
+/**
+ * @brief Processes received data from the transport layer of channel 0.
  */
 int RobustStack::on_receive(const uint8_t *data, uint16_t length)
+{
+    return on_receive(0, data, length);
+}
+
+/**
+ * @brief Processes received data from the transport layer of a channel.
+ */
+int RobustStack::on_receive(uint8_t channel, const uint8_t *data, uint16_t length)
 {
     if (!data || length == 0)
     {
@@ -193,15 +478,93 @@ int RobustStack::on_receive(const uint8_t *data, uint16_t length)
     }
 
     // Regular data packet
-    if (data_callback_)
+    if (!deliver(channel, data, length))
     {
-        data_callback_(data, length);
+        return LAYER_ERROR_BUSY;
     }
-    report_event(ROBUST_STACK_EVENT_DATA_RECEIVED);
+    report_event(channel, ROBUST_STACK_EVENT_DATA_RECEIVED);
 
     return LAYER_SUCCESS;
 }
 
+/**
+ * @brief Processes a message reassembled by the transport layer.
+ * @param data Pointer to the message in the reassembly buffer
+ * @param length Length of the message
+ * @return LAYER_SUCCESS on success, error code on failure
+ */
+int RobustStack::on_message(const uint8_t *data, uint32_t length)
+{
+    return on_message(0, data, length);
+}
+
+/**
+ * @brief Processes a message reassembled by the transport layer of a channel.
+ */
+int RobustStack::on_message(uint8_t channel, const uint8_t *data, uint32_t length)
+{
+    if (!data || length == 0)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    if (!deliver(channel, data, length))
+    {
+        return LAYER_ERROR_BUSY;
+    }
+    report_event(channel, ROBUST_STACK_EVENT_DATA_RECEIVED);
+
+    return LAYER_SUCCESS;
+}
+
+/**
+ * @brief Hands reliable data to the loan callback or the first data callback that takes it
+ *
+ * @return false if the data has to wait for a loaned buffer to be released;
+ *         the transport layer then holds it and delivers it again
+ */
+bool RobustStack::deliver(uint8_t channel, const uint8_t *data, uint32_t length)
+{
+    if (loan_callback_ && loan_pool_)
+    {
+        if (length <= loan_pool_->buffer_size())
+        {
+            RxBuffer *buffer = loan_pool_->acquire();
+            if (!buffer)
+            {
+                return false;
+            }
+            memcpy(buffer->data, data, length);
+            buffer->length = length;
+            buffer->channel = channel;
+            loan_callback_(loan_context_, buffer);
+            return true;
+        }
+
+        // Too long for a buffer: passed to the data callbacks once the data
+        // before it has been processed, so it does not overtake it
+        if (loan_pool_->available() < loan_pool_->count())
+        {
+            return false;
+        }
+        loans_missed_++;
+    }
+
+    if (channel_data_callback_)
+    {
+        channel_data_callback_(channel_data_context_, channel, data, length);
+    }
+    else if (channel == 0 && message_callback_)
+    {
+        message_callback_(message_context_, data, length);
+    }
+    else if (channel == 0 && data_callback_ && length <= 0xFFFF)
+    {
+        data_callback_(data_context_, data, static_cast<uint16_t>(length));
+    }
+    return true;
+}
+
 /**
  * @brief Processes received datagram data and calls the user's datagram callback.
  * @param data Pointer to the datagram data
@@ -210,6 +573,16 @@ int RobustStack::on_receive(const uint8_t *data, uint16_t length)
  */
 int RobustStack::on_datagram(const uint8_t *data, uint16_t length)
 {
+    return on_datagram(0, data, length);
+}
+
+/**
+ * @brief Processes a received datagram; datagrams are not bound to a channel.
+ */
+int RobustStack::on_datagram(uint8_t channel, const uint8_t *data, uint16_t length)
+{
+    (void)channel;
+
     if (!data || length == 0)
     {
         return LAYER_ERROR_INVALID_PARAM;
@@ -218,7 +591,7 @@ int RobustStack::on_datagram(const uint8_t *data, uint16_t length)
     // Call the user's datagram callback if set
     if (datagram_callback_)
     {
-        datagram_callback_(data, length);
+        datagram_callback_(datagram_context_, data, length);
     }
 
     report_event(ROBUST_STACK_EVENT_DATAGRAM_RECEIVED);
@@ -230,7 +603,20 @@ int RobustStack::on_datagram(const uint8_t *data, uint16_t length)
  */
 void RobustStack::set_timeout(uint32_t keepalive_ms, uint32_t timeout_ms)
 {
-    transport_layer_.set_timeout(keepalive_ms, timeout_ms);
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transport_layers_[i].set_timeout(keepalive_ms, timeout_ms);
+    }
+}
+
+void RobustStack::set_session_resumption(bool enable)
+{
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        uint8_t options = transport_layers_[i].get_local_options();
+        transport_layers_[i].set_options(enable ? (options | TRANSPORT_OPTION_RESUME)
+                                                : (options & ~TRANSPORT_OPTION_RESUME));
+    }
 }
 
 /**
@@ -238,15 +624,24 @@ void RobustStack::set_timeout(uint32_t keepalive_ms, uint32_t timeout_ms)
  */
 void RobustStack::on_layer_event(Layer *source_layer, int32_t event_code, void *parameter)
 {
-    if (source_layer == &transport_layer_)
+    // The link layer reports for every frame queued or received, so it is
+    // matched first
+    if (source_layer == &link_layer_)
     {
-        on_transport_layer_event(event_code, parameter);
+        on_link_layer_event(event_code, parameter);
+        return;
     }
-    else if (source_layer == &link_layer_)
+
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
     {
-        on_link_layer_event(event_code, parameter);
+        if (source_layer == &transport_layers_[i])
+        {
+            on_transport_layer_event(i, event_code, parameter);
+            return;
+        }
     }
-    else if (source_layer == &phy_layer_)
+
+    if (source_layer == &phy_layer_)
     {
         on_physical_layer_event(event_code, parameter);
     }
@@ -255,31 +650,73 @@ void RobustStack::on_layer_event(Layer *source_layer, int32_t event_code, void *
 /**
  * @brief Handles events from the transport layer.
  */
-void RobustStack::on_transport_layer_event(int32_t event_code, void *parameter)
+void RobustStack::on_transport_layer_event(uint8_t channel, int32_t event_code, void *parameter)
 {
+    (void)parameter;
+
+#if ROBUST_STACK_COMPRESSION
+    // A connection coming or going may change what the peers agreed to
+    update_compression();
+#endif
+
+    // The stack state follows channel 0
     switch (event_code)
     {
     case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_CONNECTED):
-        log_info("RobustStack: connected");
-        set_state(ROBUST_STACK_STATE_CONNECTED);
-        report_event(ROBUST_STACK_EVENT_CONNECTED);
+        log_info("RobustStack: connected (channel %d)", channel);
+        if (channel == 0)
+        {
+            set_state(ROBUST_STACK_STATE_CONNECTED);
+        }
+        report_event(channel, ROBUST_STACK_EVENT_CONNECTED);
         break;
 
     case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_DISCONNECTED):
-        log_info("RobustStack: disconnected");
-        set_state(ROBUST_STACK_STATE_READY);
-        report_event(ROBUST_STACK_EVENT_DISCONNECTED);
+        log_info("RobustStack: disconnected (channel %d)", channel);
+        if (channel == 0)
+        {
+            set_state(ROBUST_STACK_STATE_READY);
+        }
+        report_event(channel, ROBUST_STACK_EVENT_DISCONNECTED);
         break;
 
     case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_ERROR):
-        log_info("RobustStack: error");
-        set_state(ROBUST_STACK_STATE_ERROR);
-        report_event(ROBUST_STACK_EVENT_ERROR);
+        log_info("RobustStack: error (channel %d)", channel);
+        if (channel == 0)
+        {
+            set_state(ROBUST_STACK_STATE_ERROR);
+        }
+        report_event(channel, ROBUST_STACK_EVENT_ERROR);
         break;
     case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_TIMEOUT):
-        log_info("RobustStack: timeout");
-        set_state(ROBUST_STACK_STATE_ERROR);
-        report_event(ROBUST_STACK_EVENT_TIMEOUT);
+        log_info("RobustStack: timeout (channel %d)", channel);
+        if (channel == 0)
+        {
+            set_state(ROBUST_STACK_STATE_ERROR);
+        }
+        report_event(channel, ROBUST_STACK_EVENT_TIMEOUT);
+        break;
+
+    case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_SUSPENDED):
+        log_info("RobustStack: suspended (channel %d)", channel);
+        if (channel == 0)
+        {
+            set_state(ROBUST_STACK_STATE_CONNECTING);
+        }
+        report_event(channel, ROBUST_STACK_EVENT_SUSPENDED);
+        break;
+
+    case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_RESUMED):
+        log_info("RobustStack: resumed (channel %d)", channel);
+        if (channel == 0)
+        {
+            set_state(ROBUST_STACK_STATE_CONNECTED);
+        }
+        report_event(channel, ROBUST_STACK_EVENT_RESUMED);
+        break;
+
+    case static_cast<int32_t>(TRANSPORT_LAYER_EVENT_MESSAGE_SENT):
+        report_event(channel, ROBUST_STACK_EVENT_DATA_SENT);
         break;
 
     default:
@@ -292,6 +729,8 @@ void RobustStack::on_transport_layer_event(int32_t event_code, void *parameter)
  */
 void RobustStack::on_link_layer_event(int32_t event_code, void *parameter)
 {
+    (void)parameter;
+
     // Handle link layer specific events
     switch (event_code)
     {
@@ -310,11 +749,13 @@ void RobustStack::on_link_layer_event(int32_t event_code, void *parameter)
     case static_cast<int32_t>(LINK_LAYER_EVENT_OUTGOING_DATA_AVAILABLE):
         //log_info("RobustStack: Outgoing data available");
         report_event(ROBUST_STACK_EVENT_OUTGOING_DATA_AVAILABLE);
+        notify();
         break;
 
     case static_cast<int32_t>(LINK_LAYER_EVENT_INCOMING_DATA_AVAILABLE):
         //log_info("RobustStack: Incoming data available");
         report_event(ROBUST_STACK_EVENT_INCOMING_DATA_AVAILABLE);
+        notify();
         break;
     default:
         break;
@@ -326,6 +767,8 @@ void RobustStack::on_link_layer_event(int32_t event_code, void *parameter)
  */
 void RobustStack::on_physical_layer_event(int32_t event_code, void *parameter)
 {
+    (void)parameter;
+
     // Handle physical layer specific events
     switch (event_code)
     {
@@ -350,6 +793,30 @@ void RobustStack::set_state(RobustStackState new_state)
     state_ = new_state;
 }
 
+#if ROBUST_STACK_COMPRESSION
+/**
+ * @brief Compresses outgoing frames only while every connected peer decompresses.
+ */
+void RobustStack::update_compression()
+{
+    bool enabled = false;
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        if (!transport_layers_[i].is_connected())
+        {
+            continue;
+        }
+        if (!(transport_layers_[i].get_options() & TRANSPORT_OPTION_COMPRESSION))
+        {
+            enabled = false;
+            break;
+        }
+        enabled = true;
+    }
+    compression_layer_.set_enabled(enabled);
+}
+#endif
+
 /**
  * @brief Calls the user callback if it is set.
  */
@@ -357,7 +824,22 @@ void RobustStack::report_event(RobustStackEvent event)
 {
     if (event_callback_ != NULL)
     {
-        event_callback_(event);
+        event_callback_(event_context_, event);
+    }
+}
+
+/**
+ * @brief Calls the channel event callback, and the user callback for channel 0.
+ */
+void RobustStack::report_event(uint8_t channel, RobustStackEvent event)
+{
+    if (channel_event_callback_ != NULL)
+    {
+        channel_event_callback_(channel_event_context_, channel, event);
+    }
+    if (channel == 0)
+    {
+        report_event(event);
     }
 }
 
@@ -366,12 +848,41 @@ void RobustStack::report_event(RobustStackEvent event)
  */
 void RobustStack::tick()
 {
-    transport_layer_.tick();
+    transport_mux_.tick();
+}
+
+/**
+ * @brief Reports how long the task driving the stack may sleep.
+ */
+uint32_t RobustStack::get_next_deadline() const
+{
+    if (link_layer_.has_incoming_data())
+    {
+        return 0;
+    }
+    return transport_mux_.get_next_deadline();
+}
+
+/**
+ * @brief Wakes the task driving the stack, if a notify callback is set.
+ */
+void RobustStack::notify()
+{
+    if (notify_callback_ != NULL)
+    {
+        notify_callback_(notify_context_);
+    }
 }
 
 int RobustStack::process_outgoing_data()
 {
-    return link_layer_.process_outgoing_data();
+    int result = link_layer_.process_outgoing_data();
+    if (result > 0)
+    {
+        // What the transports could not queue earlier may fit now
+        transport_mux_.on_link_space();
+    }
+    return result;
 }
 
 int RobustStack::process_incoming_data()
@@ -406,7 +917,7 @@ int RobustStack::listen()
     set_state(ROBUST_STACK_STATE_CONNECTING);
     
     // Delegate listening to transport layer
-    int result = transport_layer_.listen();
+    int result = transport_layers_[0].listen();
     if (result < 0)
     {
         set_state(ROBUST_STACK_STATE_ERROR);
@@ -416,4 +927,20 @@ int RobustStack::listen()
     return result;
 }
 
+/**
+ * @brief Starts listening on a channel.
+ */
+int RobustStack::listen(uint8_t channel)
+{
+    if (channel == 0)
+    {
+        return listen();
+    }
+    if (channel >= TRANSPORT_MAX_CONNECTIONS)
+    {
+        return ROBUST_ERROR_INVALID_PARAM;
+    }
+    return transport_layers_[channel].listen();
+}
+
 } // namespace robust_serial
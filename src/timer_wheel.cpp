@@ -0,0 +1,284 @@
+#include "timer_wheel.hpp"
+
+namespace robust_serial
+{
+
+// Timer::level_ of a timer on the expired list, and of one being fired
+#define TIMER_LEVEL_EXPIRED TIMER_WHEEL_LEVELS
+#define TIMER_LEVEL_DUE 0xFF
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN ((1u << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1) // Farthest filed delay
+
+static void link_timer(Timer **head, Timer *timer, Timer *&next, Timer **&pprev)
+{
+    next = *head;
+    *head = timer;
+    pprev = head;
+}
+
+TimerWheel::TimerWheel()
+    : expired_(NULL)
+    , now_(0)
+    , count_(0)
+{
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        occupied_[level] = 0;
+        for (uint8_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+        {
+            slots_[level][slot] = NULL;
+        }
+    }
+}
+
+void TimerWheel::start(Timer &timer, uint32_t expiry, uint32_t now)
+{
+    if (timer.is_active())
+    {
+        unlink(timer);
+    }
+    else
+    {
+        // An empty wheel may have been left behind by the clock
+        if (count_ == 0)
+        {
+            now_ = now;
+        }
+        count_++;
+    }
+
+    timer.expiry_ = expiry;
+    insert(timer, &expired_);
+}
+
+void TimerWheel::stop(Timer &timer)
+{
+    if (timer.is_active())
+    {
+        unlink(timer);
+        count_--;
+    }
+}
+
+/**
+ * @brief Files a timer relative to now_; one that is due goes to the due list
+ */
+void TimerWheel::insert(Timer &timer, Timer **due)
+{
+    uint32_t delay = timer.expiry_ - now_;
+    Timer **head;
+    if (static_cast<int32_t>(delay) <= 0)
+    {
+        timer.level_ = (due == &expired_) ? TIMER_LEVEL_EXPIRED : TIMER_LEVEL_DUE;
+        head = due;
+    }
+    else
+    {
+        // The lowest level whose ring covers the delay; beyond the last
+        // level, its farthest slot
+        uint32_t position = (delay > TIMER_WHEEL_SPAN) ? now_ + TIMER_WHEEL_SPAN : timer.expiry_;
+        uint8_t level = 0;
+        while (level < TIMER_WHEEL_LEVELS - 1 && (delay >> ((level + 1) * TIMER_WHEEL_SLOT_BITS)) != 0)
+        {
+            level++;
+        }
+
+        uint8_t slot = (position >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_MASK;
+        timer.level_ = level;
+        timer.slot_ = slot;
+        head = &slots_[level][slot];
+        occupied_[level] |= (1u << slot);
+    }
+
+    if (*head)
+    {
+        (*head)->pprev_ = &timer.next_;
+    }
+    link_timer(head, &timer, timer.next_, timer.pprev_);
+}
+
+void TimerWheel::unlink(Timer &timer)
+{
+    *timer.pprev_ = timer.next_;
+    if (timer.next_)
+    {
+        timer.next_->pprev_ = timer.pprev_;
+    }
+    timer.next_ = NULL;
+    timer.pprev_ = NULL;
+
+    if (timer.level_ < TIMER_WHEEL_LEVELS && !slots_[timer.level_][timer.slot_])
+    {
+        occupied_[timer.level_] &= ~(1u << timer.slot_);
+    }
+}
+
+/**
+ * @brief Finds the delay from now_ to the next slot that must be processed
+ *
+ * A slot of level k is processed when its 2^(k * bits) ms wide bucket
+ * begins: its timers expire (level 0) or move down a level.
+ */
+bool TimerWheel::next_event(uint32_t &delay) const
+{
+    bool found = false;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if (!occupied_[level])
+        {
+            continue;
+        }
+
+        // First occupied slot after the current one, going round once
+        uint8_t shift = level * TIMER_WHEEL_SLOT_BITS;
+        uint32_t bucket = now_ >> shift;
+        uint32_t distance = 1;
+        while (!(occupied_[level] & (1u << ((bucket + distance) & TIMER_WHEEL_MASK))))
+        {
+            distance++;
+        }
+
+        uint32_t level_delay = ((bucket + distance) << shift) - now_;
+        if (!found || level_delay < delay)
+        {
+            delay = level_delay;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void TimerWheel::advance(uint32_t now)
+{
+    // What was started for a past time, typically a retry
+    Timer *due = expired_;
+    expired_ = NULL;
+    if (due)
+    {
+        due->pprev_ = &due;
+    }
+    for (Timer *timer = due; timer; timer = timer->next_)
+    {
+        timer->level_ = TIMER_LEVEL_DUE;
+    }
+    fire(due);
+
+    uint32_t delay;
+    while (static_cast<int32_t>(now - now_) > 0)
+    {
+        if (!next_event(delay) || delay > now - now_)
+        {
+            now_ = now;
+            break;
+        }
+        now_ += delay;
+
+        // Levels whose bucket begins now move their slot down, from the top so
+        // that a timer can pass through several levels at once
+        for (uint8_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            uint8_t shift = level * TIMER_WHEEL_SLOT_BITS;
+            if (now_ & ((1u << shift) - 1))
+            {
+                continue;
+            }
+
+            uint8_t slot = (now_ >> shift) & TIMER_WHEEL_MASK;
+            Timer *moving = slots_[level][slot];
+            slots_[level][slot] = NULL;
+            occupied_[level] &= ~(1u << slot);
+            while (moving)
+            {
+                Timer *timer = moving;
+                moving = timer->next_;
+                insert(*timer, &due);
+            }
+        }
+
+        uint8_t slot = now_ & TIMER_WHEEL_MASK;
+        while (slots_[0][slot])
+        {
+            Timer *timer = slots_[0][slot];
+            unlink(*timer);
+            timer->level_ = TIMER_LEVEL_DUE;
+            if (due)
+            {
+                due->pprev_ = &timer->next_;
+            }
+            link_timer(&due, timer, timer->next_, timer->pprev_);
+        }
+        fire(due);
+    }
+}
+
+/**
+ * @brief Runs the callbacks of a list of due timers, which may change it meanwhile
+ */
+void TimerWheel::fire(Timer *&due)
+{
+    while (due)
+    {
+        Timer *timer = due;
+        unlink(*timer);
+        count_--;
+        timer->callback_(timer->context_);
+    }
+}
+
+/**
+ * @brief Finds the earliest expiry, going through each level's slots in order
+ *
+ * No timer of a slot expires before its bucket begins, so a level is left at
+ * the first slot that begins after the earliest expiry found so far. That is
+ * normally the slot after the first occupied one: only timers beyond the
+ * last level, which wait in a slot that begins before they expire, make it
+ * look further.
+ */
+uint32_t TimerWheel::get_next_deadline(uint32_t now) const
+{
+    if (expired_)
+    {
+        return 0;
+    }
+
+    bool found = false;
+    uint32_t delay = 0;
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        uint8_t shift = level * TIMER_WHEEL_SLOT_BITS;
+        uint32_t bucket = now_ >> shift;
+        for (uint32_t distance = 1; occupied_[level] && distance <= TIMER_WHEEL_SLOTS; distance++)
+        {
+            uint8_t slot = (bucket + distance) & TIMER_WHEEL_MASK;
+            if (!(occupied_[level] & (1u << slot)))
+            {
+                continue;
+            }
+            if (found && ((bucket + distance) << shift) - now_ >= delay)
+            {
+                break;
+            }
+
+            for (const Timer *timer = slots_[level][slot]; timer; timer = timer->next_)
+            {
+                uint32_t timer_delay = timer->expiry_ - now_;
+                if (!found || timer_delay < delay)
+                {
+                    delay = timer_delay;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    if (!found)
+    {
+        return TIMER_WHEEL_NO_DEADLINE;
+    }
+
+    int32_t remaining = static_cast<int32_t>(now_ + delay - now);
+    return (remaining > 0) ? static_cast<uint32_t>(remaining) : 0;
+}
+
+} // namespace robust_serial
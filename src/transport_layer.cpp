@@ -13,19 +13,175 @@
 namespace robust_serial
 {
 
+/**
+ * @brief Distance from base to seq in the 8-bit sequence space
+ */
+static inline uint8_t sequence_offset(uint8_t seq, uint8_t base)
+{
+    return static_cast<uint8_t>(seq - base);
+}
+
+/**
+ * @brief Reads a little-endian 32-bit value
+ */
+static uint32_t read_u32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static void write_u32(uint8_t *data, uint32_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+}
+
+/**
+ * @brief Spreads every bit of seed over the result (MurmurHash3 finalizer)
+ *
+ * Session tokens only have to differ between sessions, including those of
+ * a peer that restarted; they are not secret.
+ */
+static uint32_t mix_token(uint32_t seed)
+{
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6Bu;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35u;
+    seed ^= seed >> 16;
+    return seed;
+}
+
+#if TRANSPORT_DELTA_STREAMS
+/**
+ * @brief Encodes data as [UNCHANGED(1) | CHANGED(1) | CHANGED BYTES] runs against a keyframe
+ *
+ * Unchanged gaps of up to two bytes are copied as part of the surrounding
+ * change, which is never longer than a new run header.
+ *
+ * @return Encoded length, or -1 if it would exceed output_size
+ */
+static int encode_delta(const uint8_t *keyframe, const uint8_t *data, uint16_t length,
+                        uint8_t *output, uint16_t output_size)
+{
+    uint16_t read_index = 0;
+    uint16_t write_index = 0;
+
+    while (read_index < length)
+    {
+        uint16_t start = read_index;
+        while (read_index < length && read_index - start < 0xFF && data[read_index] == keyframe[read_index])
+        {
+            read_index++;
+        }
+        if (read_index == length)
+        {
+            break; // Trailing bytes equal the keyframe
+        }
+        uint16_t unchanged = read_index - start;
+
+        start = read_index;
+        while (read_index < length && read_index - start < 0xFF)
+        {
+            if (data[read_index] != keyframe[read_index])
+            {
+                read_index++;
+                continue;
+            }
+            // Absorb a short gap if another change follows it
+            uint16_t gap = 1;
+            while (gap < 3 && read_index + gap < length && data[read_index + gap] == keyframe[read_index + gap])
+            {
+                gap++;
+            }
+            if (gap >= 3 || read_index + gap >= length || read_index + gap - start >= 0xFF)
+            {
+                break;
+            }
+            read_index += gap;
+        }
+        uint16_t changed = read_index - start;
+
+        if (write_index + 2 + changed > output_size)
+        {
+            return -1;
+        }
+        output[write_index++] = static_cast<uint8_t>(unchanged);
+        output[write_index++] = static_cast<uint8_t>(changed);
+        memcpy(&output[write_index], &data[start], changed);
+        write_index += changed;
+    }
+
+    return write_index;
+}
+#endif
+
 TransportLayer::TransportLayer()
-    : connect_retries_(0)
+    : state_(TRANSPORT_STATE_DISCONNECTED)
+    , connect_retries_(0)
     , last_keepalive_ack_time_(0)
+    , last_keepalive_tx_time_(0)
+    , keepalive_pending_(false)
     , sequence_number_(0)
     , peer_sequence_number_(0)
-    , awaiting_ack_(false)
     , last_tx_time_(0)
-    , retry_count_(0)
     , waiting_response_(false)
+    , connection_id_(TRANSPORT_CONNECTION_ID_INVALID)
+    , fixed_connection_id_(TRANSPORT_CONNECTION_ID_INVALID)
+    , channel_(0)
+    , local_options_(0)
+    , options_(0)
+    , session_token_(0)
+    , resume_attempts_(0)
+    , tx_window_(NULL)
+    , rx_window_(NULL)
+    , window_size_(0)
+    , window_capacity_(0)
+    , delayed_ack_packets_(1)
+    , send_base_(0)
+    , nack_sent_(false)
+    , ack_pending_(false)
+    , ack_pending_count_(0)
+    , ack_pending_time_(0)
     , keepalive_interval_(TRANSPORT_LAYER_DEFAULT_KEEPALIVE_MS)
     , connection_timeout_(TRANSPORT_LAYER_DEFAULT_TIMEOUT_MS)
-    , connection_id_(TRANSPORT_CONNECTION_ID_INVALID)
+    , retry_timeout_(TRANSPORT_ACK_TIMEOUT_MS)
+    , max_retries_(TRANSPORT_MAX_DATA_RETRIES)
+    , srtt_(0)
+    , rttvar_(0)
+    , rtt_valid_(false)
+    , tx_message_(NULL)
+    , tx_message_length_(0)
+    , tx_message_offset_(0)
+    , rx_message_buffer_(NULL)
+    , rx_message_size_(0)
+    , rx_message_length_(0)
+    , rx_message_dropped_(false)
+    , timers_(NULL)
+    , keepalive_timer_(on_keepalive_timer, this)
+    , ack_timer_(on_ack_timer, this)
+    , retransmit_timer_(on_retransmit_timer, this)
+    , response_timer_(on_response_timer, this)
+    , link_blocked_(false)
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    , batch_timer_(on_batch_timer, this)
+    , batch_length_(0)
+    , batch_count_(0)
+    , batch_time_(0)
+    , batch_max_bytes_(0)
+    , batch_max_delay_(0)
+#endif
 {
+#if TRANSPORT_DELTA_STREAMS
+    for (uint8_t i = 0; i < TRANSPORT_DELTA_STREAMS; i++)
+    {
+        delta_tx_[i].valid = false;
+        delta_rx_[i].valid = false;
+    }
+#endif
+    reset_stats();
     log_debug("TransportLayer: Constructor called");
 }
 
@@ -54,6 +210,70 @@ void TransportLayer::initialize()
 void TransportLayer::deinitialize()
 {
     reset();
+
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    // Datagrams are connectionless and survive reset(), but not shutdown
+    batch_length_ = 0;
+    batch_count_ = 0;
+    if (timers_)
+    {
+        timers_->stop(batch_timer_);
+    }
+#endif
+}
+
+int TransportLayer::set_window(TransportTxSlot *tx_window, TransportRxSlot *rx_window, uint8_t window_size)
+{
+    if (!tx_window || !rx_window || !TRANSPORT_VALID_WINDOW_SIZE(window_size))
+    {
+        return TRANSPORT_ERROR_INVALID_PARAMS;
+    }
+    if (state_ != TRANSPORT_STATE_DISCONNECTED)
+    {
+        return TRANSPORT_ERROR_INVALID_STATE;
+    }
+
+    tx_window_ = tx_window;
+    rx_window_ = rx_window;
+    window_capacity_ = window_size;
+    use_window(0);
+    reset_window();
+    return TRANSPORT_SUCCESS;
+}
+
+/**
+ * @brief Options byte field announcing a window depth
+ */
+static uint8_t window_option(uint8_t window_size)
+{
+    uint8_t field = 1;
+    while (window_size > 1)
+    {
+        window_size >>= 1;
+        field++;
+    }
+    return static_cast<uint8_t>(field << TRANSPORT_OPTION_WINDOW_SHIFT);
+}
+
+/**
+ * @brief Uses the smaller of the own window and the one the peer announced
+ *
+ * @param peer_options Options byte of the peer's SYN or SYN-ACK, 0 for none
+ */
+void TransportLayer::use_window(uint8_t peer_options)
+{
+    window_size_ = window_capacity_;
+    uint8_t field = (peer_options & TRANSPORT_OPTION_WINDOW_MASK) >> TRANSPORT_OPTION_WINDOW_SHIFT;
+    if (field != 0 && field <= 6 && (1u << (field - 1)) < window_size_)
+    {
+        window_size_ = static_cast<uint8_t>(1u << (field - 1));
+    }
+
+    delayed_ack_packets_ = static_cast<uint8_t>((window_size_ + 1) / 2);
+    if (delayed_ack_packets_ > TRANSPORT_DELAYED_ACK_PACKETS)
+    {
+        delayed_ack_packets_ = TRANSPORT_DELAYED_ACK_PACKETS;
+    }
 }
 
 /**
@@ -65,6 +285,16 @@ void TransportLayer::set_timeout(uint32_t keepalive_ms, uint32_t timeout_ms)
               timeout_ms);
     keepalive_interval_ = keepalive_ms;
     connection_timeout_ = timeout_ms;
+
+    // Running timers follow the new values
+    if (state_ == TRANSPORT_STATE_CONNECTED)
+    {
+        arm_keepalive_timer();
+    }
+    else if (state_ == TRANSPORT_STATE_CONNECTING || state_ == TRANSPORT_STATE_DISCONNECTING)
+    {
+        arm_response_timer();
+    }
 }
 
 /**
@@ -81,8 +311,8 @@ int TransportLayer::connect()
         return TRANSPORT_SUCCESS;
     }
 
-    // If in any other state except DISCONNECTED, return error
-    if (state_ != TRANSPORT_STATE_DISCONNECTED)
+    // If in any other state except DISCONNECTED, or without a window or timers, return error
+    if (state_ != TRANSPORT_STATE_DISCONNECTED || window_capacity_ == 0 || !timers_)
     {
         log_debug("TransportLayer: Connect failed - invalid state %d", state_);
         return TRANSPORT_ERROR_INVALID_STATE;
@@ -115,8 +345,8 @@ int TransportLayer::listen()
         return TRANSPORT_SUCCESS;
     }
 
-    // If in any other state except DISCONNECTED, return error
-    if (state_ != TRANSPORT_STATE_DISCONNECTED)
+    // If in any other state except DISCONNECTED, or without a window or timers, return error
+    if (state_ != TRANSPORT_STATE_DISCONNECTED || window_capacity_ == 0 || !timers_)
     {
         log_debug("TransportLayer: Listen failed - invalid state %d", state_);
         return TRANSPORT_ERROR_INVALID_STATE;
@@ -161,9 +391,25 @@ int TransportLayer::disconnect()
  */
 int TransportLayer::send(const uint8_t *data, uint16_t length)
 {
+    if (!data)
+    {
+        log_debug("TransportLayer: Send failed - invalid parameters");
+        return TRANSPORT_ERROR_INVALID_PARAMS;
+    }
+
+    LayerSegment segment = {data, length};
+    return send_v(&segment, 1);
+}
+
+/**
+ * @brief Sends a payload scattered over several buffers as one DATA packet.
+ */
+int TransportLayer::send_v(const LayerSegment *segments, uint8_t count)
+{
+    int32_t length = layer_segments_length(segments, count);
     log_debug("TransportLayer: Send requested - length=%d, state=%d", length, state_);
 
-    if (!data || length == 0 || length > TRANSPORT_MAX_PAYLOAD_SIZE)
+    if (length <= 0 || length > TRANSPORT_MAX_PAYLOAD_SIZE)
     {
         log_debug("TransportLayer: Send failed - invalid parameters");
         return TRANSPORT_ERROR_INVALID_PARAMS;
@@ -175,17 +421,6 @@ int TransportLayer::send(const uint8_t *data, uint16_t length)
         return TRANSPORT_ERROR_INVALID_STATE;
     }
 
-    // Construct transport packet directly in last_tx_buffer_: [TYPE(1) | CONN_ID(1) | SEQ(1) |
-    // LENGTH(1) | PAYLOAD(n)]
-    last_tx_buffer_[0] = TRANSPORT_PACKET_TYPE_DATA;
-    last_tx_buffer_[1] = connection_id_;
-    last_tx_buffer_[2] = sequence_number_;
-    last_tx_buffer_[3] = length;
-    memcpy(&last_tx_buffer_[TRANSPORT_HEADER_SIZE], data, length);
-    last_tx_length_ = TRANSPORT_HEADER_SIZE + length;
-
-    log_debug("TransportLayer: Sending data packet - seq=%d, length=%d", sequence_number_, length);
-
     // Send packet through link layer
     if (!down_layer)
     {
@@ -193,21 +428,179 @@ int TransportLayer::send(const uint8_t *data, uint16_t length)
         return TRANSPORT_ERROR_INVALID_STATE;
     }
 
-    int result = down_layer->send(last_tx_buffer_, last_tx_length_);
+    if (tx_message_)
+    {
+        log_debug("TransportLayer: Send failed - message in progress");
+        return TRANSPORT_ERROR_BUSY;
+    }
+
+    if (!can_send())
+    {
+        log_debug("TransportLayer: Send failed - window full (%d in flight)",
+                  get_in_flight_count());
+        return TRANSPORT_ERROR_WINDOW_FULL;
+    }
+
+    return send_data_segment(TRANSPORT_PACKET_TYPE_DATA, segments, count,
+                             static_cast<uint16_t>(length));
+}
+
+/**
+ * @brief Places one DATA or DATA_FRAGMENT packet in the next window slot and sends it
+ *
+ * The caller has checked the state and that a window slot is free.
+ */
+int TransportLayer::send_data_segment(uint8_t type, const uint8_t *data, uint16_t length)
+{
+    LayerSegment segment = {data, length};
+    return send_data_segment(type, &segment, 1, length);
+}
+
+int TransportLayer::send_data_segment(uint8_t type, const LayerSegment *segments, uint8_t count,
+                                      uint16_t length)
+{
+    // Construct transport packet directly in its window slot: [TYPE(1) | CONN_ID(1) | SEQ(1) |
+    // LENGTH(1) | PAYLOAD(n)]
+    TransportTxSlot &slot = tx_window_[sequence_number_ & (window_size_ - 1)];
+    slot.buffer[0] = type;
+    slot.buffer[1] = connection_id_;
+    slot.buffer[2] = sequence_number_;
+    slot.buffer[3] = length & 0xFF; // Low byte only in large-frame mode
+    layer_gather_segments(&slot.buffer[TRANSPORT_HEADER_SIZE], segments, count);
+    slot.length = TRANSPORT_HEADER_SIZE + length;
+
+    log_debug("TransportLayer: Sending data packet - seq=%d, length=%d", sequence_number_, length);
+
+    int result = transmit_slot(slot);
     if (result < 0)
     {
         log_debug("TransportLayer: Send failed - down layer error %d", result);
         return result;
     }
 
+    // The slot only becomes part of the window once the link layer accepted it
+    slot.tx_time = get_current_time_ms();
+    slot.first_tx_time = slot.tx_time;
+    slot.retries = 0;
+    slot.acked = false;
+
     waiting_response_ = true;
-    last_tx_time_ = get_current_time_ms();
+    last_tx_time_ = slot.tx_time;
     sequence_number_ = (sequence_number_ + 1) % 256;
+    if (!retransmit_timer_.is_active())
+    {
+        start_timer(retransmit_timer_, slot.tx_time + retry_timeout_);
+    }
+    stats_.packets_tx++;
+    stats_.bytes_tx += length;
 
     log_debug("TransportLayer: Send successful - next seq=%d", sequence_number_);
     return TRANSPORT_SUCCESS;
 }
 
+/**
+ * @brief Passes a DATA packet from its window slot to the link layer
+ *
+ * A pending acknowledgment is piggybacked on the packet if it has room for
+ * the extra byte; the packet is then assembled in tx_buffer_, since the
+ * acknowledgment changes with every transmission of the slot.
+ */
+int TransportLayer::transmit_slot(const TransportTxSlot &slot)
+{
+    if (!ack_pending_ || slot.length >= TRANSPORT_MAX_PACKET_SIZE)
+    {
+        return down_layer->send(slot.buffer, slot.length);
+    }
+
+    // [TYPE|FLAG_ACK(1) | CONN_ID(1) | SEQ(1) | LENGTH(1) | ACK(1) | PAYLOAD(n)]
+    tx_buffer_[0] = slot.buffer[0] | TRANSPORT_PACKET_FLAG_ACK;
+    tx_buffer_[1] = slot.buffer[1];
+    tx_buffer_[2] = slot.buffer[2];
+    tx_buffer_[3] = slot.buffer[3];
+    tx_buffer_[TRANSPORT_HEADER_SIZE] = static_cast<uint8_t>(peer_sequence_number_ - 1);
+    memcpy(&tx_buffer_[TRANSPORT_HEADER_SIZE + 1], &slot.buffer[TRANSPORT_HEADER_SIZE],
+           slot.length - TRANSPORT_HEADER_SIZE);
+
+    int result = down_layer->send(tx_buffer_, slot.length + 1);
+    if (result >= 0)
+    {
+        ack_pending_ = false;
+        ack_pending_count_ = 0;
+        stats_.acks_piggybacked++;
+    }
+    return result;
+}
+
+/**
+ * @brief Starts sending a message of any length
+ */
+int TransportLayer::send_message(const uint8_t *data, uint32_t length)
+{
+    log_debug("TransportLayer: Message send requested - length=%u, state=%d", length, state_);
+
+    if (!data || length == 0)
+    {
+        return TRANSPORT_ERROR_INVALID_PARAMS;
+    }
+
+    if (state_ != TRANSPORT_STATE_CONNECTED || !down_layer)
+    {
+        return TRANSPORT_ERROR_INVALID_STATE;
+    }
+
+    if (tx_message_)
+    {
+        return TRANSPORT_ERROR_BUSY;
+    }
+
+    tx_message_ = data;
+    tx_message_length_ = length;
+    tx_message_offset_ = 0;
+    pump_message();
+    return TRANSPORT_SUCCESS;
+}
+
+/**
+ * @brief Moves segments of the pending message into free window slots
+ *
+ * Called whenever slots may have become free. A segment the link layer
+ * cannot take right now is retried on the next acknowledgment or tick.
+ */
+void TransportLayer::pump_message()
+{
+    while (tx_message_ && can_send())
+    {
+        uint32_t remaining = tx_message_length_ - tx_message_offset_;
+        uint16_t length = (remaining > TRANSPORT_MAX_PAYLOAD_SIZE) ? TRANSPORT_MAX_PAYLOAD_SIZE
+                                                                   : static_cast<uint16_t>(remaining);
+        uint8_t type = (remaining > length) ? TRANSPORT_PACKET_TYPE_DATA_FRAGMENT
+                                            : TRANSPORT_PACKET_TYPE_DATA;
+
+        if (send_data_segment(type, tx_message_ + tx_message_offset_, length) < 0)
+        {
+            return;
+        }
+
+        tx_message_offset_ += length;
+        if (tx_message_offset_ == tx_message_length_)
+        {
+            tx_message_ = NULL;
+            report_event(TRANSPORT_LAYER_EVENT_MESSAGE_SENT);
+        }
+    }
+}
+
+/**
+ * @brief Sets the buffer segmented messages are reassembled into
+ */
+void TransportLayer::set_rx_message_buffer(uint8_t *buffer, uint32_t size)
+{
+    rx_message_buffer_ = buffer;
+    rx_message_size_ = buffer ? size : 0;
+    rx_message_length_ = 0;
+    rx_message_dropped_ = false;
+}
+
 /**
  * @brief Handles received data and reports message reception.
  */
@@ -219,17 +612,26 @@ int TransportLayer::on_receive(const uint8_t *data, uint16_t length)
         return -1;
     }
 
-    if (length < sizeof(TransportPacketHeader))
+    // Datagrams only have a TYPE and a LENGTH byte in front of their data
+    bool datagram = (data[0] == TRANSPORT_PACKET_TYPE_DATAGRAM || data[0] == TRANSPORT_PACKET_TYPE_DATAGRAM_BATCH ||
+                     data[0] == TRANSPORT_PACKET_TYPE_DATAGRAM_DELTA);
+    if (length < (datagram ? 2 : sizeof(TransportPacketHeader)))
     {
+        stats_.invalid_packets++;
         //log_debug("TransportLayer: Received packet too short (length=%d, expected=%d)", length, sizeof(TransportPacketHeader));
         return -1;
     }
 
     const TransportPacketHeader *header = reinterpret_cast<const TransportPacketHeader *>(data);
 
-    // Validate packet type
-    if (header->type >= TRANSPORT_PACKET_TYPE_MAX)
+    // Validate packet type; only DATA packets may carry a piggybacked ACK
+    uint8_t type = header->type & ~TRANSPORT_PACKET_FLAG_ACK;
+    bool has_ack = (header->type & TRANSPORT_PACKET_FLAG_ACK) != 0;
+    if (type >= TRANSPORT_PACKET_TYPE_MAX ||
+        (has_ack && ((type != TRANSPORT_PACKET_TYPE_DATA && type != TRANSPORT_PACKET_TYPE_DATA_FRAGMENT) ||
+                     length < TRANSPORT_HEADER_SIZE + 1)))
     {
+        stats_.invalid_packets++;
         log_debug("TransportLayer: Received invalid packet type (%d)", header->type);
         return -1;
     }
@@ -238,13 +640,15 @@ int TransportLayer::on_receive(const uint8_t *data, uint16_t length)
     //         header->type, header->connection_id, header->sequence, length, state_);
 
     // Handle different packet types based on state
-    switch (header->type)
+    switch (type)
     {
     case TRANSPORT_PACKET_TYPE_SYN:
-        if (state_ == TRANSPORT_STATE_LISTENING || state_ == TRANSPORT_STATE_CONNECTED)
+        if (state_ == TRANSPORT_STATE_LISTENING || state_ == TRANSPORT_STATE_CONNECTED ||
+            state_ == TRANSPORT_STATE_RESUMING)
         {
             log_debug("TransportLayer: Processing SYN packet with seq=%d", header->sequence);
-            handle_syn_packet(header->connection_id, header->sequence);
+            handle_syn_packet(header->connection_id, header->sequence,
+                              (length > TRANSPORT_HEADER_SIZE) ? data[TRANSPORT_HEADER_SIZE] : 0);
             return 0;
         }
         log_debug("TransportLayer: Ignoring SYN packet in state=%d", state_);
@@ -254,7 +658,9 @@ int TransportLayer::on_receive(const uint8_t *data, uint16_t length)
         if (state_ == TRANSPORT_STATE_CONNECTING)
         {
             log_debug("TransportLayer: Processing SYN-ACK packet with seq=%d", header->sequence);
-            handle_syn_ack_packet(header->connection_id, header->sequence);
+            handle_syn_ack_packet(header->connection_id, header->sequence,
+                                  (length > TRANSPORT_HEADER_SIZE) ? data[TRANSPORT_HEADER_SIZE] : 0,
+                                  (length >= TRANSPORT_HEADER_SIZE + 5) ? read_u32(&data[TRANSPORT_HEADER_SIZE + 1]) : 0);
             return 0;
         }
         log_debug("TransportLayer: Ignoring SYN-ACK packet in state=%d", state_);
@@ -291,9 +697,14 @@ int TransportLayer::on_receive(const uint8_t *data, uint16_t length)
         break;
 
     case TRANSPORT_PACKET_TYPE_DATA:
+    case TRANSPORT_PACKET_TYPE_DATA_FRAGMENT:
         if (state_ == TRANSPORT_STATE_CONNECTED)
         {
             log_debug("TransportLayer: Processing DATA packet with seq=%d", header->sequence);
+            if (has_ack && header->connection_id == connection_id_)
+            {
+                handle_ack_number(data[TRANSPORT_HEADER_SIZE], 0);
+            }
             return handle_data_packet(data, length);
         }
         log_debug("TransportLayer: Ignoring DATA packet in state=%d", state_);
@@ -303,7 +714,7 @@ int TransportLayer::on_receive(const uint8_t *data, uint16_t length)
         if (state_ == TRANSPORT_STATE_CONNECTED)
         {
             log_debug("TransportLayer: Processing DATA_ACK packet with seq=%d", header->sequence);
-            handle_data_ack_packet(header->connection_id, header->sequence);
+            handle_data_ack_packet(data, length);
             return 0;
         }
         log_debug("TransportLayer: Ignoring DATA_ACK packet in state=%d", state_);
@@ -346,6 +757,40 @@ int TransportLayer::on_receive(const uint8_t *data, uint16_t length)
         }
         log_debug("TransportLayer: Ignoring DATAGRAM packet in ERROR state");
         break;
+
+    case TRANSPORT_PACKET_TYPE_DATAGRAM_BATCH:
+        if (state_ != TRANSPORT_STATE_ERROR)
+        {
+            log_debug("TransportLayer: Processing DATAGRAM_BATCH packet");
+            return handle_datagram_batch_packet(data, length);
+        }
+        log_debug("TransportLayer: Ignoring DATAGRAM_BATCH packet in ERROR state");
+        break;
+
+    case TRANSPORT_PACKET_TYPE_DATAGRAM_DELTA:
+        if (state_ != TRANSPORT_STATE_ERROR)
+        {
+            log_debug("TransportLayer: Processing DATAGRAM_DELTA packet");
+            return handle_datagram_delta_packet(data, length);
+        }
+        log_debug("TransportLayer: Ignoring DATAGRAM_DELTA packet in ERROR state");
+        break;
+
+    case TRANSPORT_PACKET_TYPE_RESUME:
+    case TRANSPORT_PACKET_TYPE_RESUME_ACK:
+        // A peer that suspended the session may find this side still connected
+        if ((state_ == TRANSPORT_STATE_RESUMING ||
+             (state_ == TRANSPORT_STATE_CONNECTED && type == TRANSPORT_PACKET_TYPE_RESUME)) &&
+            length >= TRANSPORT_HEADER_SIZE + 4)
+        {
+            log_debug("TransportLayer: Processing %s packet with seq=%d",
+                      (type == TRANSPORT_PACKET_TYPE_RESUME) ? "RESUME" : "RESUME_ACK", header->sequence);
+            handle_resume_packet(type, header->connection_id, header->sequence,
+                                 read_u32(&data[TRANSPORT_HEADER_SIZE]));
+            return 0;
+        }
+        log_debug("TransportLayer: Ignoring RESUME packet in state=%d", state_);
+        break;
     }
 
     return -1;
@@ -361,223 +806,888 @@ int TransportLayer::handle_data_packet(const uint8_t *data, uint16_t length)
     // Verify connection ID matches
     if (header->connection_id != connection_id_)
     {
+        stats_.invalid_packets++;
         log_debug(
             "TransportLayer: Ignoring DATA packet with invalid connection ID %d (expected %d)",
             header->connection_id, connection_id_);
         return -1;
     }
 
-    // Extract payload
-    const uint8_t *payload = data + sizeof(TransportPacketHeader);
-    uint16_t payload_length = length - sizeof(TransportPacketHeader);
+    // Extract payload, behind the piggybacked ACK if there is one
+    bool fragment = (header->type & ~TRANSPORT_PACKET_FLAG_ACK) == TRANSPORT_PACKET_TYPE_DATA_FRAGMENT;
+    uint16_t header_length = sizeof(TransportPacketHeader);
+    if (header->type & TRANSPORT_PACKET_FLAG_ACK)
+    {
+        header_length++;
+    }
+    const uint8_t *payload = data + header_length;
+    uint16_t payload_length = length - header_length;
 
     log_debug("TransportLayer: Handling data packet - seq=%d, length=%d, expected_seq=%d",
               header->sequence, payload_length, peer_sequence_number_);
 
-    // Check sequence number
-    if (header->sequence != peer_sequence_number_)
+    uint8_t offset = sequence_offset(header->sequence, peer_sequence_number_);
+
+    if (offset >= window_size_)
     {
-        log_debug("TransportLayer: Sequence mismatch - got=%d, expected=%d", header->sequence,
-                  peer_sequence_number_);
-        send_data_nack(connection_id_, header->sequence);
+        // Sequence numbers behind the window are duplicates whose ACK was lost;
+        // re-acknowledge so the sender can advance. Anything further ahead is
+        // outside the peer's window and is dropped.
+        log_debug("TransportLayer: Sequence outside window - got=%d, expected=%d",
+                  header->sequence, peer_sequence_number_);
+        if (offset >= 0x80)
+        {
+            stats_.duplicates_rx++;
+            send_data_ack(connection_id_);
+        }
         return -1;
     }
 
-    // Forward data directly to manager
-    if (manager_)
+    if (offset > 0)
     {
-        log_debug("TransportLayer: Forwarding data to manager");
-        manager_->on_receive(payload, payload_length);
+        // Out of order: hold the packet until the gap before it is filled
+        TransportRxSlot &slot = rx_window_[header->sequence & (window_size_ - 1)];
+        if (!slot.valid)
+        {
+            memcpy(slot.buffer, payload, payload_length);
+            slot.length = payload_length;
+            slot.fragment = fragment;
+            slot.valid = true;
+            stats_.packets_rx++;
+            stats_.bytes_rx += payload_length;
+            stats_.out_of_order_rx++;
+        }
+        else
+        {
+            stats_.duplicates_rx++;
+        }
+
+        log_debug("TransportLayer: Sequence gap - got=%d, expected=%d", header->sequence,
+                  peer_sequence_number_);
+
+        // Ask for the missing packet once, then report what we hold. A packet
+        // held back for the upper layer is not missing.
+        if (!nack_sent_ && !rx_window_[peer_sequence_number_ & (window_size_ - 1)].valid)
+        {
+            send_data_nack(connection_id_, peer_sequence_number_);
+            nack_sent_ = true;
+        }
+        send_data_ack(connection_id_);
+        return 0;
     }
-    else
+
+    TransportRxSlot &slot = rx_window_[peer_sequence_number_ & (window_size_ - 1)];
+    if (slot.valid)
     {
-        log_debug("TransportLayer: No manager to forward data to");
+        // Retransmission of the packet held back for the upper layer
+        stats_.duplicates_rx++;
+        retry_held_packets();
+        return 0;
     }
 
-    // Send ACK
-    send_data_ack(connection_id_, header->sequence);
+    stats_.packets_rx++;
+    stats_.bytes_rx += payload_length;
+    if (!deliver_payload(fragment, payload, payload_length))
+    {
+        // The upper layer has no room for it yet: hold it unacknowledged, so
+        // the sender's window fills up, and retry from tick(). The sender
+        // retransmits it on its RTO meanwhile; see set_loan_callback()
+        memcpy(slot.buffer, payload, payload_length);
+        slot.length = payload_length;
+        slot.fragment = fragment;
+        slot.valid = true;
+        return 0;
+    }
 
-    // Update peer's sequence number
+    // Update peer's sequence number and release any packets that are now in order
     peer_sequence_number_ = (peer_sequence_number_ + 1) % 256;
+    bool gap_filled = nack_sent_;
+    nack_sent_ = false;
+    deliver_in_order_packets();
     log_debug("TransportLayer: Updated peer sequence to %d", peer_sequence_number_);
 
+    // Acknowledge a filled gap at once so the sender can advance past it;
+    // plain in-order packets are acknowledged cumulatively, possibly on DATA
+    if (gap_filled)
+    {
+        send_data_ack(connection_id_);
+    }
+    else
+    {
+        schedule_data_ack();
+    }
+
     return 0;
 }
 
 /**
- * @brief Periodically checks for timeouts and sends keep-alives.
+ * @brief Delivers buffered out-of-order packets that directly follow peer_sequence_number_
+ *
+ * Stops at a packet the upper layer cannot take yet, which stays in its slot.
  */
-void TransportLayer::tick()
+void TransportLayer::deliver_in_order_packets()
 {
-    // Calculate elapsed time since last tick
-    uint32_t current_time = get_current_time_ms();
-    uint16_t elapsed_ms = static_cast<uint16_t>(current_time - last_tick_time_);
-    last_tick_time_ = current_time;
-
-    //log_debug("TransportLayer: Tick - state=%d, elapsed=%dms", state_, elapsed_ms);
-
-    // Handle timeouts and keep-alives based on state
-    switch (state_)
+    TransportRxSlot *slot = &rx_window_[peer_sequence_number_ & (window_size_ - 1)];
+    while (slot->valid)
     {
-    case TRANSPORT_STATE_CONNECTED:
-        // Check for keep-alive timeout
-        if (current_time - last_keepalive_ack_time_ > keepalive_interval_ * 3)
-        {
-            log_info("TransportLayer: Keep-alive timeout, disconnecting");
-            // Start graceful disconnect
-            state_ = TRANSPORT_STATE_DISCONNECTING;
-            //waiting_response_ = true;
-            //send_fin();
-            report_event(TRANSPORT_LAYER_EVENT_TIMEOUT);
-        }
-        // Send keep-alive if needed
-        else if (current_time - last_keepalive_ack_time_ > keepalive_interval_)
-        {
-            //log_debug("TransportLayer: Sending keepalive");
-            send_keepalive();
-        }
-        break;
-
-    case TRANSPORT_STATE_CONNECTING:
-        // Handle connection timeout
-        if (waiting_response_ && (current_time - last_tx_time_ > connection_timeout_))
-        {
-            if (connect_retries_ < TRANSPORT_MAX_RETRIES)
-            {
-                connect_retries_++;
-                log_debug("TransportLayer: Connection timeout - retry %d/%d", connect_retries_,
-                          TRANSPORT_MAX_RETRIES);
-                send_syn();
-            }
-            else
-            {
-                log_debug("TransportLayer: Connection failed after %d retries", connect_retries_);
-                state_ = TRANSPORT_STATE_ERROR;
-                report_event(TRANSPORT_LAYER_EVENT_TIMEOUT);
-            }
-        }
-        break;
-
-    case TRANSPORT_STATE_DISCONNECTING:
-        // Handle disconnection timeout
-        if (waiting_response_ && (current_time - last_tx_time_ > connection_timeout_))
+        if (!deliver_payload(slot->fragment, slot->buffer, slot->length))
         {
-            log_debug("TransportLayer: Disconnection timeout, forcing disconnect");
-            state_ = TRANSPORT_STATE_DISCONNECTED;
-            waiting_response_ = false;
-            connection_id_ = TRANSPORT_CONNECTION_ID_INVALID;
-            report_event(TRANSPORT_LAYER_EVENT_DISCONNECTED);
+            break;
         }
-        break;
-
-    default:
-        break;
+        slot->valid = false;
+        peer_sequence_number_ = (peer_sequence_number_ + 1) % 256;
+        slot = &rx_window_[peer_sequence_number_ & (window_size_ - 1)];
     }
 }
 
 /**
- * @brief Sends a keep-alive message.
+ * @brief Retries the packets held back for the upper layer, acknowledging those it takes
  */
-void TransportLayer::send_keepalive()
+void TransportLayer::retry_held_packets()
 {
-    //log_debug("TransportLayer: Sending keepalive packet - conn_id=%d", connection_id_);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_KEEPALIVE;
-    tx_buffer_[1] = connection_id_;
-    tx_buffer_[2] = 0; // No sequence number needed
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    uint8_t expected = peer_sequence_number_;
+    deliver_in_order_packets();
+    if (peer_sequence_number_ != expected)
+    {
+        send_data_ack(connection_id_); // The sender's window has been full
+    }
 }
 
-void TransportLayer::send_syn()
+/**
+ * @brief Whether the next in-order packet is held back for the upper layer
+ */
+bool TransportLayer::has_held_packet() const
 {
-    log_debug("TransportLayer: Sending SYN packet - seq=%d", sequence_number_);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_SYN;
-    tx_buffer_[1] = TRANSPORT_CONNECTION_ID_INVALID; // Client sends invalid ID in SYN
-    tx_buffer_[2] = sequence_number_;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    return window_size_ != 0 && rx_window_[peer_sequence_number_ & (window_size_ - 1)].valid;
 }
 
-void TransportLayer::send_syn_ack()
+/**
+ * @brief Passes an in-order payload up, reassembling segmented messages
+ *
+ * A DATA packet outside a segmented message is forwarded straight from
+ * where it was received; fragments are collected in rx_message_buffer_ until
+ * the closing DATA packet completes the message.
+ *
+ * @return false if the manager answered LAYER_ERROR_BUSY, so the packet must
+ *         be delivered again later
+ */
+bool TransportLayer::deliver_payload(bool fragment, const uint8_t *payload, uint16_t length)
 {
-    // Increment connection ID before using it
-    connection_id_ = (connection_id_ + 1) % 256;
-    if (connection_id_ == TRANSPORT_CONNECTION_ID_INVALID)
+    if (!fragment && rx_message_length_ == 0 && !rx_message_dropped_)
     {
-        connection_id_ = TRANSPORT_CONNECTION_ID_START;
+        if (manager_)
+        {
+            log_debug("TransportLayer: Forwarding data to manager");
+            return manager_->on_receive(channel_, payload, length) != LAYER_ERROR_BUSY;
+        }
+        log_debug("TransportLayer: No manager to forward data to");
+        return true;
     }
 
-    log_debug("TransportLayer: Sending SYN-ACK packet - seq=%d, conn_id=%d", sequence_number_,
+    if (!rx_message_dropped_)
+    {
+        if (!rx_message_buffer_ || length > rx_message_size_ - rx_message_length_)
+        {
+            log_warning("TransportLayer: Dropping message larger than reassembly buffer (%u bytes)",
+                        rx_message_size_);
+            rx_message_dropped_ = true;
+        }
+        else
+        {
+            memcpy(&rx_message_buffer_[rx_message_length_], payload, length);
+            rx_message_length_ += length;
+        }
+    }
+
+    if (!fragment)
+    {
+        // Last segment: the message is complete
+        if (!rx_message_dropped_ && manager_ &&
+            manager_->on_message(channel_, rx_message_buffer_, rx_message_length_) == LAYER_ERROR_BUSY)
+        {
+            rx_message_length_ -= length; // Appended again when the segment is retried
+            return false;
+        }
+        rx_message_length_ = 0;
+        rx_message_dropped_ = false;
+    }
+    return true;
+}
+
+/**
+ * @brief Runs the timers that are due and retries a pending message segment.
+ */
+void TransportLayer::tick()
+{
+    if (timers_)
+    {
+        timers_->advance(get_current_time_ms());
+    }
+
+    // Retry a message segment the link layer could not take earlier, and
+    // data the upper layer could not take
+    if (state_ == TRANSPORT_STATE_CONNECTED)
+    {
+        pump_message();
+        if (has_held_packet())
+        {
+            retry_held_packets();
+        }
+    }
+}
+
+/**
+ * @brief Brings the timers that back off for a full link queue forward to now
+ *
+ * Their handlers re-check their condition, so a timer that was not waiting
+ * for the link only re-arms itself.
+ */
+void TransportLayer::on_link_space()
+{
+    if (!link_blocked_ || !timers_)
+    {
+        return;
+    }
+    link_blocked_ = false;
+
+    uint32_t now = get_current_time_ms();
+    if (ack_timer_.is_active())
+    {
+        timers_->start(ack_timer_, now, now);
+    }
+    if (retransmit_timer_.is_active())
+    {
+        timers_->start(retransmit_timer_, now, now);
+    }
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    if (batch_timer_.is_active())
+    {
+        timers_->start(batch_timer_, now, now);
+    }
+#endif
+}
+
+/**
+ * @brief Milliseconds from now until due, 0 if due has passed (wrap-safe)
+ */
+static uint32_t time_until(uint32_t now, uint32_t due)
+{
+    int32_t remaining = static_cast<int32_t>(due - now);
+    return (remaining > 0) ? static_cast<uint32_t>(remaining) : 0;
+}
+
+/**
+ * @brief Starts a timer on the wheel, if one is set
+ */
+void TransportLayer::start_timer(Timer &timer, uint32_t expiry)
+{
+    if (timers_)
+    {
+        timers_->start(timer, expiry, get_current_time_ms());
+    }
+}
+
+void TransportLayer::stop_timers()
+{
+    if (!timers_)
+    {
+        return;
+    }
+    timers_->stop(keepalive_timer_);
+    timers_->stop(ack_timer_);
+    timers_->stop(retransmit_timer_);
+    timers_->stop(response_timer_);
+}
+
+/**
+ * @brief Arms the keep-alive timer for the next probe or the timeout, whichever comes first
+ */
+void TransportLayer::arm_keepalive_timer()
+{
+    uint32_t now = get_current_time_ms();
+    uint32_t deadline = time_until(now, last_keepalive_ack_time_ + keepalive_interval_ * 3 + 1);
+
+    // Next keep-alive probe: once the interval has passed, and at most four per interval
+    uint32_t probe = time_until(now, last_keepalive_ack_time_ + keepalive_interval_ + 1);
+    uint32_t repeat = time_until(now, last_keepalive_tx_time_ + keepalive_interval_ / 4);
+    uint32_t probe_due = (probe > repeat) ? probe : repeat;
+    if (probe_due < deadline)
+    {
+        deadline = probe_due;
+    }
+
+    start_timer(keepalive_timer_, now + deadline);
+}
+
+/**
+ * @brief Arms the retransmission timer for the oldest unacknowledged packet
+ *
+ * A packet the link layer could not take is overdue already and is retried
+ * after TRANSPORT_LINK_RETRY_MS.
+ */
+void TransportLayer::arm_retransmit_timer()
+{
+    uint32_t now = get_current_time_ms();
+    uint32_t deadline = TRANSPORT_NO_DEADLINE;
+    uint8_t in_flight = get_in_flight_count();
+    for (uint8_t i = 0; i < in_flight; i++)
+    {
+        const TransportTxSlot &slot =
+            tx_window_[static_cast<uint8_t>(send_base_ + i) & (window_size_ - 1)];
+        if (!slot.acked)
+        {
+            uint32_t retransmit = time_until(now, slot.tx_time + retry_timeout_);
+            if (retransmit < deadline)
+            {
+                deadline = retransmit;
+            }
+        }
+    }
+
+    if (deadline == TRANSPORT_NO_DEADLINE)
+    {
+        if (timers_)
+        {
+            timers_->stop(retransmit_timer_);
+        }
+        return;
+    }
+    if (deadline == 0)
+    {
+        link_blocked_ = true;
+        deadline = TRANSPORT_LINK_RETRY_MS;
+    }
+    start_timer(retransmit_timer_, now + deadline);
+}
+
+/**
+ * @brief Arms the timeout of a SYN, SYN-ACK, FIN or RESUME sent at last_tx_time_
+ *
+ * RESUME packets are repeated every keep-alive interval, so that the session
+ * continues soon after the outage ends.
+ */
+void TransportLayer::arm_response_timer()
+{
+    uint32_t timeout = (state_ == TRANSPORT_STATE_RESUMING) ? keepalive_interval_ : connection_timeout_;
+    start_timer(response_timer_, last_tx_time_ + timeout + 1);
+}
+
+/**
+ * @brief Sends a keep-alive probe when due, or drops a connection whose peer went silent
+ */
+void TransportLayer::on_keepalive_timer(void *context)
+{
+    TransportLayer *self = static_cast<TransportLayer *>(context);
+    if (self->state_ != TRANSPORT_STATE_CONNECTED)
+    {
+        return;
+    }
+
+    uint32_t current_time = get_current_time_ms();
+    if (current_time - self->last_keepalive_ack_time_ > self->keepalive_interval_ * 3)
+    {
+        log_info("TransportLayer: Keep-alive timeout");
+        self->stats_.keepalive_timeouts++;
+        self->connection_lost();
+        return;
+    }
+
+    // Send keep-alive if needed, repeating the probe at most four times per
+    // interval until it is acknowledged
+    if (current_time - self->last_keepalive_ack_time_ > self->keepalive_interval_ &&
+        current_time - self->last_keepalive_tx_time_ >= self->keepalive_interval_ / 4)
+    {
+        self->last_keepalive_tx_time_ = current_time;
+        if (self->keepalive_pending_)
+        {
+            self->stats_.keepalive_misses++;
+        }
+        self->keepalive_pending_ = true;
+        self->send_keepalive();
+    }
+
+    self->arm_keepalive_timer();
+}
+
+/**
+ * @brief Sends an acknowledgment that found no DATA to ride on
+ */
+void TransportLayer::on_ack_timer(void *context)
+{
+    TransportLayer *self = static_cast<TransportLayer *>(context);
+    if (self->state_ != TRANSPORT_STATE_CONNECTED || !self->ack_pending_)
+    {
+        return;
+    }
+
+    uint32_t current_time = get_current_time_ms();
+    if (current_time - self->ack_pending_time_ < TRANSPORT_DELAYED_ACK_MS)
+    {
+        self->start_timer(self->ack_timer_, self->ack_pending_time_ + TRANSPORT_DELAYED_ACK_MS);
+        return;
+    }
+
+    self->send_data_ack(self->connection_id_);
+    if (self->ack_pending_)
+    {
+        // The link layer is full, try again once it had time to drain
+        self->link_blocked_ = true;
+        self->start_timer(self->ack_timer_, current_time + TRANSPORT_LINK_RETRY_MS);
+    }
+}
+
+/**
+ * @brief Resends DATA packets whose acknowledgment is overdue
+ */
+void TransportLayer::on_retransmit_timer(void *context)
+{
+    TransportLayer *self = static_cast<TransportLayer *>(context);
+    if (self->state_ != TRANSPORT_STATE_CONNECTED || self->get_in_flight_count() == 0)
+    {
+        return;
+    }
+
+    self->check_retransmissions(get_current_time_ms());
+    if (self->state_ == TRANSPORT_STATE_CONNECTED)
+    {
+        self->arm_retransmit_timer();
+    }
+}
+
+/**
+ * @brief Repeats an unanswered SYN or RESUME, or gives up a connection,
+ * disconnection or suspended session
+ */
+void TransportLayer::on_response_timer(void *context)
+{
+    TransportLayer *self = static_cast<TransportLayer *>(context);
+    if (self->state_ == TRANSPORT_STATE_RESUMING)
+    {
+        uint32_t current_time = get_current_time_ms();
+        if (current_time - self->last_tx_time_ <= self->keepalive_interval_)
+        {
+            self->arm_response_timer();
+        }
+        else if (self->resume_attempts_ < TRANSPORT_RESUME_ATTEMPTS)
+        {
+            self->send_resume(TRANSPORT_PACKET_TYPE_RESUME);
+        }
+        else
+        {
+            log_info("TransportLayer: Session not resumed after %d attempts, disconnecting",
+                     self->resume_attempts_);
+            self->state_ = TRANSPORT_STATE_DISCONNECTED;
+            self->waiting_response_ = false;
+            self->connection_id_ = TRANSPORT_CONNECTION_ID_INVALID;
+            self->report_event(TRANSPORT_LAYER_EVENT_TIMEOUT);
+        }
+        return;
+    }
+
+    if (!self->waiting_response_ ||
+        (self->state_ != TRANSPORT_STATE_CONNECTING && self->state_ != TRANSPORT_STATE_DISCONNECTING))
+    {
+        return;
+    }
+
+    uint32_t current_time = get_current_time_ms();
+    if (current_time - self->last_tx_time_ <= self->connection_timeout_)
+    {
+        self->arm_response_timer();
+        return;
+    }
+
+    if (self->state_ == TRANSPORT_STATE_CONNECTING)
+    {
+        // Handle connection timeout
+        if (self->connect_retries_ < TRANSPORT_MAX_RETRIES)
+        {
+            self->connect_retries_++;
+            log_debug("TransportLayer: Connection timeout - retry %d/%d", self->connect_retries_,
+                      TRANSPORT_MAX_RETRIES);
+            self->send_syn();
+        }
+        else
+        {
+            log_debug("TransportLayer: Connection failed after %d retries", self->connect_retries_);
+            self->state_ = TRANSPORT_STATE_ERROR;
+            self->report_event(TRANSPORT_LAYER_EVENT_TIMEOUT);
+        }
+    }
+    else
+    {
+        // Handle disconnection timeout
+        log_debug("TransportLayer: Disconnection timeout, forcing disconnect");
+        self->state_ = TRANSPORT_STATE_DISCONNECTED;
+        self->waiting_response_ = false;
+        self->connection_id_ = TRANSPORT_CONNECTION_ID_INVALID;
+        self->report_event(TRANSPORT_LAYER_EVENT_DISCONNECTED);
+    }
+}
+
+#if TRANSPORT_DATAGRAM_AGGREGATION
+/**
+ * @brief Sends a datagram batch whose latency budget is used up, in every state
+ */
+void TransportLayer::on_batch_timer(void *context)
+{
+    TransportLayer *self = static_cast<TransportLayer *>(context);
+    if (self->batch_length_ == 0)
+    {
+        return;
+    }
+
+    uint32_t current_time = get_current_time_ms();
+    if (current_time - self->batch_time_ < self->batch_max_delay_)
+    {
+        self->start_timer(self->batch_timer_, self->batch_time_ + self->batch_max_delay_);
+        return;
+    }
+
+    self->flush_datagrams();
+    if (self->batch_length_ > 0)
+    {
+        // The link layer is full, try again after another latency budget
+        self->link_blocked_ = true;
+        uint32_t retry = (self->batch_max_delay_ > TRANSPORT_LINK_RETRY_MS) ? self->batch_max_delay_
+                                                                             : TRANSPORT_LINK_RETRY_MS;
+        self->start_timer(self->batch_timer_, current_time + retry);
+    }
+}
+#endif
+
+uint32_t TransportLayer::get_next_deadline() const
+{
+    uint32_t deadline =
+        timers_ ? timers_->get_next_deadline(get_current_time_ms()) : TRANSPORT_NO_DEADLINE;
+
+    // A message segment the link layer could not take, and data the upper
+    // layer could not take, are retried from tick()
+    if (state_ == TRANSPORT_STATE_CONNECTED && ((tx_message_ && can_send()) || has_held_packet()) &&
+        deadline > TRANSPORT_LINK_RETRY_MS)
+    {
+        deadline = TRANSPORT_LINK_RETRY_MS;
+    }
+    return deadline;
+}
+
+/**
+ * @brief Builds a connection-oriented packet and passes it to the link layer
+ *
+ * The packet is written straight into the link layer's outgoing buffer when
+ * it supports reserve(); otherwise tx_buffer_ is used as staging area.
+ * Control packets overtake queued data, except FIN and FIN_ACK, which must
+ * follow the data sent before them.
+ */
+int TransportLayer::send_packet(uint8_t type, uint8_t connection_id, uint8_t sequence,
+                                const uint8_t *payload, uint8_t length)
+{
+    uint8_t priority = (type == TRANSPORT_PACKET_TYPE_FIN || type == TRANSPORT_PACKET_TYPE_FIN_ACK)
+                           ? LAYER_PRIORITY_BULK
+                           : LAYER_PRIORITY_CONTROL;
+
+    uint16_t packet_length = TRANSPORT_HEADER_SIZE + length;
+    uint8_t *packet = down_layer->reserve(packet_length, priority);
+    bool reserved = (packet != NULL);
+    if (!reserved)
+    {
+        packet = tx_buffer_;
+    }
+
+    // [TYPE(1) | CONN_ID(1) | SEQ(1) | LENGTH(1) | PAYLOAD(n)]
+    packet[0] = type;
+    packet[1] = connection_id;
+    packet[2] = sequence;
+    packet[3] = length;
+    if (length > 0)
+    {
+        memcpy(&packet[TRANSPORT_HEADER_SIZE], payload, length);
+    }
+
+    return reserved ? down_layer->commit(packet_length)
+                    : down_layer->send(packet, packet_length, priority);
+}
+
+/**
+ * @brief Sends a keep-alive message.
+ */
+void TransportLayer::send_keepalive()
+{
+    //log_debug("TransportLayer: Sending keepalive packet - conn_id=%d", connection_id_);
+    send_packet(TRANSPORT_PACKET_TYPE_KEEPALIVE, connection_id_, 0, NULL, 0);
+}
+
+/**
+ * @brief Sends a RESUME or RESUME_ACK with the session token and the next expected sequence number
+ */
+void TransportLayer::send_resume(uint8_t type)
+{
+    uint8_t token[4];
+    write_u32(token, session_token_);
+    log_debug("TransportLayer: Sending %s packet - next seq=%d, conn_id=%d",
+              (type == TRANSPORT_PACKET_TYPE_RESUME) ? "RESUME" : "RESUME_ACK", peer_sequence_number_,
+              connection_id_);
+    send_packet(type, connection_id_, peer_sequence_number_, token, sizeof(token));
+
+    if (type == TRANSPORT_PACKET_TYPE_RESUME)
+    {
+        resume_attempts_++;
+        last_tx_time_ = get_current_time_ms(); // Start of the response timeout
+        arm_response_timer();
+    }
+}
+
+/**
+ * @brief Handles a keep-alive or retransmission timeout of an established connection
+ */
+void TransportLayer::connection_lost()
+{
+    if (options_ & TRANSPORT_OPTION_RESUME)
+    {
+        suspend_session();
+        return;
+    }
+
+    // Start graceful disconnect
+    log_info("TransportLayer: Disconnecting");
+    state_ = TRANSPORT_STATE_DISCONNECTING;
+    arm_response_timer();
+    report_event(TRANSPORT_LAYER_EVENT_TIMEOUT);
+}
+
+/**
+ * @brief Keeps the session of a lost connection and starts asking the peer to resume it
+ *
+ * Sequence numbers, both windows and a message being segmented stay as they
+ * are; packets arriving meanwhile are ignored, except RESUME, RESUME_ACK and
+ * a SYN that starts over.
+ */
+void TransportLayer::suspend_session()
+{
+    log_info("TransportLayer: Suspending session, trying to resume it");
+    stats_.sessions_suspended++;
+    state_ = TRANSPORT_STATE_RESUMING;
+    resume_attempts_ = 0;
+    send_resume(TRANSPORT_PACKET_TYPE_RESUME);
+    report_event(TRANSPORT_LAYER_EVENT_SUSPENDED);
+}
+
+void TransportLayer::handle_resume_packet(uint8_t type, uint8_t connection_id, uint8_t next_sequence,
+                                          uint32_t token)
+{
+    // Only the session agreed in the handshake can be resumed
+    if (connection_id != connection_id_ || !(options_ & TRANSPORT_OPTION_RESUME) ||
+        token != session_token_)
+    {
+        log_debug("TransportLayer: Ignoring RESUME for another session (conn_id=%d)", connection_id);
+        stats_.invalid_packets++;
+        return;
+    }
+
+    // Answer first: control packets overtake the DATA resent below
+    if (type == TRANSPORT_PACKET_TYPE_RESUME)
+    {
+        send_resume(TRANSPORT_PACKET_TYPE_RESUME_ACK);
+    }
+    resume_session(next_sequence);
+}
+
+/**
+ * @brief Continues a session where the peer's next expected sequence number says it stopped
+ *
+ * Also used when the peer resumes a session this side never suspended, in
+ * which case only the unacknowledged packets are resent.
+ */
+void TransportLayer::resume_session(uint8_t next_sequence)
+{
+    bool suspended = (state_ == TRANSPORT_STATE_RESUMING);
+    uint32_t current_time = get_current_time_ms();
+
+    state_ = TRANSPORT_STATE_CONNECTED;
+    resume_attempts_ = 0;
+    last_keepalive_ack_time_ = current_time;
+    keepalive_pending_ = false;
+
+    // The RESUME or RESUME_ACK sent by this side carried the acknowledgment
+    ack_pending_ = false;
+    ack_pending_count_ = 0;
+
+    // Next Seq acknowledges everything the peer received in order; the
+    // backoff built up during the outage says nothing about the line
+    handle_ack_number(static_cast<uint8_t>(next_sequence - 1), 0);
+    update_rto();
+
+    // Resend the rest now instead of waiting for the RTO. Karn's rule
+    // applies, and the packets get their retry budget back.
+    uint8_t in_flight = get_in_flight_count();
+    for (uint8_t i = 0; i < in_flight; i++)
+    {
+        TransportTxSlot &slot = tx_window_[static_cast<uint8_t>(send_base_ + i) & (window_size_ - 1)];
+        if (slot.acked)
+        {
+            continue;
+        }
+        if (transmit_slot(slot) < 0)
+        {
+            break; // The retransmission timer takes over
+        }
+        slot.tx_time = current_time;
+        slot.retries = 1;
+        stats_.retransmits++;
+    }
+
+    arm_retransmit_timer();
+    arm_keepalive_timer();
+
+    if (suspended)
+    {
+        log_info("TransportLayer: Session resumed with ID %d", connection_id_);
+        stats_.sessions_resumed++;
+        report_event(TRANSPORT_LAYER_EVENT_RESUMED);
+    }
+}
+
+void TransportLayer::send_syn()
+{
+    log_debug("TransportLayer: Sending SYN packet - seq=%d", sequence_number_);
+    // A fixed connection ID is requested in the SYN, otherwise the listener assigns one
+    uint8_t options = local_options_ | window_option(window_capacity_);
+    send_packet(TRANSPORT_PACKET_TYPE_SYN, fixed_connection_id_, sequence_number_, &options, 1);
+    last_tx_time_ = get_current_time_ms(); // Start of the response timeout
+    arm_response_timer();
+}
+
+void TransportLayer::send_syn_ack()
+{
+    if (fixed_connection_id_ != TRANSPORT_CONNECTION_ID_INVALID)
+    {
+        connection_id_ = fixed_connection_id_;
+    }
+    else
+    {
+        // Increment connection ID before using it
+        connection_id_ = (connection_id_ + 1) % 256;
+        if (connection_id_ == TRANSPORT_CONNECTION_ID_INVALID)
+        {
+            connection_id_ = TRANSPORT_CONNECTION_ID_START;
+        }
+    }
+
+    log_debug("TransportLayer: Sending SYN-ACK packet - seq=%d, conn_id=%d", sequence_number_,
               connection_id_);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_SYN_ACK;
-    tx_buffer_[1] = connection_id_; // Use incremented connection ID
-    tx_buffer_[2] = sequence_number_;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    // [OPTIONS(1) | SESSION_TOKEN(4)], the token only for a resumable session
+    uint8_t payload[5];
+    payload[0] = options_ | window_option(window_size_);
+    uint8_t payload_length = 1;
+    if (options_ & TRANSPORT_OPTION_RESUME)
+    {
+        write_u32(&payload[1], session_token_);
+        payload_length = 5;
+    }
+    send_packet(TRANSPORT_PACKET_TYPE_SYN_ACK, connection_id_, sequence_number_, payload,
+                payload_length);
+    last_tx_time_ = get_current_time_ms(); // Start of the response timeout
+    arm_response_timer();
 }
 
 void TransportLayer::send_ack(uint8_t connection_id, uint8_t sequence_number)
 {
     log_debug("TransportLayer: Sending ACK packet - seq=%d, conn_id=%d", sequence_number,
               connection_id);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_ACK;
-    tx_buffer_[1] = connection_id;
-    tx_buffer_[2] = sequence_number;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    send_packet(TRANSPORT_PACKET_TYPE_ACK, connection_id, sequence_number, NULL, 0);
 }
 
 void TransportLayer::send_fin()
 {
     log_debug("TransportLayer: Sending FIN packet - seq=%d, conn_id=%d", sequence_number_,
               connection_id_);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_FIN;
-    tx_buffer_[1] = connection_id_;
-    tx_buffer_[2] = sequence_number_;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    send_packet(TRANSPORT_PACKET_TYPE_FIN, connection_id_, sequence_number_, NULL, 0);
+    last_tx_time_ = get_current_time_ms(); // Start of the response timeout
+    arm_response_timer();
 }
 
 void TransportLayer::send_fin_ack()
 {
     log_debug("TransportLayer: Sending FIN-ACK packet - seq=%d, conn_id=%d", sequence_number_,
               connection_id_);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_FIN_ACK;
-    tx_buffer_[1] = connection_id_;
-    tx_buffer_[2] = sequence_number_;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    send_packet(TRANSPORT_PACKET_TYPE_FIN_ACK, connection_id_, sequence_number_, NULL, 0);
 }
 
-void TransportLayer::send_data_ack(uint8_t connection_id, uint8_t sequence_number)
+void TransportLayer::send_data_ack(uint8_t connection_id)
 {
-    log_debug("TransportLayer: Sending DATA_ACK packet - seq=%d, conn_id=%d", sequence_number,
-              connection_id);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_DATA_ACK;
-    tx_buffer_[1] = connection_id;
-    tx_buffer_[2] = sequence_number;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    // Acknowledge everything up to the last in-order packet, plus a bitmap of
+    // the out-of-order packets held in the receive window
+    uint8_t sequence_number = static_cast<uint8_t>(peer_sequence_number_ - 1);
+    uint8_t sack[TRANSPORT_SACK_BITMAP_SIZE];
+    uint32_t bitmap = 0;
+    for (uint8_t i = 1; i < window_size_; i++)
+    {
+        if (rx_window_[(peer_sequence_number_ + i) & (window_size_ - 1)].valid)
+        {
+            bitmap |= (1UL << i);
+        }
+    }
+
+    uint8_t bitmap_length = 0;
+    while (bitmap_length < TRANSPORT_SACK_BITMAP_SIZE && (bitmap >> (bitmap_length * 8)))
+    {
+        sack[bitmap_length] = (bitmap >> (bitmap_length * 8)) & 0xFF;
+        bitmap_length++;
+    }
+
+    log_debug("TransportLayer: Sending DATA_ACK packet - seq=%d, conn_id=%d, sack=0x%x",
+              sequence_number, connection_id, (unsigned)bitmap);
+    if (send_packet(TRANSPORT_PACKET_TYPE_DATA_ACK, connection_id, sequence_number, sack,
+                    bitmap_length) >= 0)
+    {
+        ack_pending_ = false; // Covers every packet received so far
+        ack_pending_count_ = 0;
+        stats_.data_acks_sent++;
+    }
+}
+
+/**
+ * @brief Arranges for an in-order DATA packet to be acknowledged
+ *
+ * The acknowledgment is held back for TRANSPORT_DELAYED_ACK_MS so that it can
+ * ride on reverse-direction DATA or cover later packets too; after
+ * delayed_ack_packets_ unacknowledged packets it is sent at once.
+ */
+void TransportLayer::schedule_data_ack()
+{
+    if (!ack_pending_)
+    {
+        ack_pending_ = true;
+        ack_pending_count_ = 0;
+        ack_pending_time_ = get_current_time_ms();
+        start_timer(ack_timer_, ack_pending_time_ + TRANSPORT_DELAYED_ACK_MS);
+    }
+    ack_pending_count_++;
+
+    if (TRANSPORT_DELAYED_ACK_MS == 0 || ack_pending_count_ >= delayed_ack_packets_)
+    {
+        send_data_ack(connection_id_);
+    }
 }
 
 void TransportLayer::send_data_nack(uint8_t connection_id, uint8_t sequence_number)
 {
     log_debug("TransportLayer: Sending DATA_NACK packet - seq=%d, conn_id=%d", sequence_number,
               connection_id);
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_DATA_NACK;
-    tx_buffer_[1] = connection_id;
-    tx_buffer_[2] = sequence_number;
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    send_packet(TRANSPORT_PACKET_TYPE_DATA_NACK, connection_id, sequence_number, NULL, 0);
+    stats_.nacks_sent++;
 }
 
-void TransportLayer::handle_syn_packet(uint8_t connection_id, uint8_t sequence_number)
+void TransportLayer::handle_syn_packet(uint8_t connection_id, uint8_t sequence_number,
+                                       uint8_t options)
 {
     // Store peer's sequence number
     peer_sequence_number_ = sequence_number;
 
-    // Handle client reset scenario in CONNECTED state
-    if (state_ == TRANSPORT_STATE_CONNECTED && connection_id == TRANSPORT_CONNECTION_ID_INVALID)
+    // Handle client reset scenario in CONNECTED state; a suspended session
+    // cannot be resumed either once the peer starts over
+    if ((state_ == TRANSPORT_STATE_CONNECTED || state_ == TRANSPORT_STATE_RESUMING) &&
+        connection_id == fixed_connection_id_)
     {
         log_info("TransportLayer: Client reset detected, disconnecting current connection");
         // Send FIN to current connection
@@ -598,11 +1708,11 @@ void TransportLayer::handle_syn_packet(uint8_t connection_id, uint8_t sequence_n
         return;
     }
 
-    // Verify the connection ID is invalid (0) as expected from client
-    if (connection_id != TRANSPORT_CONNECTION_ID_INVALID)
+    // Verify the client asks for our fixed connection ID, or for none (0)
+    if (connection_id != fixed_connection_id_)
     {
         log_debug("TransportLayer: Rejecting SYN with invalid connection ID %d (expected %d)",
-                  connection_id, TRANSPORT_CONNECTION_ID_INVALID);
+                  connection_id, fixed_connection_id_);
         return;
     }
 
@@ -610,13 +1720,18 @@ void TransportLayer::handle_syn_packet(uint8_t connection_id, uint8_t sequence_n
     state_ = TRANSPORT_STATE_CONNECTING;
     waiting_response_ = true;
     sequence_number_ = (get_current_time_ms() & 0xFF);
+    options_ = local_options_ & options; // Answered in the SYN-ACK
+    use_window(options);
+    session_token_ = mix_token(get_current_time_ms() ^ (static_cast<uint32_t>(sequence_number) << 8) ^
+                               (session_token_ + 0x9E3779B9u)); // Differs from the previous session
     log_info("TransportLayer: Accepting connection while listening");
 
     // Send SYN-ACK with our allocated connection ID
     send_syn_ack();
 }
 
-void TransportLayer::handle_syn_ack_packet(uint8_t connection_id, uint8_t sequence_number)
+void TransportLayer::handle_syn_ack_packet(uint8_t connection_id, uint8_t sequence_number,
+                                           uint8_t options, uint32_t token)
 {
     // Only handle SYN-ACK in CONNECTING state
     if (state_ != TRANSPORT_STATE_CONNECTING)
@@ -625,8 +1740,19 @@ void TransportLayer::handle_syn_ack_packet(uint8_t connection_id, uint8_t sequen
         return;
     }
 
-    // Store the connection ID assigned by the server
+    if (fixed_connection_id_ != TRANSPORT_CONNECTION_ID_INVALID &&
+        connection_id != fixed_connection_id_)
+    {
+        log_debug("TransportLayer: Ignoring SYN-ACK with connection ID %d (expected %d)",
+                  connection_id, fixed_connection_id_);
+        return;
+    }
+
+    // Store the connection ID assigned by the server and the options it agreed to
     connection_id_ = connection_id;
+    options_ = local_options_ & options;
+    use_window(options);
+    session_token_ = token;
 
     // Update peer's sequence number
     peer_sequence_number_ = sequence_number;
@@ -639,6 +1765,9 @@ void TransportLayer::handle_syn_ack_packet(uint8_t connection_id, uint8_t sequen
     waiting_response_ = false;
     connect_retries_ = 0;
     last_keepalive_ack_time_ = get_current_time_ms();  // Initialize keep-alive time when connected
+    keepalive_pending_ = false;
+    reset_window();
+    arm_keepalive_timer();
     log_info("TransportLayer: Connection established with ID %d", connection_id_);
     report_event(TRANSPORT_LAYER_EVENT_CONNECTED);
 }
@@ -663,90 +1792,305 @@ void TransportLayer::handle_ack_packet(uint8_t connection_id, uint8_t sequence_n
             waiting_response_ = false;
             connect_retries_ = 0;
             last_keepalive_ack_time_ = get_current_time_ms();  // Initialize keep-alive time when connected
+            keepalive_pending_ = false;
+            reset_window();
+            arm_keepalive_timer();
             log_info("TransportLayer: Connection established with ID %d", connection_id_);
             report_event(TRANSPORT_LAYER_EVENT_CONNECTED);
         }
     }
-    // Handle ACK in DISCONNECTING state (completing graceful disconnect)
-    else if (state_ == TRANSPORT_STATE_DISCONNECTING)
+    // Handle ACK in DISCONNECTING state (completing graceful disconnect)
+    else if (state_ == TRANSPORT_STATE_DISCONNECTING)
+    {
+        state_ = TRANSPORT_STATE_DISCONNECTED;
+        waiting_response_ = false;
+        connection_id_ = TRANSPORT_CONNECTION_ID_INVALID;
+        log_info("TransportLayer: Disconnection completed");
+        report_event(TRANSPORT_LAYER_EVENT_DISCONNECTED);
+    }
+}
+
+void TransportLayer::handle_fin_packet(uint8_t connection_id)
+{
+    // Verify connection ID matches
+    if (connection_id != connection_id_)
+    {
+        log_debug("TransportLayer: Ignoring FIN with invalid connection ID %d (expected %d)",
+                  connection_id, connection_id_);
+        return;
+    }
+
+    // Only handle FIN in CONNECTED state
+    if (state_ != TRANSPORT_STATE_CONNECTED)
+    {
+        return;
+    }
+
+    // Send ACK for FIN
+    send_ack(connection_id, sequence_number_);
+
+    // Send our own FIN
+    send_fin();
+
+    // Update state
+    state_ = TRANSPORT_STATE_DISCONNECTING;
+    waiting_response_ = true;
+}
+
+void TransportLayer::handle_fin_ack_packet(uint8_t connection_id)
+{
+    // Verify connection ID matches
+    if (connection_id != connection_id_)
+    {
+        log_debug("TransportLayer: Ignoring FIN-ACK with invalid connection ID %d (expected %d)",
+                  connection_id, connection_id_);
+        return;
+    }
+
+    // Only handle FIN-ACK in DISCONNECTING state
+    if (state_ != TRANSPORT_STATE_DISCONNECTING)
+    {
+        return;
+    }
+
+    // Update state
+    state_ = TRANSPORT_STATE_DISCONNECTED;
+    waiting_response_ = false;
+    log_info("TransportLayer: Disconnection completed");
+    report_event(TRANSPORT_LAYER_EVENT_DISCONNECTED);
+}
+
+void TransportLayer::handle_data_ack_packet(const uint8_t *data, uint16_t length)
+{
+    const TransportPacketHeader *header = reinterpret_cast<const TransportPacketHeader *>(data);
+
+    // Verify connection ID matches
+    if (header->connection_id != connection_id_)
+    {
+        log_debug("TransportLayer: Ignoring DATA_ACK with invalid connection ID %d (expected %d)",
+                  header->connection_id, connection_id_);
+        return;
+    }
+
+    // Selective part: bit i acknowledges header->sequence + 1 + i
+    uint16_t bitmap_length = length - sizeof(TransportPacketHeader);
+    if (bitmap_length > TRANSPORT_SACK_BITMAP_SIZE)
+    {
+        bitmap_length = TRANSPORT_SACK_BITMAP_SIZE;
+    }
+    uint32_t bitmap = 0;
+    for (uint16_t i = 0; i < bitmap_length; i++)
+    {
+        bitmap |= static_cast<uint32_t>(data[sizeof(TransportPacketHeader) + i]) << (i * 8);
+    }
+
+    handle_ack_number(header->sequence, bitmap);
+}
+
+/**
+ * @brief Applies a cumulative acknowledgment and a SACK bitmap to the send window
+ *
+ * Used for DATA_ACK packets and for acknowledgments piggybacked on DATA.
+ */
+void TransportLayer::handle_ack_number(uint8_t sequence_number, uint32_t bitmap)
+{
+    uint8_t in_flight = get_in_flight_count();
+    if (in_flight == 0)
+    {
+        return;
+    }
+
+    // Cumulative part: everything up to and including sequence_number.
+    // An ACK behind send_base_ is a duplicate and only its bitmap is used.
+    uint8_t acked_count = sequence_offset(static_cast<uint8_t>(sequence_number + 1), send_base_);
+    if (acked_count > in_flight)
+    {
+        acked_count = 0;
+    }
+    uint32_t current_time = get_current_time_ms();
+    for (uint8_t i = 0; i < acked_count; i++)
+    {
+        mark_acked(tx_window_[(send_base_ + i) & (window_size_ - 1)], current_time);
+    }
+
+    for (uint8_t i = 0; bitmap != 0; i++, bitmap >>= 1)
     {
-        state_ = TRANSPORT_STATE_DISCONNECTED;
-        waiting_response_ = false;
-        connection_id_ = TRANSPORT_CONNECTION_ID_INVALID;
-        log_info("TransportLayer: Disconnection completed");
-        report_event(TRANSPORT_LAYER_EVENT_DISCONNECTED);
+        uint8_t sequence = static_cast<uint8_t>(sequence_number + 1 + i);
+        if ((bitmap & 1) && sequence_offset(sequence, send_base_) < in_flight)
+        {
+            mark_acked(tx_window_[sequence & (window_size_ - 1)], current_time);
+        }
     }
+
+    advance_send_base();
+
+    // Follow the oldest packet still in flight and any change of the RTO
+    arm_retransmit_timer();
 }
 
-void TransportLayer::handle_fin_packet(uint8_t connection_id)
+/**
+ * @brief Marks an in-flight packet as acknowledged and samples its round-trip time
+ *
+ * Following Karn's rule, only packets that were never retransmitted produce
+ * an RTT sample, since the ACK of a retransmission is ambiguous.
+ */
+void TransportLayer::mark_acked(TransportTxSlot &slot, uint32_t current_time)
 {
-    // Verify connection ID matches
-    if (connection_id != connection_id_)
+    if (slot.acked)
     {
-        log_debug("TransportLayer: Ignoring FIN with invalid connection ID %d (expected %d)",
-                  connection_id, connection_id_);
         return;
     }
 
-    // Only handle FIN in CONNECTED state
-    if (state_ != TRANSPORT_STATE_CONNECTED)
+    slot.acked = true;
+    stats_.ack_latency_ms.add(current_time - slot.first_tx_time);
+    if (slot.retries == 0)
     {
-        return;
+        update_rtt(current_time - slot.tx_time);
     }
+}
 
-    // Send ACK for FIN
-    send_ack(connection_id, sequence_number_);
+/**
+ * @brief Feeds one RTT sample into SRTT/RTTVAR and recomputes the RTO (RFC 6298)
+ *
+ * A fresh sample also cancels any exponential backoff.
+ */
+void TransportLayer::update_rtt(uint32_t rtt_ms)
+{
+    stats_.rtt_ms.add(rtt_ms);
 
-    // Send our own FIN
-    send_fin();
+    if (!rtt_valid_)
+    {
+        // First sample: SRTT = R, RTTVAR = R / 2
+        srtt_ = rtt_ms << 3;
+        rttvar_ = rtt_ms << 1;
+        rtt_valid_ = true;
+    }
+    else
+    {
+        // SRTT += (R - SRTT) / 8, RTTVAR += (|R - SRTT| - RTTVAR) / 4
+        int32_t error = static_cast<int32_t>(rtt_ms) - static_cast<int32_t>(srtt_ >> 3);
+        srtt_ += error;
+        if (error < 0)
+        {
+            error = -error;
+        }
+        rttvar_ += error - static_cast<int32_t>(rttvar_ >> 2);
+    }
 
-    // Update state
-    state_ = TRANSPORT_STATE_DISCONNECTING;
-    waiting_response_ = true;
+    update_rto();
 }
 
-void TransportLayer::handle_fin_ack_packet(uint8_t connection_id)
+/**
+ * @brief Derives the RTO from the current estimate, without any backoff
+ */
+void TransportLayer::update_rto()
 {
-    // Verify connection ID matches
-    if (connection_id != connection_id_)
+    if (!rtt_valid_)
     {
-        log_debug("TransportLayer: Ignoring FIN-ACK with invalid connection ID %d (expected %d)",
-                  connection_id, connection_id_);
+        retry_timeout_ = TRANSPORT_ACK_TIMEOUT_MS;
         return;
     }
 
-    // Only handle FIN-ACK in DISCONNECTING state
-    if (state_ != TRANSPORT_STATE_DISCONNECTING)
+    // RTO = SRTT + max(G, 4 * RTTVAR), with a clock granularity G of 1 ms
+    retry_timeout_ = (srtt_ >> 3) + (rttvar_ > 1 ? rttvar_ : 1);
+    if (retry_timeout_ < TRANSPORT_MIN_RTO_MS)
     {
-        return;
+        retry_timeout_ = TRANSPORT_MIN_RTO_MS;
+    }
+    else if (retry_timeout_ > TRANSPORT_MAX_RTO_MS)
+    {
+        retry_timeout_ = TRANSPORT_MAX_RTO_MS;
     }
+}
 
-    // Update state
-    state_ = TRANSPORT_STATE_DISCONNECTED;
-    waiting_response_ = false;
-    log_info("TransportLayer: Disconnection completed");
-    report_event(TRANSPORT_LAYER_EVENT_DISCONNECTED);
+/**
+ * @brief Forgets all RTT samples and restores the initial RTO
+ */
+void TransportLayer::reset_rtt()
+{
+    srtt_ = 0;
+    rttvar_ = 0;
+    rtt_valid_ = false;
+    retry_timeout_ = TRANSPORT_ACK_TIMEOUT_MS;
 }
 
-void TransportLayer::handle_data_ack_packet(uint8_t connection_id, uint8_t sequence_number)
+/**
+ * @brief Retransmits every unacknowledged packet older than the current RTO
+ *
+ * The RTO is doubled once per expiry (exponential backoff) until a new RTT
+ * sample arrives. A packet that exceeds max_retries_ takes the connection
+ * down the same way a keep-alive timeout does.
+ */
+void TransportLayer::check_retransmissions(uint32_t current_time)
 {
-    // Verify connection ID matches
-    if (connection_id != connection_id_)
+    bool expired = false;
+    uint8_t in_flight = get_in_flight_count();
+
+    for (uint8_t i = 0; i < in_flight; i++)
     {
-        log_debug("TransportLayer: Ignoring DATA_ACK with invalid connection ID %d (expected %d)",
-                  connection_id, connection_id_);
-        return;
+        uint8_t sequence = static_cast<uint8_t>(send_base_ + i);
+        TransportTxSlot &slot = tx_window_[sequence & (window_size_ - 1)];
+        if (slot.acked || current_time - slot.tx_time < retry_timeout_)
+        {
+            continue;
+        }
+
+        if (slot.retries >= max_retries_)
+        {
+            log_info("TransportLayer: DATA seq=%d not acknowledged after %d retries",
+                     sequence, slot.retries);
+            stats_.retry_timeouts++;
+            connection_lost();
+            return;
+        }
+
+        // Leave the timer running if the link layer cannot take the packet yet
+        if (transmit_slot(slot) < 0)
+        {
+            break;
+        }
+
+        log_debug("TransportLayer: Retransmitting seq=%d (retry %d, rto=%dms)", sequence,
+                  slot.retries + 1, retry_timeout_);
+        slot.tx_time = current_time;
+        slot.retries++;
+        stats_.retransmits++;
+        expired = true;
     }
 
-    // Check if we're waiting for this ACK
-    if (!awaiting_ack_ || sequence_number != sequence_number_ - 1)
+    if (expired)
     {
-        return;
+        retry_timeout_ <<= 1;
+        if (retry_timeout_ > TRANSPORT_MAX_RTO_MS)
+        {
+            retry_timeout_ = TRANSPORT_MAX_RTO_MS;
+        }
     }
+}
 
-    // Update state
-    awaiting_ack_ = false;
-    retry_count_ = 0;
+/**
+ * @brief Slides the send window past every acknowledged packet at its start
+ */
+void TransportLayer::advance_send_base()
+{
+    bool advanced = false;
+    while (send_base_ != sequence_number_ &&
+           tx_window_[send_base_ & (window_size_ - 1)].acked)
+    {
+        tx_window_[send_base_ & (window_size_ - 1)].acked = false;
+        send_base_ = (send_base_ + 1) % 256;
+        advanced = true;
+    }
+
+    if (advanced)
+    {
+        if (send_base_ == sequence_number_)
+        {
+            waiting_response_ = false;
+        }
+        pump_message();
+        report_event(TRANSPORT_LAYER_EVENT_READY_FOR_DATA);
+    }
 }
 
 void TransportLayer::handle_data_nack_packet(uint8_t connection_id, uint8_t sequence_number)
@@ -759,16 +2103,26 @@ void TransportLayer::handle_data_nack_packet(uint8_t connection_id, uint8_t sequ
         return;
     }
 
-    // Check if we're waiting for this sequence number
-    if (!awaiting_ack_ || sequence_number != sequence_number_ - 1)
+    stats_.nacks_received++;
+
+    // Check if this sequence number is still in flight
+    if (sequence_offset(sequence_number, send_base_) >= get_in_flight_count())
+    {
+        return;
+    }
+
+    TransportTxSlot &slot = tx_window_[sequence_number & (window_size_ - 1)];
+    if (slot.acked)
     {
         return;
     }
 
-    // Resend the packet using last_tx_buffer_
-    if (down_layer)
+    // Resend the packet from its window slot
+    if (down_layer && transmit_slot(slot) >= 0)
     {
-        down_layer->send(last_tx_buffer_, last_tx_length_);
+        slot.tx_time = get_current_time_ms();
+        slot.retries++;
+        stats_.nack_retransmits++;
     }
 }
 
@@ -783,11 +2137,7 @@ int TransportLayer::handle_keepalive_packet(uint8_t connection_id)
     }
 
     // Send keep-alive ACK
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_KEEPALIVE_ACK;
-    tx_buffer_[1] = connection_id_;
-    tx_buffer_[2] = 0; // No sequence number needed
-    tx_buffer_[3] = 0; // No payload
-    down_layer->send(tx_buffer_, TRANSPORT_HEADER_SIZE);
+    send_packet(TRANSPORT_PACKET_TYPE_KEEPALIVE_ACK, connection_id_, 0, NULL, 0);
     return 0;
 }
 
@@ -805,6 +2155,7 @@ int TransportLayer::handle_keepalive_ack_packet(uint8_t connection_id)
     //log_debug("TransportLayer:handle_keepalive_ack_packet");
     // Update last received time only when we get KEEPALIVE_ACK
     last_keepalive_ack_time_ = get_current_time_ms();
+    keepalive_pending_ = false;
     return 0;
 }
 
@@ -812,21 +2163,66 @@ void TransportLayer::reset()
 {
     state_ = TRANSPORT_STATE_DISCONNECTED;
     connect_retries_ = 0;
+    options_ = 0;
+    resume_attempts_ = 0;
     last_keepalive_ack_time_ = 0;
+    last_keepalive_tx_time_ = 0;
+    keepalive_pending_ = false;
     sequence_number_ = 0;
     peer_sequence_number_ = 0;
-    awaiting_ack_ = false;
     last_tx_time_ = 0;
-    retry_count_ = 0;
     waiting_response_ = false;
-    last_tick_time_ = get_current_time_ms();
+    stop_timers();
+    link_blocked_ = false;
+    reset_window();
+    reset_rtt();
+}
+
+void TransportLayer::reset_stats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.rtt_ms.reset();
+    stats_.ack_latency_ms.reset();
+}
+
+/**
+ * @brief Empties both windows and aligns send_base_ with the current sequence number
+ */
+void TransportLayer::reset_window()
+{
+    send_base_ = sequence_number_;
+    nack_sent_ = false;
+    ack_pending_ = false;
+    ack_pending_count_ = 0;
+    tx_message_ = NULL; // A message does not survive the connection it was started on
+    rx_message_length_ = 0;
+    rx_message_dropped_ = false;
+    for (uint8_t i = 0; i < window_size_; i++)
+    {
+        tx_window_[i].length = 0;
+        tx_window_[i].acked = false;
+        rx_window_[i].valid = false;
+    }
 }
 
 int TransportLayer::send_datagram(const uint8_t *data, uint16_t length)
 {
+    if (!data)
+    {
+        log_debug("TransportLayer: Send datagram failed - invalid parameters");
+        return TRANSPORT_ERROR_INVALID_PARAMS;
+    }
+
+    LayerSegment segment = {data, length};
+    return send_datagram_v(&segment, 1);
+}
+
+int TransportLayer::send_datagram_v(const LayerSegment *segments, uint8_t count)
+{
+    int32_t length = layer_segments_length(segments, count);
     log_debug("TransportLayer: Send datagram requested - length=%d", length);
 
-    if (!data || !down_layer)
+    if (length < 0 || !down_layer)
     {
         log_debug("TransportLayer: Send datagram failed - invalid parameters");
         return TRANSPORT_ERROR_INVALID_PARAMS;
@@ -839,13 +2235,77 @@ int TransportLayer::send_datagram(const uint8_t *data, uint16_t length)
         return TRANSPORT_ERROR_INVALID_PARAMS;
     }
 
-    // Construct datagram packet: [TYPE(1) | LENGTH(1) | DATA(n)]
-    tx_buffer_[0] = TRANSPORT_PACKET_TYPE_DATAGRAM;
-    tx_buffer_[1] = length;
-    memcpy(&tx_buffer_[2], data, length);
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    if (batch_max_bytes_ > 0)
+    {
+        // Item: [LENGTH(1) | DATA(n)], after the batch's TYPE byte
+        uint16_t item_length = 1 + static_cast<uint16_t>(length);
+        bool fits_batch = (length <= 0xFF && 1 + item_length <= batch_max_bytes_);
+
+        // Keep the order: whatever is pending goes first if this one does not join it
+        if (batch_length_ > 0 && (!fits_batch || batch_length_ + item_length > batch_max_bytes_))
+        {
+            if (flush_datagrams() < 0)
+            {
+                return TRANSPORT_ERROR_SEND_FAILED;
+            }
+        }
+
+        if (fits_batch)
+        {
+            if (batch_length_ == 0)
+            {
+                batch_buffer_[0] = TRANSPORT_PACKET_TYPE_DATAGRAM_BATCH;
+                batch_length_ = 1;
+                batch_count_ = 0;
+                batch_time_ = get_current_time_ms();
+                start_timer(batch_timer_, batch_time_ + batch_max_delay_);
+            }
+            batch_buffer_[batch_length_] = static_cast<uint8_t>(length);
+            layer_gather_segments(&batch_buffer_[batch_length_ + 1], segments, count);
+            batch_length_ += item_length;
+            batch_count_++;
+            stats_.datagrams_tx++;
+
+            // A full batch leaves at once
+            if (batch_length_ + 1 >= batch_max_bytes_)
+            {
+                flush_datagrams();
+            }
+            return TRANSPORT_SUCCESS;
+        }
+    }
+#endif
+
+    int result = send_datagram_packet(segments, count, static_cast<uint16_t>(length));
+    if (result >= 0)
+    {
+        stats_.datagrams_tx++;
+    }
+    return result;
+}
+
+/**
+ * @brief Builds a DATAGRAM packet and passes it to the link layer
+ */
+int TransportLayer::send_datagram_packet(const LayerSegment *segments, uint8_t count,
+                                         uint16_t length)
+{
+    // Construct datagram packet in the link layer's outgoing buffer if possible:
+    // [TYPE(1) | LENGTH(1) | DATA(n)]
+    uint8_t *packet = down_layer->reserve(length + 2, LAYER_PRIORITY_DATAGRAM);
+    bool reserved = (packet != NULL);
+    if (!reserved)
+    {
+        packet = tx_buffer_;
+    }
+    packet[0] = TRANSPORT_PACKET_TYPE_DATAGRAM;
+    packet[1] = length & 0xFF; // Low byte only in large-frame mode
+    layer_gather_segments(&packet[2], segments, count);
 
     // Send through link layer
-    int result = down_layer->send(tx_buffer_, length + 2);
+    int result = reserved ? down_layer->commit(length + 2)
+                          : down_layer->send(packet, length + 2, LAYER_PRIORITY_DATAGRAM);
     if (result < 0)
     {
         log_debug("TransportLayer: Send datagram failed - down layer error %d", result);
@@ -856,6 +2316,145 @@ int TransportLayer::send_datagram(const uint8_t *data, uint16_t length)
     return result;
 }
 
+#if TRANSPORT_DATAGRAM_AGGREGATION
+void TransportLayer::set_datagram_aggregation(uint16_t max_bytes, uint32_t max_delay_ms)
+{
+    // Whatever was collected under the old budget is sent first
+    flush_datagrams();
+
+    batch_max_bytes_ = (max_bytes > TRANSPORT_MAX_PACKET_SIZE) ? TRANSPORT_MAX_PACKET_SIZE : max_bytes;
+    batch_max_delay_ = max_delay_ms;
+}
+
+/**
+ * @brief Sends the pending batch; a batch of one goes out as a plain DATAGRAM
+ */
+int TransportLayer::flush_datagrams()
+{
+    if (batch_length_ == 0 || !down_layer)
+    {
+        return TRANSPORT_SUCCESS;
+    }
+
+    int result;
+    if (batch_count_ == 1)
+    {
+        LayerSegment item = {&batch_buffer_[2], batch_buffer_[1]};
+        result = send_datagram_packet(&item, 1, batch_buffer_[1]);
+    }
+    else
+    {
+        result = down_layer->send(batch_buffer_, batch_length_, LAYER_PRIORITY_DATAGRAM);
+        if (result < 0)
+        {
+            log_debug("TransportLayer: Send datagram batch failed - down layer error %d", result);
+            result = TRANSPORT_ERROR_SEND_FAILED;
+        }
+        else
+        {
+            stats_.datagram_batches_tx++;
+        }
+    }
+
+    if (result >= 0)
+    {
+        batch_length_ = 0;
+        batch_count_ = 0;
+    }
+    return result;
+}
+#endif
+
+#if TRANSPORT_DELTA_STREAMS
+int TransportLayer::send_datagram_delta(uint8_t stream, const uint8_t *data, uint16_t length)
+{
+    log_debug("TransportLayer: Send delta datagram requested - stream=%d, length=%d", stream, length);
+
+    if (!data || !down_layer || stream >= TRANSPORT_DELTA_STREAMS || length == 0 ||
+        length > TRANSPORT_DELTA_MAX_LENGTH)
+    {
+        log_debug("TransportLayer: Send delta datagram failed - invalid parameters");
+        return TRANSPORT_ERROR_INVALID_PARAMS;
+    }
+
+#if TRANSPORT_DATAGRAM_AGGREGATION
+    // Keep the order with datagrams waiting in a batch
+    if (flush_datagrams() < 0)
+    {
+        return TRANSPORT_ERROR_SEND_FAILED;
+    }
+#endif
+
+    // [DATAGRAM_DELTA(1) | STREAM(1) | KEY(1) | DATA(n)], at most a keyframe long
+    uint16_t max_length = TRANSPORT_DELTA_HEADER_SIZE + length;
+    uint8_t *packet = down_layer->reserve(max_length, LAYER_PRIORITY_DATAGRAM);
+    bool reserved = (packet != NULL);
+    if (!reserved)
+    {
+        packet = tx_buffer_;
+    }
+
+    TransportDeltaStream &tx = delta_tx_[stream];
+    int delta_length = -1;
+    if (tx.valid && tx.length == length && tx.deltas < TRANSPORT_DELTA_KEYFRAME_INTERVAL - 1)
+    {
+        // Only worth it if shorter than the keyframe
+        delta_length = encode_delta(tx.buffer, data, length, &packet[TRANSPORT_DELTA_HEADER_SIZE], length - 1);
+    }
+
+    bool keyframe = (delta_length < 0);
+    uint8_t key_id = tx.key_id;
+    if (keyframe)
+    {
+        // A fresh stream starts from a time-derived ID, like the sequence numbers, so that a
+        // receiver still holding keyframes from before a restart does not take it for one of them
+        key_id = tx.valid ? ((tx.key_id + 1) & ~TRANSPORT_DELTA_KEYFRAME) : (get_current_time_ms() & 0x7F);
+        memcpy(&packet[TRANSPORT_DELTA_HEADER_SIZE], data, length);
+        delta_length = length;
+    }
+
+    packet[0] = TRANSPORT_PACKET_TYPE_DATAGRAM_DELTA;
+    packet[1] = stream;
+    packet[2] = keyframe ? (TRANSPORT_DELTA_KEYFRAME | key_id) : key_id;
+
+    uint16_t packet_length = TRANSPORT_DELTA_HEADER_SIZE + static_cast<uint16_t>(delta_length);
+    int result = reserved ? down_layer->commit(packet_length)
+                          : down_layer->send(packet, packet_length, LAYER_PRIORITY_DATAGRAM);
+    if (result < 0)
+    {
+        log_debug("TransportLayer: Send delta datagram failed - down layer error %d", result);
+        return TRANSPORT_ERROR_SEND_FAILED;
+    }
+
+    // The reference only changes once the keyframe is on its way
+    if (keyframe)
+    {
+        memcpy(tx.buffer, data, length);
+        tx.length = length;
+        tx.key_id = key_id;
+        tx.deltas = 0;
+        tx.valid = true;
+        stats_.delta_keyframes_tx++;
+    }
+    else
+    {
+        tx.deltas++;
+        stats_.deltas_tx++;
+    }
+    stats_.datagrams_tx++;
+    return result;
+}
+
+void TransportLayer::reset_delta_streams()
+{
+    for (uint8_t i = 0; i < TRANSPORT_DELTA_STREAMS; i++)
+    {
+        // Keep the key ID so that the next keyframe gets a new one
+        delta_tx_[i].deltas = TRANSPORT_DELTA_KEYFRAME_INTERVAL;
+    }
+}
+#endif
+
 /**
  * @brief Handles datagram packets
  */
@@ -865,10 +2464,125 @@ int TransportLayer::handle_datagram_packet(const uint8_t *data, uint16_t length)
     const uint8_t *payload = data + 2;
     uint16_t payload_length = length - 2;
 
+    stats_.datagrams_rx++;
+
     // Forward data directly to manager
     if (manager_)
     {
-        manager_->on_datagram(payload, payload_length);
+        manager_->on_datagram(channel_, payload, payload_length);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Rebuilds a datagram of a delta stream and delivers it
+ */
+int TransportLayer::handle_datagram_delta_packet(const uint8_t *data, uint16_t length)
+{
+#if TRANSPORT_DELTA_STREAMS
+    if (length < TRANSPORT_DELTA_HEADER_SIZE || data[1] >= TRANSPORT_DELTA_STREAMS)
+    {
+        stats_.invalid_packets++;
+        log_debug("TransportLayer: Invalid DATAGRAM_DELTA packet");
+        return -1;
+    }
+
+    TransportDeltaStream &rx = delta_rx_[data[1]];
+    uint8_t key = data[2];
+    const uint8_t *body = &data[TRANSPORT_DELTA_HEADER_SIZE];
+    uint16_t body_length = length - TRANSPORT_DELTA_HEADER_SIZE;
+
+    if (key & TRANSPORT_DELTA_KEYFRAME)
+    {
+        if (body_length == 0 || body_length > TRANSPORT_DELTA_MAX_LENGTH)
+        {
+            stats_.invalid_packets++;
+            return -1;
+        }
+        memcpy(rx.buffer, body, body_length);
+        rx.length = body_length;
+        rx.key_id = key & ~TRANSPORT_DELTA_KEYFRAME;
+        rx.valid = true;
+
+        stats_.datagrams_rx++;
+        if (manager_)
+        {
+            manager_->on_datagram(channel_, rx.buffer, rx.length);
+        }
+        return 0;
+    }
+
+    if (!rx.valid || rx.key_id != key)
+    {
+        stats_.deltas_dropped++;
+        log_debug("TransportLayer: Dropping delta for missing keyframe %d of stream %d", key, data[1]);
+        return -1;
+    }
+
+    // Apply [UNCHANGED(1) | CHANGED(1) | CHANGED BYTES] runs to a copy of the keyframe
+    memcpy(delta_buffer_, rx.buffer, rx.length);
+    uint16_t position = 0;
+    uint16_t offset = 0;
+    while (offset < body_length)
+    {
+        if (offset + 2 > body_length)
+        {
+            stats_.invalid_packets++;
+            return -1;
+        }
+        position += body[offset];
+        uint16_t changed = body[offset + 1];
+        offset += 2;
+        if (position + changed > rx.length || offset + changed > body_length)
+        {
+            stats_.invalid_packets++;
+            log_debug("TransportLayer: Malformed DATAGRAM_DELTA packet");
+            return -1;
+        }
+        memcpy(&delta_buffer_[position], &body[offset], changed);
+        position += changed;
+        offset += changed;
+    }
+
+    stats_.datagrams_rx++;
+    if (manager_)
+    {
+        manager_->on_datagram(channel_, delta_buffer_, rx.length);
+    }
+    return 0;
+#else
+    (void)data;
+    (void)length;
+    stats_.invalid_packets++;
+    return -1;
+#endif
+}
+
+/**
+ * @brief Delivers every datagram of a batch
+ */
+int TransportLayer::handle_datagram_batch_packet(const uint8_t *data, uint16_t length)
+{
+    stats_.datagram_batches_rx++;
+
+    uint16_t offset = 1;
+    while (offset < length)
+    {
+        uint16_t item_length = data[offset];
+        if (offset + 1 + item_length > length)
+        {
+            stats_.invalid_packets++;
+            log_debug("TransportLayer: Truncated item in DATAGRAM_BATCH packet");
+            return -1;
+        }
+
+        stats_.datagrams_rx++;
+        if (manager_)
+        {
+            manager_->on_datagram(channel_, &data[offset + 1], item_length);
+        }
+        offset += 1 + item_length;
     }
 
     return 0;
@@ -0,0 +1,274 @@
+#include "transport_mux.hpp"
+#include "log.hpp"
+
+namespace robust_serial
+{
+
+TransportMux::TransportMux()
+    : Layer()
+    , link_layer_(NULL)
+    , channel_count_(0)
+    , next_tick_channel_(0)
+{
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        transports_[i] = NULL;
+        queued_bytes_[i] = 0;
+        waiting_[i] = false;
+    }
+}
+
+/**
+ * @brief Destructor for TransportMux.
+ */
+TransportMux::~TransportMux()
+{
+}
+
+void TransportMux::initialize()
+{
+    next_tick_channel_ = 0;
+    for (uint8_t i = 0; i < TRANSPORT_MAX_CONNECTIONS; i++)
+    {
+        queued_bytes_[i] = 0;
+        waiting_[i] = false;
+    }
+}
+
+void TransportMux::deinitialize()
+{
+    initialize();
+}
+
+int TransportMux::set_down_layer(LinkLayer *layer)
+{
+    return set_down_layer(layer, layer);
+}
+
+int TransportMux::set_down_layer(Layer *layer, LinkLayer *link_layer)
+{
+    if (!link_layer)
+    {
+        return LAYER_ERROR_INVALID_LAYER;
+    }
+
+    int result = Layer::set_down_layer(layer);
+    if (result == LAYER_SUCCESS)
+    {
+        link_layer_ = link_layer;
+    }
+    return result;
+}
+
+int TransportMux::attach(TransportLayer *transport)
+{
+    if (!transport || channel_count_ >= TRANSPORT_MAX_CONNECTIONS)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    uint8_t channel = channel_count_++;
+    transports_[channel] = transport;
+    transport->set_channel(channel);
+    transport->set_down_layer(this);
+    return channel;
+}
+
+int TransportMux::send(const uint8_t *data, uint16_t length)
+{
+    return send(data, length, LAYER_PRIORITY_BULK);
+}
+
+int TransportMux::send(const uint8_t *data, uint16_t length, uint8_t priority)
+{
+    if (!data || !down_layer)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    // Only DATA packets take part in fair sharing; their ACKs and all control
+    // packets are small and must not be delayed
+    int channel = -1;
+    uint8_t type = data[0] & ~TRANSPORT_PACKET_FLAG_ACK;
+    if (length >= TRANSPORT_HEADER_SIZE &&
+        (type == TRANSPORT_PACKET_TYPE_DATA || type == TRANSPORT_PACKET_TYPE_DATA_FRAGMENT))
+    {
+        channel = find_channel(data[1]);
+    }
+
+    if (channel >= 0 && !may_queue(static_cast<uint8_t>(channel), length))
+    {
+        waiting_[channel] = true;
+        return LINK_ERROR_BUFFER_FULL;
+    }
+
+    int result = (down_layer == link_layer_) ? link_layer_->send(data, length, priority)
+                                             : down_layer->send(data, length, priority);
+    if (channel >= 0)
+    {
+        if (result < 0)
+        {
+            waiting_[channel] = true;
+        }
+        else
+        {
+            queued_bytes_[channel] += length;
+            waiting_[channel] = false;
+        }
+    }
+    return result;
+}
+
+uint8_t *TransportMux::reserve(uint16_t length)
+{
+    return reserve(length, LAYER_PRIORITY_BULK);
+}
+
+// Straight to the link layer when it is the layer below: LinkLayer is final,
+// so this is a direct call instead of a virtual one
+uint8_t *TransportMux::reserve(uint16_t length, uint8_t priority)
+{
+    if (down_layer == link_layer_)
+    {
+        return link_layer_ ? link_layer_->reserve(length, priority) : NULL;
+    }
+    return down_layer->reserve(length, priority);
+}
+
+int TransportMux::commit(uint16_t length)
+{
+    if (down_layer == link_layer_)
+    {
+        return link_layer_ ? link_layer_->commit(length) : LAYER_ERROR_INVALID_LAYER;
+    }
+    return down_layer->commit(length);
+}
+
+int TransportMux::on_receive(const uint8_t *data, uint16_t length)
+{
+    if (!data || length < 2)
+    {
+        return LAYER_ERROR_INVALID_PARAM;
+    }
+
+    // [TYPE(1) | CONN_ID(1) | ...], datagrams have no connection ID
+    int channel;
+    if (data[0] == TRANSPORT_PACKET_TYPE_DATAGRAM || data[0] == TRANSPORT_PACKET_TYPE_DATAGRAM_BATCH ||
+        data[0] == TRANSPORT_PACKET_TYPE_DATAGRAM_DELTA)
+    {
+        channel = (channel_count_ > 0) ? 0 : -1;
+    }
+    else
+    {
+        channel = find_channel(data[1]);
+    }
+
+    if (channel < 0)
+    {
+        log_debug("TransportMux: Dropping packet for connection ID %d", data[1]);
+        return LAYER_ERROR;
+    }
+
+    return transports_[channel]->on_receive(data, length);
+}
+
+void TransportMux::tick()
+{
+    for (uint8_t i = 0; i < channel_count_; i++)
+    {
+        transports_[(next_tick_channel_ + i) % channel_count_]->tick();
+    }
+
+    if (channel_count_ > 0)
+    {
+        next_tick_channel_ = (next_tick_channel_ + 1) % channel_count_;
+    }
+}
+
+void TransportMux::on_link_space()
+{
+    for (uint8_t i = 0; i < channel_count_; i++)
+    {
+        transports_[i]->on_link_space();
+    }
+}
+
+uint32_t TransportMux::get_next_deadline() const
+{
+    uint32_t deadline = TRANSPORT_NO_DEADLINE;
+    for (uint8_t i = 0; i < channel_count_; i++)
+    {
+        uint32_t channel_deadline = transports_[i]->get_next_deadline();
+        if (channel_deadline < deadline)
+        {
+            deadline = channel_deadline;
+        }
+    }
+    return deadline;
+}
+
+int TransportMux::find_channel(uint8_t connection_id) const
+{
+    // An exact fixed ID wins; any other ID belongs to the first transport that
+    // accepts listener-assigned IDs, if there is one
+    int assigned = -1;
+    for (uint8_t i = 0; i < channel_count_; i++)
+    {
+        uint8_t fixed_id = transports_[i]->get_fixed_connection_id();
+        if (fixed_id == TRANSPORT_CONNECTION_ID_INVALID)
+        {
+            if (assigned < 0)
+            {
+                assigned = i;
+            }
+        }
+        else if (fixed_id == connection_id)
+        {
+            return i;
+        }
+    }
+    return assigned;
+}
+
+/**
+ * @brief Decides whether a DATA packet may enter the link layer's queue
+ *
+ * A channel that has used up its share of the queue in the current round is
+ * held back while another channel is waiting for room; otherwise it may use
+ * whatever space is free. The round, and with it every share, restarts when
+ * the bulk queue has drained.
+ */
+bool TransportMux::may_queue(uint8_t channel, uint16_t length)
+{
+    if (channel_count_ < 2 || !link_layer_)
+    {
+        return true;
+    }
+
+    if (!link_layer_->has_outgoing_data(LAYER_PRIORITY_BULK))
+    {
+        for (uint8_t i = 0; i < channel_count_; i++)
+        {
+            queued_bytes_[i] = 0;
+            waiting_[i] = false;
+        }
+        return true;
+    }
+
+    uint32_t share = link_layer_->get_queue_capacity(LAYER_PRIORITY_BULK) / channel_count_;
+    if (queued_bytes_[channel] + length <= share)
+    {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < channel_count_; i++)
+    {
+        if (i != channel && waiting_[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace robust_serial